@@ -264,6 +264,14 @@ EXTERN_C int climain( int argc, char **argv )
 	    dbase.DisplayPackageInfo( argc, argv );
 	    break;
 
+	  case ACTION_OWNER:
+	    /*
+	     * Identify the installed package which provides each
+	     * file named on the command line.
+	     */
+	    dbase.DisplayFileOwners( argc, argv );
+	    break;
+
 	  case ACTION_SOURCE:
 	  case ACTION_LICENCE:
 	    /*
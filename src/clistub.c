@@ -203,6 +203,57 @@ static const char *help_text =
 "                    runtime prerequisites of, and in addition to,\n"
 "                    the nominated package\n"
 "\n"
+"  --stream-install  When performing install or upgrade operations,\n"
+"                    decompress and unpack each package archive file\n"
+"                    which is not already present in the local cache\n"
+"                    as it is downloaded, storing a copy in the cache\n"
+"                    as the download proceeds; (archives which would\n"
+"                    replace a prior installation are not streamed,\n"
+"                    but downloaded in full, before it is removed)\n"
+"\n"
+"  --no-cache        As --stream-install, but do not store any copy\n"
+"                    of the streamed archive files in the local cache\n"
+"\n"
+"  --skip-unchanged  When performing reinstall or upgrade operations,\n"
+"                    do not rewrite any file which is identical, in\n"
+"                    size and time stamp, to that recorded for the\n"
+"                    prior installation, and is itself unchanged\n"
+"\n"
+"  --verify-unchanged\n"
+"                    As --skip-unchanged, but also require that the\n"
+"                    file content checksum is identical, before any\n"
+"                    file is considered to be unchanged\n"
+"\n"
+"  --compact-manifests\n"
+"                    Record the content of installed packages in a\n"
+"                    compact binary form, rather than as XML; any\n"
+"                    existing manifest is converted, when it is next\n"
+"                    updated, (and, without this option, converted\n"
+"                    back to XML)\n"
+"\n"
+"  --socket-transport\n"
+"                    Fetch \"http:\" URLs using mingw-get's own HTTP\n"
+"                    client, rather than wininet; this ignores any\n"
+"                    proxy configuration, and passes any redirection\n"
+"                    to an \"https:\" URL back to wininet\n"
+"\n"
+"  --parallel-downloads=N\n"
+"                    Fetch as many as N package archive files\n"
+"                    concurrently, when performing install or\n"
+"                    upgrade operations; specify N = 1 to fetch\n"
+"                    them one at a time\n"
+"\n"
+"  --xz-threads=N    Use as many as N threads to decompress each xz\n"
+"                    compressed package archive, provided it has been\n"
+"                    compressed in multiple blocks; by default, one\n"
+"                    thread is used for each available processor\n"
+"\n"
+"  --xz-memlimit=M   Limit the memory used to decompress each xz or\n"
+"                    lzma compressed package archive to M MiB; by\n"
+"                    default, no limit is imposed, but the number of\n"
+"                    xz decompression threads may be reduced, to fit\n"
+"                    within one quarter of physical memory\n"
+"\n"
 "  --desktop[=all-users]\n"
 "                    Enable the creation of desktop shortcuts, for\n"
 "                    packages which provide the capability via pre-\n"
@@ -232,6 +283,8 @@ static const char *help_text =
 "Actions:\n"
 "  update            Update local copy of repository catalogues\n"
 "  list, show        List and show details of available packages\n"
+"  owner             Identify the installed package which provides each\n"
+"                    of the files named, in place of package-specs\n"
 "  source            Download and optionally unpack package sources\n"
 "  licence           Download and optionally unpack licence packages,\n"
 "                    handling them as if they are source packages\n"
@@ -419,6 +472,28 @@ int main( int argc, char **argv )
 
       { "all-related",    no_argument,         &optref,   OPTION_ALL_RELATED },
 
+      { "stream-install", no_argument,         &optref,   OPTION_STREAM_INSTALL },
+      { "no-cache",       no_argument,         &optref,   OPTION_NO_CACHE    },
+
+      { "skip-unchanged", no_argument,         &optref,
+			  OPTION_EXTRA_FLAG( OPTION_SKIP_UNCHANGED )     },
+      { "verify-unchanged",
+			  no_argument,         &optref,
+			  OPTION_EXTRA_FLAG( OPTION_VERIFY_UNCHANGED )   },
+
+      { "compact-manifests",
+			  no_argument,         &optref,
+			  OPTION_EXTRA_FLAG( OPTION_COMPACT_MANIFESTS )  },
+      { "socket-transport",
+			  no_argument,         &optref,
+			  OPTION_EXTRA_FLAG( OPTION_SOCKET_TRANSPORT )   },
+
+      { "parallel-downloads",
+			  required_argument,   &optref,   OPTION_PARALLEL_DOWNLOADS },
+
+      { "xz-threads",     required_argument,   &optref,   OPTION_XZ_THREADS  },
+      { "xz-memlimit",    required_argument,   &optref,   OPTION_XZ_MEMLIMIT },
+
       { "desktop",        optional_argument,   &optref,   OPTION_DESKTOP     },
       { "start-menu",     optional_argument,   &optref,   OPTION_START_MENU  },
 
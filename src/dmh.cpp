@@ -101,6 +101,38 @@ dmhTypeGUI::dmhTypeGUI( const char* name ):dmhTypeGeneric( name ){}
  */
 static dmhTypeGeneric *dmh = NULL;
 
+/* These pointers store the addresses of any lock acquisition, and
+ * release functions, registered by dmh_serialise().
+ */
+static void (*dmh_lock)( void ) = NULL;
+static void (*dmh_unlock)( void ) = NULL;
+
+class dmhSerialiser
+{
+  /* A trivial helper class; an instance of this is placed in the
+   * scope of each message dispatcher, to hold any registered lock
+   * for the duration of the dispatch, (even if a DMH_FATAL message
+   * causes it to be abandoned, by throwing an exception).
+   */
+  public:
+    inline dmhSerialiser():unlock( dmh_unlock ){ if( dmh_lock ) dmh_lock(); }
+    inline ~dmhSerialiser(){ if( unlock ) unlock(); }
+
+  private:
+    void (*unlock)( void );
+};
+
+EXTERN_C void dmh_serialise( void (*acquire)( void ), void (*release)( void ) )
+{
+  /* Public entry point, to register (or to remove) the lock by which
+   * all subsequent messages are to be serialised; the functions must
+   * be registered, or removed, as a pair.
+   */
+  if( (acquire == NULL) || (release == NULL) )
+    acquire = release = NULL;
+  dmh_lock = acquire; dmh_unlock = release;
+}
+
 EXTERN_C void dmh_init( const dmh_class subsystem, const char *progname )
 {
   /* Public entry point for message handler initialisation...
@@ -246,6 +278,7 @@ EXTERN_C int dmh_notify( const dmh_severity code, const char *fmt, ... )
 
   /* Normal operation; pass the message on to the active handler.
    */
+  dmhSerialiser serialise;
   va_list argv;
   va_start( argv, fmt );
   int retcode = dmh->notify( code, fmt, argv );
@@ -258,6 +291,7 @@ EXTERN_C int dmh_printf( const char *fmt, ... )
   /* Simulate standard printf() function calls, redirecting the display
    * of formatted output through the diagnostic message handler.
    */
+  dmhSerialiser serialise;
   va_list argv;
   va_start( argv, fmt );
   int retcode = dmh->printf( fmt, argv );
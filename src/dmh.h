@@ -65,6 +65,12 @@ EXTERN_C int dmh_printf( const char *fmt, ... );
 
 EXTERN_C uint16_t dmh_control( const uint16_t, const uint16_t );
 
+/* While several threads may emit diagnostics concurrently, the client
+ * may register a pair of functions, to acquire and release a lock by
+ * which every message is serialised; passing NULLs removes them.
+ */
+EXTERN_C void dmh_serialise( void (*)( void ), void (*)( void ) );
+
 #ifdef __cplusplus
 class dmh_exception : public std::exception
 {
@@ -323,9 +323,15 @@ int mkdir_recursive( const char *pathname, int mode )
        */
       create_parent_directory_hierarchy( pathname, mode );
       /*
-       * ...before making a further attempt to add the leaf.
+       * ...before making a further attempt to add the leaf; (note
+       * that this may yet fail, if another thread, extracting files
+       * concurrently, has just created the leaf directory itself, in
+       * which case we handle it as we do for any existing entity).
        */
-      return mkdir( pathname, mode );
+      if( mkdir( pathname, mode ) == 0 )
+	return 0;
+      if( errno != EEXIST )
+	break;
 
     case EEXIST:
       {
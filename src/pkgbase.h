@@ -85,6 +85,12 @@ EXTERN_C int pkgPutEnv( int, char* );
 /* Begin class declarations.
  */
 class pkgSpecs;
+class pkgPackageIndex;
+class pkgSysRootMap;
+class pkgInstallationIndex;
+class pkgDependencyMemo;
+class pkgArchiveStream;
+class pkgRetainedInventory;
 
 class pkgXmlNode : public TiXmlElement
 {
@@ -171,17 +177,26 @@ class pkgXmlNode : public TiXmlElement
     inline bool IsElementOfType( const char* tagname )
     {
       /* Confirm if the owner XML node represents a data element
-       * with the specified "tagname".
+       * with the specified "tagname"; element names are interned, so
+       * we need only compare the atom for "tagname", (if any).
        */
-      return this ? strcmp( GetName(), tagname ) == 0 : false;
+      return this ? (Atom() != NULL) && (Atom() == TiXmlAtom::Find( tagname )) : false;
     }
 
     /* Methods for retrieving the system root management records
-     * for a specified installed subsystem.
+     * for a specified installed subsystem; (the first may also return
+     * the path name of the sysroot, with any macros expanded).
      */
-    pkgXmlNode *GetSysRoot( const char* );
+    pkgXmlNode *GetSysRoot( const char*, const char** = NULL );
     pkgXmlNode *GetInstallationRecord( const char* );
 
+    /* Methods for attaching installation records to, and deleting
+     * them from, a sysroot record, while maintaining the index by which
+     * GetInstallationRecord() locates them.
+     */
+    pkgXmlNode *AddInstallationRecord( pkgXmlNode* );
+    void DeleteInstallationRecord( pkgXmlNode* );
+
     /* The following pair of methods provide an iterator
      * for enumerating the contained nodes, within the owner,
      * which themselves exhibit a specified tagname.
@@ -253,14 +268,46 @@ class pkgActionItem
      */
     pkgXmlNode* selection[ selection_types ];
 
+    /* When a package archive is to be streamed directly from its
+     * repository host, into the installer, (rather than downloaded
+     * into the local cache in advance), this holds the stream from
+     * the time the download is initiated, until the installer takes
+     * delivery of it.
+     */
+    pkgArchiveStream* archive_stream;
+
+    /* When a prior installation is removed, in preparation for its
+     * replacement, its files may be retained on disk, so that those
+     * which the replacement would leave unchanged need not be written
+     * again; this holds the inventory of such files, from the time of
+     * removal, until the installer takes delivery of it.
+     */
+    pkgRetainedInventory* retained_inventory;
+
     /* Method to display the URI whence a package may be downloaded.
      */
     void PrintURI( const char* );
 
-    /* Methods for retrieving packages from a distribution server.
+    /* Methods for retrieving packages from a distribution server;
+     * (the latter may also be invoked by the pkgDownloadScheduler,
+     * when archives are to be retrieved concurrently).
      */
-    void DownloadArchiveFiles( pkgActionItem* );
+    void DownloadArchiveFiles( pkgActionItem*, bool = false );
     void DownloadSingleArchive( const char*, const char* );
+    friend class pkgDownloadScheduler;
+
+    /* Methods to synchronise installation with the retrieval of
+     * packages, when DownloadArchiveFiles() leaves it to continue in
+     * the background; the first waits for the package associated with
+     * one action item, and the second waits for all retrievals.
+     */
+    void AwaitArchiveDownload();
+    void FinishArchiveDownloads();
+
+    /* Method for initiating the download of a package archive, which
+     * is to be streamed directly into the installer.
+     */
+    void StreamSingleArchive( const char*, const char* );
 
   public:
     /* Constructor...
@@ -289,6 +336,8 @@ class pkgActionItem
     void ApplyBounds( pkgXmlNode *, const char * );
     pkgXmlNode* SelectIfMostRecentFit( pkgXmlNode* );
     const char* SetRequirements( pkgXmlNode*, pkgSpecs* );
+    inline const char* MinWanted(){ return min_wanted; }
+    inline const char* MaxWanted(){ return max_wanted; }
     inline void SelectPackage( pkgXmlNode *pkg, int opt = to_install )
     {
       /* Mark a package as the selection for a specified action.
@@ -303,6 +352,38 @@ class pkgActionItem
     }
     void ConfirmInstallationStatus();
 
+    /* Method by which the installer takes delivery of the archive
+     * stream, if any, which has been prepared by StreamSingleArchive();
+     * the caller assumes responsibility for deleting it.
+     */
+    inline pkgArchiveStream* ArchiveStream()
+    {
+      pkgArchiveStream *stream = archive_stream;
+      archive_stream = NULL;
+      return stream;
+    }
+
+    /* Methods by which the remover deposits, and the installer takes
+     * delivery of, the inventory of any retained prior installation;
+     * again, the installer assumes responsibility for deleting it.
+     */
+    inline void RetainInventory( pkgRetainedInventory *inventory )
+    {
+      retained_inventory = inventory;
+    }
+    inline pkgRetainedInventory* RetainedInventory()
+    {
+      pkgRetainedInventory *inventory = retained_inventory;
+      retained_inventory = NULL;
+      return inventory;
+    }
+
+    /* Method by which the remover may cancel the installation which
+     * is to replace a prior installation, when it cannot safely remove
+     * that prior installation.
+     */
+    void CancelInstallation();
+
     /* Methods to download and unpack one or more source archives.
      */
     void GetSourceArchive( pkgXmlNode*, unsigned long );
@@ -325,12 +406,20 @@ class pkgXmlDocument : public TiXmlDocument
   public:
     /* Constructors...
      */
-    inline pkgXmlDocument(){}
-    inline pkgXmlDocument( const char* name )
+    inline pkgXmlDocument():
+    package_index( NULL ), resolved( NULL ), sysroot_map( NULL ){ RegisterKeys(); }
+    inline pkgXmlDocument( const char* name ):
+    package_index( NULL ), resolved( NULL ), sysroot_map( NULL )
     {
       /* tinyxml has a similar constructor, but unlike wxXmlDocument,
-       * it DOES NOT automatically load the document; force it.
+       * it DOES NOT automatically load the document; force it, (but
+       * only after ensuring that our standard keys are registered as
+       * interned names, for use while it is parsed).  Our documents
+       * are parsed in situ, so that names and values refer to their
+       * image of the file, rather than to individual copies.
        */
+      RegisterKeys();
+      SetInSitu( true );
       LoadFile( name );
 
       /* Always begin with an empty actions list.
@@ -338,6 +427,16 @@ class pkgXmlDocument : public TiXmlDocument
       actions = NULL;
     }
 
+    /* Destructor...
+     */
+    ~pkgXmlDocument();
+
+    /* Notification, from tinyxml, of any change to the children, or the
+     * attributes, of any node in the document; we use it to discard the
+     * package name index, when the package catalogue changes.
+     */
+    virtual void ContentChanged( TiXmlNode* );
+
     /* Accessors...
      */
     inline bool IsOk()
@@ -387,6 +486,34 @@ class pkgXmlDocument : public TiXmlDocument
     unsigned long request;
     pkgActionItem* actions;
 
+    /* Index of package names, used to accelerate FindPackageByName();
+     * it is constructed on demand, and is discarded by ContentChanged(),
+     * whenever any package-collection, package, or component, on which
+     * it depends, is added, removed, or has its attributes changed.
+     */
+    pkgPackageIndex* package_index;
+
+    /* Record of requirements for which dependencies have already been
+     * resolved, during the current Schedule() pass, so that the recursion
+     * in ResolveDependencies() need not evaluate them repeatedly; the
+     * associated method releases it.
+     */
+    pkgDependencyMemo* resolved;
+    void DiscardResolvedDependencies();
+
+    /* Mapping of each subsystem declared in the active system map, to
+     * its sysroot record, (and its expanded path name); it is constructed
+     * by LoadSystemMap(), (or on first use, if that has not been called),
+     * so that GetSysRoot() need not search for the record on each call.
+     */
+    pkgSysRootMap* sysroot_map;
+    void DiscardSysRootMap();
+
+    /* Registration of the standard XML database keys, (see pkgkeys.h),
+     * as interned names, so that look-ups using them are not hashed.
+     */
+    static void RegisterKeys();
+
   public:
     /* Method to interpret user preferences for mingw-get processing
      * options, which are specified within profile.xml rather than on
@@ -414,6 +541,16 @@ class pkgXmlDocument : public TiXmlDocument
      */
     void UpdateSystemMap();
 
+    /* Method to retrieve the sysroot record, (and optionally, its path
+     * name), for a specified subsystem, from the active system map.
+     */
+    pkgXmlNode *GetSysRoot( const char*, const char** = NULL );
+
+    /* Method to retrieve the index of installation records within
+     * a specified sysroot record, (if it is bound in the system map).
+     */
+    pkgInstallationIndex *GetInstallationIndex( pkgXmlNode* );
+
     /* Method to locate the XML database entry for a named package.
      */
     pkgXmlNode* FindPackageByName( const char*, const char* = NULL );
@@ -422,6 +559,11 @@ class pkgXmlDocument : public TiXmlDocument
      */
     void DisplayPackageInfo( int, char** );
 
+    /* Method to identify the installed packages which provide
+     * specified files.
+     */
+    void DisplayFileOwners( int, char** );
+
     /* Method to resolve the dependencies of a specified package,
      * by walking the chain of references specified by "requires"
      * elements in the respective package database entries.
@@ -467,6 +609,17 @@ bool safe_strcmp( strcmp_function strcmp, const char *value, const char *proto )
   return (value == NULL) || (proto == NULL) || (strcmp( value, proto ) == 0);
 }
 
+static __inline__ __attribute__((__always_inline__))
+unsigned long pkg_name_hash( const char *name, size_t len )
+{
+  /* FNV-1a hash, used to select the index table slot for a name,
+   * in any of the hashed indexes of the XML database.
+   */
+  unsigned long hash = 2166136261UL;
+  while( len-- > 0 ) hash = (hash ^ (unsigned char)(*name++)) * 16777619UL;
+  return hash;
+}
+
 /* Define a safe_strcmp() alias for an explicitly case sensitive match.
  */
 #define match_if_explicit( A, B )  safe_strcmp( strcmp, (A), (B) )
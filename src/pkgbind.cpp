@@ -30,9 +30,25 @@
 #include <unistd.h>
 
 #include "dmh.h"
+#include "mkpath.h"
 #include "pkgbase.h"
 #include "pkgkeys.h"
 #include "pkgopts.h"
+#include "pkgimage.h"
+
+static const char *catalogue_image( const char *name )
+{
+  /* Construct the full path name for the compiled image of a named
+   * catalogue; (this is analogous to xmlfile(), but the image files
+   * are maintained within the local cache, rather than alongside the
+   * working copies of the catalogues themselves).
+   */
+  const char *imagepath = "%R" "var/cache/mingw-get/data" "%/M/%F.bin";
+  char *imagefile = (char *)(malloc( mkpath( NULL, imagepath, name, NULL ) ));
+
+  mkpath( imagefile, imagepath, name, NULL );
+  return (const char *)(imagefile);
+}
 
 class pkgRepository
 {
@@ -86,52 +102,97 @@ void pkgRepository::GetPackageList( const char *dname )
       }
 
       /* We SHOULD now have a locally cached copy of the package-list;
-       * attempt to merge it into the active profile database...
+       * before we resort to parsing it, check for a compiled image of
+       * it, which remains current with respect to the XML source...
        */
-      pkgXmlDocument merge( dfile );
-      if( merge.IsOk() )
+      const char *imagefile = catalogue_image( dname );
+      pkgXmlImage image( imagefile, dfile );
+      pkgXmlNode references( package_list_key );
+      int restored = -1;
+      if( image.IsOk()
+      &&  (image.Restore( &references, package_list_key ) >= 0)  )
       {
-	/* We successfully loaded the XML catalogue; refer to its
-	 * root element...
+	/* ...in which case, having restored its references to any
+	 * additional package lists into a local container, (which is
+	 * discarded when we are done with it), we may simply restore its
+	 * "package-collection" records directly into the active profile
+	 * database, (allocating them within the storage arena of that
+	 * database); should the image prove to be corrupt, this leaves
+	 * the database unchanged...
+	 */
+	TiXmlArena::Scope arena( owner->Arena() );
+	restored = image.Restore( dbase, package_collection_key );
+      }
+      if( restored >= 0 )
+      {
+	/* ...and, when it has been successfully restored, recursively
+	 * incorporate those additional package lists.
 	 */
 	if( pkgOptions()->Test( OPTION_VERBOSE ) > 1 )
-	  dmh_printf( "Load catalogue: %s.xml\n", dname );
-	pkgXmlNode *catalogue, *pkglist;
-	if( (catalogue = merge.GetRoot()) != NULL )
+	  dmh_printf( "Load catalogue: %s.xml (compiled image)\n", dname );
+	GetPackageList( references.FindFirstAssociate( package_list_key ) );
+      }
+      else
+      { /* There is no current image, (or it has proven to be corrupt);
+	 * attempt to merge the XML source into the active profile database...
+	 */
+	pkgXmlDocument merge( dfile );
+	if( merge.IsOk() )
 	{
-	  /* ...read it, selecting each of the "package-collection"
-	   * records contained within it...
+	  /* We successfully loaded the XML catalogue; refer to its
+	   * root element...
 	   */
-	  pkglist = catalogue->FindFirstAssociate( package_collection_key );
-	  while( pkglist != NULL )
+	  if( pkgOptions()->Test( OPTION_VERBOSE ) > 1 )
+	    dmh_printf( "Load catalogue: %s.xml\n", dname );
+	  pkgXmlNode *catalogue, *pkglist;
+	  if( (catalogue = merge.GetRoot()) != NULL )
 	  {
-	    /* ...and append a copy of each to the active profile...
+	    /* ...and compile an image of it, so that we may avoid the
+	     * overhead of parsing it again, on subsequent invocations,
+	     * unless it is updated in the meantime; (this is merely an
+	     * optimisation, so failure is not an error, but we may note
+	     * it, when running verbosely; note too, that we must do this
+	     * before we move any of its content into the profile)...
 	     */
-	    dbase->LinkEndChild( pkglist->Clone() );
+	    if( (pkgXmlImage::Compile( imagefile, dfile, catalogue ) != 0)
+	    &&  (pkgOptions()->Test( OPTION_VERBOSE ) > 1)  )
+	      dmh_printf( "%s: cannot save catalogue image\n", imagefile );
 
-	    /* Move on to the next "package-collection" (if any)
-	     * within the current catalogue...
+	    /* Now, read it, selecting each of the "package-collection"
+	     * records contained within it...
 	     */
-	    pkglist = pkglist->FindNextAssociate( package_collection_key );
-	  }
+	    pkglist = catalogue->FindFirstAssociate( package_collection_key );
+	    while( pkglist != NULL )
+	    {
+	      /* ...noting the next "package-collection" (if any) within
+	       * the current catalogue, before we move the current one, (and
+	       * its storage), out of the catalogue, and into the profile.
+	       */
+	      pkgXmlNode *collection = pkglist;
+	      pkglist = pkglist->FindNextAssociate( package_collection_key );
+	      dbase->AdoptChild( collection );
+	    }
 
-	  /* Recursively incorporate any additional package lists,
-	   * which may be specified within the current catalogue...
+	    /* ...then recursively incorporate any additional package lists,
+	     * which may be specified within the current catalogue...
+	     */
+	    GetPackageList( catalogue->FindFirstAssociate( package_list_key ) );
+	  }
+	}
+	else
+	{ /* The specified catalogue could not be successfully loaded;
+	   * emit a warning diagnostic message, and otherwise ignore it.
 	   */
-	  GetPackageList( catalogue->FindFirstAssociate( package_list_key ) );
+	  dmh_notify( DMH_WARNING, "Load catalogue: FAILED: %s.xml\n", dname );
 	}
       }
-      else
-      { /* The specified catalogue could not be successfully loaded;
-	 * emit a warning diagnostic message, and otherwise ignore it.
-	 */
-	dmh_notify( DMH_WARNING, "Load catalogue: FAILED: %s.xml\n", dname );
-      }
 
-      /* However we handled it, the XML file's path name in "dfile" was
-       * allocated on the heap; we lose its reference on termination of
-       * this loop, so we must free it to avoid a memory leak.
+      /* However we handled it, the XML file's path name in "dfile", and
+       * the path name of its compiled image, were allocated on the heap;
+       * we lose these references on termination of this loop, so we must
+       * free them to avoid memory leaks.
        */
+      free( (void *)(imagefile) );
       free( (void *)(dfile) );
     }
   }
@@ -27,6 +27,7 @@
  * arising from the use of this software.
  *
  */
+#include <stdlib.h>
 #include <string.h>
 
 #include "dmh.h"
@@ -107,47 +108,6 @@ static bool is_installed( pkgXmlNode *release )
   return false;
 }
 
-pkgXmlNode *pkgXmlNode::GetInstallationRecord( const char *pkgname )
-{
-  /* Retrieve the installation record, if any, for the package
-   * specified by fully qualified canonical 'pkgname'.
-   *
-   * First, break down the specified package name, and retrieve
-   * the sysroot database entry for its associated subsystem.
-   */
-  pkgXmlNode *sysroot;
-  pkgSpecs lookup( pkgname );
-  if( (sysroot = GetSysRoot( lookup.GetSubSystemName() )) != NULL )
-  {
-    /* We successfully retrieved a sysroot entry; now we must
-     * search the associated list of installed packages, for one
-     * with the appropriate canonical package name.
-     */
-    pkgXmlNode *pkg = sysroot->FindFirstAssociate( installed_key );
-    while( pkg != NULL )
-    {
-      /* We found an installed package entry; check if it has
-       * the correct canonical name...
-       */
-      const char *installed = pkg->GetPropVal( tarname_key, NULL );
-      if( (installed != NULL) && (strcmp( installed, pkgname ) == 0) )
-	/*
-	 * ...returning this entry if so...
-	 */
-	return pkg;
-
-      /* ...otherwise, move on to the next entry, if any.
-       */
-      pkg = pkg->FindNextAssociate( installed_key );
-    }
-  }
-
-  /* If we get to here, we didn't find an entry for the required
-   * package; return NULL, indicating that it is not installed.
-   */
-  return NULL;
-}
-
 const char *pkgXmlNode::GetContainerAttribute( const char *key, const char *sub )
 {
   /* Walk the XML path from current element, back towards the document root,
@@ -251,6 +211,110 @@ STATIC_INLINE unsigned long promote
   return with_request_flags( request ) | with_download( action_code );
 }
 
+class pkgDependencyMemo
+{
+  /* A locally implemented class, used by ResolveDependencies() to
+   * record each requirement for which dependencies have already been
+   * resolved, during the current Schedule() pass; the key identifies
+   * the requirement by its version bounds, (after resolution of any
+   * inherited version numbers), together with the request mode which
+   * was then in effect.  Once recorded, any subsequent resolution of
+   * an identical requirement must select the same release, and could
+   * only reproduce the scheduling outcome of the first, so recursion
+   * into its dependencies may be skipped.  This avoids repeated
+   * evaluation of common prerequisites, (such as the runtime library),
+   * when they are reached by many paths through the dependency graph,
+   * and also guards against infinite recursion, in the event of
+   * circular dependencies.
+   */
+  public:
+    pkgDependencyMemo():table( NULL ), size( 0 ), count( 0 ){}
+    ~pkgDependencyMemo();
+
+    bool Record( unsigned long, unsigned long, pkgActionItem& );
+
+  private:
+    struct entry { char *key; unsigned long hash; } *table;
+    unsigned long size, count;
+};
+
+pkgDependencyMemo::~pkgDependencyMemo()
+{
+  /* Destructor: release the recorded keys, and the table itself.
+   */
+  for( unsigned long i = 0; i < size; i++ )
+    free( (void *)(table[i].key) );
+  free( (void *)(table) );
+}
+
+bool pkgDependencyMemo::Record
+( unsigned long mode, unsigned long request, pkgActionItem &wanted )
+{
+  /* Record the requirement specified for "wanted", when resolved with
+   * the specified option "mode" and "request" flags; return true if
+   * this is the first such record, or false if an identical requirement
+   * has been recorded previously.
+   */
+  const char *min, *max;
+  if( (min = wanted.MinWanted()) == NULL )
+    min = "";
+  if( (max = wanted.MaxWanted()) == NULL )
+    max = "";
+
+  char key[48 + strlen( min ) + strlen( max )];
+  int len = sprintf( key, "%lx:%lx:%lx:%s:%s", mode, request,
+      wanted.HasAttribute( STRICTLY_GT | STRICTLY_LT ), min, max
+    );
+  unsigned long hash = pkg_name_hash( key, len );
+
+  if( (count + 1) * 2 > size )
+  {
+    /* The table is becoming crowded, (or has not yet been created);
+     * double its size, and rehash any existing entries.
+     */
+    unsigned long new_size = size ? size << 1 : 256;
+    struct entry *new_table;
+    if( (new_table = (struct entry *)(calloc( new_size, sizeof( struct entry ) ))) == NULL )
+      /*
+       * We cannot extend the record; this isn't fatal, since we
+       * may simply proceed to resolve the request anyway.
+       */
+      return true;
+
+    for( unsigned long i = 0; i < size; i++ )
+      if( table[i].key != NULL )
+      {
+	unsigned long slot = table[i].hash & (new_size - 1);
+	while( new_table[slot].key != NULL ) slot = (slot + 1) & (new_size - 1);
+	new_table[slot] = table[i];
+      }
+    free( (void *)(table) );
+    table = new_table; size = new_size;
+  }
+
+  unsigned long slot = hash & (size - 1);
+  while( table[slot].key != NULL )
+  {
+    if( (table[slot].hash == hash) && (strcmp( table[slot].key, key ) == 0) )
+      return false;
+    slot = (slot + 1) & (size - 1);
+  }
+  if( (table[slot].key = strdup( key )) != NULL )
+  {
+    table[slot].hash = hash;
+    ++count;
+  }
+  return true;
+}
+
+void pkgXmlDocument::DiscardResolvedDependencies()
+{
+  /* Release the record of resolved dependencies, if any.
+   */
+  delete resolved;
+  resolved = NULL;
+}
+
 void
 pkgXmlDocument::ResolveDependencies( pkgXmlNode* package, pkgActionItem* rank )
 {
@@ -495,10 +559,27 @@ pkgXmlDocument::ResolveDependencies( pkgXmlNode* package, pkgActionItem* rank )
 	/* Regardless of the action scheduled, we must recursively
 	 * consider further dependencies of the resolved prerequisite;
 	 * FIXME: do we need to do this, when performing a removal?
-	 * Right now, I (KDM) don't think so...
+	 * Right now, I (KDM) don't think so...  Nor do we need to do
+	 * it for any requirement which has already been resolved, in
+	 * the same request mode, (or which is currently being resolved,
+	 * further up the recursion stack), during this Schedule() pass.
 	 */
-	if( (request & ACTION_INSTALL) != 0 )
-	  ResolveDependencies( selected, rank );
+	if( ((request & ACTION_INSTALL) != 0) && (selected != NULL) )
+	{
+	  if( resolved == NULL )
+	    resolved = new pkgDependencyMemo();
+
+	  if( resolved->Record( request_mode, request, wanted ) )
+	    ResolveDependencies( selected, rank );
+
+	  else
+	  { DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_DEPENDENCIES ),
+		dmh_printf( "%*s%s: dependencies already resolved\n", indent + 2, "",
+		    selected->GetPropVal( tarname_key, value_unknown )
+		  )
+	      );
+	  }
+	}
       }
 
       if( selected == NULL )
@@ -873,8 +954,11 @@ void pkgXmlDocument::Schedule( unsigned long action, const char* name )
 {
   /* Task scheduler interface; schedules actions to process all
    * dependencies for the package specified by "name", honouring
-   * any appended version bounds specified for the parent.
+   * any appended version bounds specified for the parent.  Each such
+   * request begins a new dependency resolution pass; any record of
+   * requirements resolved by an earlier pass is no longer valid.
    */
+  DiscardResolvedDependencies();
   char scratch_pad[strlen( name )];
   const char *bounds_specification = get_version_bounds( name );
   if( bounds_specification != NULL )
@@ -52,7 +52,9 @@ EXTERN_C const char *action_name( unsigned long index )
 
     "update",		/* update local copy of repository catalogues	    */
     "licence",		/* retrieve licence sources from repository	    */
-    "source"		/* retrieve package sources from repository	    */
+    "source",		/* retrieve package sources from repository	    */
+
+    "owner"		/* identify installed packages which provide files  */
   };
 
   /* For specified "index", return a pointer to the associated keyword,
@@ -158,6 +160,12 @@ pkgActionItem::pkgActionItem( pkgActionItem *after, pkgActionItem *before )
   /* Initialise package selection to NONE, for this action... */
   selection[to_remove] = selection[to_install] = NULL;
 
+  /* ...with no archive stream yet prepared for installation, */
+  archive_stream = NULL;
+
+  /* ...nor any prior installation retained for replacement. */
+  retained_inventory = NULL;
+
   /* Insert this item at a specified location in the actions list.
    */
   prev = after;
@@ -429,6 +437,25 @@ int reinstall_action_scheduled( pkgActionItem *package )
     );
 }
 
+EXTERN_C void pkgExportSysRoot( const char *path )
+{
+  /* Package pre/post processing scripts may need to refer to
+   * the sysroot path for the package; this places a copy of it
+   * in the environment, to facilitate this.  The path name must
+   * be specified with all macros, such as "%R", already expanded,
+   * as it is when retrieved by GetSysRoot().
+   */
+  if( path != NULL )
+  {
+    /* Format the sysroot path into an environment variable
+     * assignment specification.
+     */
+    char varspec[9 + strlen( path )];
+    sprintf( varspec, "SYSROOT=%s", path );
+    pkgPutEnv( PKG_PUTENV_DIRSEP_MSW, varspec );
+  }
+}
+
 void pkgActionItem::Execute()
 {
   if( this != NULL )
@@ -442,13 +469,29 @@ void pkgActionItem::Execute()
      * package URIs which the operation would access)...
      */
     if( pkgOptions()->Test( OPTION_PRINT_URIS ) < OPTION_PRINT_URIS )
-      do {
-	   /* ...we initiate any download requests which may
-	    * be necessary to fetch all required archives into
-	    * the local package cache.
-	    */
-	   DownloadArchiveFiles( current );
-	 } while( SetAuthorities( current ) > 0 );
+    {
+      if( pkgOptions()->Test( OPTION_DOWNLOAD_ONLY ) == OPTION_DOWNLOAD_ONLY )
+	do {
+	     /* ...we initiate any download requests which may
+	      * be necessary to fetch all required archives into
+	      * the local package cache...
+	      */
+	     DownloadArchiveFiles( current );
+	   } while( SetAuthorities( current ) > 0 );
+
+      else
+      { /* ...or, when we are to proceed to installation, we first
+	 * establish authorities for package removal, (which do not
+	 * depend on the outcome of any download), then we initiate
+	 * the downloads in the background, so that installation of
+	 * each package may begin as soon as its archive, and those
+	 * of all packages scheduled before it, are available.
+	 */
+	while( SetAuthorities( current ) > 0 )
+	  ;
+	DownloadArchiveFiles( current, true );
+      }
+    }
 
     else while( current != NULL )
     {
@@ -467,8 +510,12 @@ void pkgActionItem::Execute()
      */
     if( pkgOptions()->Test( OPTION_DOWNLOAD_ONLY ) != OPTION_DOWNLOAD_ONLY )
     {
-      /* ...otherwise...
+      /* ...otherwise, noting that the file system effects of all package
+       * removals are to be completed together, after all other actions,
+       * (so that directories shared by many packages are pruned only once,
+       * rather than once for each package)...
        */
+      pkgRemovalBatch removals;
       while( current != NULL )
       {
 	/* ...processing only those packages with assigned actions...
@@ -491,26 +538,12 @@ void pkgActionItem::Execute()
 	    );
 
 	  /* Package pre/post processing scripts may need to
-	   * refer to the sysroot path for the package; place
-	   * a copy in the environment, to facilitate this.
+	   * refer to the sysroot path for the package.
 	   */
+	  const char *path;
 	  pkgSpecs lookup( tarname );
-	  ref = ref->GetSysRoot( lookup.GetSubSystemName() );
-	  const char *path = ref->GetPropVal( pathname_key, NULL );
-	  if( path != NULL )
-	  {
-	    /* Format the sysroot path into an environment variable
-	     * assignment specification; note that the recorded path
-	     * name is likely to include macros such as "%R", so we
-	     * filter it through mkpath(), to expand them.
-	     */
-	    const char *nothing = "";
-	    char varspec_template[9 + strlen( path )];
-	    sprintf( varspec_template, "SYSROOT=%s", path );
-	    char varspec[mkpath( NULL, varspec_template, nothing, NULL )];
-	    mkpath( varspec, varspec_template, nothing, NULL );
-	    pkgPutEnv( PKG_PUTENV_DIRSEP_MSW, varspec );
-	  }
+	  ref->GetSysRoot( lookup.GetSubSystemName(), &path );
+	  pkgExportSysRoot( path );
 
 	  /* Check for any outstanding requirement to invoke the
 	   * "self upgrade rites" process, so that we may install an
@@ -541,8 +574,26 @@ void pkgActionItem::Execute()
 
 	  else
 	  { /* ...otherwise, proceed to perform remove and install
-	     * operations, as appropriate.
+	     * operations, as appropriate, (but only when any download
+	     * which is in progress, for the package to be installed,
+	     * has been completed); when the user has asked for
+	     * package archives to be streamed directly into the installer,
+	     * this is the time to initiate the download of any which are
+	     * not already present in the local cache; (we never stream an
+	     * archive which is to replace a prior installation, since that
+	     * is removed before the stream is read, and would be lost if
+	     * the download were to fail; DownloadArchiveFiles() has then
+	     * fetched the archive in full, as if we were not streaming).
 	     */
+	    current->AwaitArchiveDownload();
+	    if(  ((current->flags & ACTION_INSTALL) == ACTION_INSTALL)
+	    &&   ((current->flags & ACTION_DOWNLOAD) == ACTION_DOWNLOAD)
+	    &&   (current->Selection( to_remove ) == NULL)
+	    &&   (pkgOptions()->Test( OPTION_STREAM_INSTALL ) == OPTION_STREAM_INSTALL)  )
+	      current->StreamSingleArchive(
+		  current->Selection()->ArchiveName(), pkgArchivePath()
+		);
+
 	    if(   reinstall_action_scheduled( current )
 	    ||  ((current->flags & ACTION_REMOVE) == ACTION_REMOVE)  )
 	    {
@@ -571,10 +622,29 @@ void pkgActionItem::Execute()
 	 */
 	current = current->next;
       }
+      /* Any downloads which remain in progress, (e.g. for packages
+       * which proved to be up to date), must be allowed to complete.
+       */
+      FinishArchiveDownloads();
+
+      /* Finally, complete all package removals, and run any post-remove
+       * scripts which were deferred until then.
+       */
+      removals.Complete();
     }
   }
 }
 
+void pkgActionItem::CancelInstallation()
+{
+  /* Cancel the installation, if any, which is scheduled for this action
+   * item; (this is invoked by the remover, when it cannot safely remove
+   * a prior installation, which the scheduled installation was intended
+   * to replace).
+   */
+  flags &= ~(ACTION_INSTALL);
+}
+
 pkgActionItem::~pkgActionItem()
 {
   /* Destructor...
@@ -597,6 +667,16 @@ pkgActionItem::~pkgActionItem()
      * the same memory referenced by "max_wanted".
      */
     free( (void *)(min_wanted) );
+
+  /* Any archive stream which was prepared for installation, but
+   * never delivered to the installer, must also be deleted.
+   */
+  delete archive_stream;
+
+  /* Similarly, any retained prior installation which the installer
+   * never claimed must be deleted; (this completes its removal).
+   */
+  delete retained_inventory;
 }
 
 /*
@@ -25,155 +25,264 @@
  * arising from the use of this software.
  *
  */
+#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "pkgbase.h"
 #include "pkgkeys.h"
 
-pkgXmlNode *
-pkgXmlDocument::FindPackageByName( const char *lookup, const char *subsystem )
+class pkgPackageIndex
 {
-  /* Create a local copy of the package "name" which we are required to
-   * "lookup"; this allows us to make temporary adjustments to facilitate
-   * stripping of any "component" identifying suffix, which might occlude
-   * a match for a package "alias" name.
+  /* A locally implemented class, providing a hashed index of all
+   * names by which a package, or a package component, may be found;
+   * this comprises the "name" of each package, each keyword within
+   * its "alias" list, the "name" of each component, and each of the
+   * "package-class" names which are synthesised for components, by
+   * combining the package name, or any alias, with the component's
+   * "class" property.
    */
-  int len; char name[ 1 + (len = strlen( lookup )) ];
-  strcpy( name, lookup );
+  public:
+    pkgPackageIndex( pkgXmlNode* );
+    ~pkgPackageIndex();
+
+    pkgXmlNode *Lookup( const char*, const char* );
 
-  /* Working from the root of the package directory tree...
+  private:
+    struct entry
+    {
+      /* Each entry associates one name with the database element
+       * to which it refers; it also records the "subsystem" property
+       * of the "package-collection" in which the element is found, and
+       * a sequence number, to identify the first of multiple entries
+       * for any one name, in document order.
+       */
+      entry		*next;
+      pkgXmlNode	*node;
+      const char	*subsystem;
+      unsigned long	 sequence;
+      char		 name[1];
+    };
+    entry **table;
+    unsigned long size, count;
+
+    void Add( const char*, size_t, const char*, pkgXmlNode* );
+    void AddAliases( const char*, const char*, const char*, pkgXmlNode* );
+};
+
+void pkgPackageIndex::Add
+( const char *name, size_t len, const char *subsystem, pkgXmlNode *node )
+{
+  /* Add a single entry to the index, growing the hash table as
+   * required, to keep the average chain length below two entries.
    */
-  pkgXmlNode *dir = GetRoot()->GetChildren();
-  /*
-   * search all "package-collection" XML nodes, to locate a package
-   * by "name"; return a pointer to the XML node which contains the
-   * specification for the package, or NULL if no such package.
+  if( count >= (size << 1) )
+  {
+    unsigned long new_size = size << 1;
+    entry **new_table = (entry **)(calloc( new_size, sizeof( entry * ) ));
+    if( new_table != NULL )
+    {
+      /* We can rehash the existing entries in any order, since
+       * the sequence numbers preserve the order of precedence.
+       */
+      for( unsigned long i = 0; i < size; i++ )
+	while( table[i] != NULL )
+	{
+	  entry *ref = table[i]; table[i] = ref->next;
+	  unsigned long slot = pkg_name_hash( ref->name, strlen( ref->name ) );
+	  ref->next = new_table[slot &= new_size - 1]; new_table[slot] = ref;
+	}
+      free( (void *)(table) );
+      table = new_table; size = new_size;
+    }
+  }
+
+  entry *ref = (entry *)(malloc( sizeof( entry ) + len ));
+  if( ref != NULL )
+  {
+    memcpy( ref->name, name, len ); ref->name[len] = '\0';
+    ref->node = node; ref->subsystem = subsystem; ref->sequence = count++;
+    unsigned long slot = pkg_name_hash( name, len ) & (size - 1);
+    ref->next = table[slot]; table[slot] = ref;
+  }
+}
+
+void pkgPackageIndex::AddAliases
+( const char *list, const char *suffix, const char *subsystem, pkgXmlNode *node )
+{
+  /* Add an index entry for each keyword in a white space separated
+   * alias list, (with an optional "-suffix" appended to each).
+   */
+  while( (list != NULL) && (*list != '\0') )
+  {
+    /* Skip any leading white space, then identify the extent of the
+     * next keyword in the list...
+     */
+    while( isspace( *list ) ) ++list;
+    const char *end = list;
+    while( *end && ! isspace( *end ) ) ++end;
+    if( end > list )
+    {
+      /* ...and index it, (appending the suffix, if specified).
+       */
+      size_t len = end - list;
+      if( suffix == NULL )
+	Add( list, len, subsystem, node );
+
+      else
+      { size_t extlen = strlen( suffix );
+	char name[len + extlen + 2];
+	memcpy( name, list, len ); name[len] = '-';
+	memcpy( name + len + 1, suffix, extlen + 1 );
+	Add( name, len + extlen + 1, subsystem, node );
+      }
+    }
+    list = end;
+  }
+}
+
+pkgPackageIndex::pkgPackageIndex( pkgXmlNode *dbase ):
+table( (entry **)(calloc( 1024, sizeof( entry * ) )) ), size( 1024 ), count( 0 )
+{
+  /* Constructor: walk the entire package directory, indexing every
+   * name which FindPackageByName() should recognise; note that this
+   * must visit elements in the same order as a sequential search, so
+   * that the assigned sequence numbers reproduce its precedence.
    */
-  while( dir != NULL )
+  if( table == NULL ) size = 0;
+  pkgXmlNode *dir = dbase->FindFirstAssociate( package_collection_key );
+  while( (dir != NULL) && (table != NULL) )
   {
-    /* Select only "package-collection" elements, which have been
-     * assigned the desired "subsystem" property...
+    /* For each "package-collection", we must note its "subsystem"
+     * property, which qualifies all of the names within it...
      */
-    if( dir->IsElementOfType( package_collection_key )
-    &&  subsystem_strcmp( subsystem, dir->GetPropVal( subsystem_key, NULL )) )
+    const char *subsystem = dir->GetPropVal( subsystem_key, NULL );
+    pkgXmlNode *pkg = dir->FindFirstAssociate( package_key );
+    while( pkg != NULL )
     {
-      /* ...inspect the content of each...
+      /* ...then, for each "package" element, we index its "name",
+       * and any keywords from its "alias" list...
        */
-      pkgXmlNode *pkg = dir->GetChildren();
-      while( pkg != NULL )
+      const char *pkg_name = pkg->GetPropVal( name_key, "" );
+      const char *alias = pkg->GetPropVal( alias_key, NULL );
+      Add( pkg_name, strlen( pkg_name ), subsystem, pkg );
+      AddAliases( alias, NULL, subsystem, pkg );
+
+      pkgXmlNode *cpt = pkg->FindFirstAssociate( component_key );
+      while( cpt != NULL )
       {
-	/* ...and, for each "package" element we find...
+	/* ...and for each "component" element within it, we index
+	 * its own "name", and the alternatives formed by combining its
+	 * "class" with the package "name", or with any "alias".
 	 */
-	if( pkg->IsElementOfType( package_key ) )
-	{
-	  /* ...return immediately, if it has a "name" or an "alias"
-	   * property which matches the required package name...
-	   */
-	  const char *pkg_name, *alias;
-	  if( (strcmp( name, pkg_name = pkg->GetPropVal( name_key, "" )) == 0)
-	  ||  (has_keyword( name, alias = pkg->GetPropVal( alias_key, NULL ) ) != 0)  )
-	    return pkg;
-
-	  /* We did find a "package" element, but neither its "name"
-	   * nor its "alias" property provided a match; look within it,
-	   * for a possible match on a "component" package element...
-	   */
-	  pkgXmlNode *cpt = pkg->GetChildren();
-	  while( cpt != NULL )
-	  {
-	    /* For each element contained within the "package" definition,
-	     * check if it represents a "component" package definition...
-	     */
-	    if( cpt->IsElementOfType( component_key ) )
-	    {
-	      /* ...and return immediately, when it does, AND it also has a
-	       * "name" property which matches the required package name...
-	       */
-	      if( strcmp( name, cpt->GetPropVal( name_key, "" )) == 0 )
-		return cpt;
-
-	      else
-	      { /* We did find a "component" package, but its "name"
-		 * property didn't match; construct an alternative name,
-		 * by combining the "class" property of the "component"
-		 * with the "name" property of the containing "package",
-		 * and evaluate that for a possible match...
-		 */
-		const char *cpt_class = cpt->GetPropVal( class_key, "" );
-		char *cpt_name = name + len - strlen( cpt_class );
-		if( (strcmp( cpt_name, cpt_class ) == 0)
-		&&  (*--cpt_name == '-')  )
-		{
-		  /* Again, return the "component", if this identifies
-		   * a successful match...
-		   */
-		  *cpt_name = '\0';
-		  if( (strcmp( name, pkg_name ) == 0) || has_keyword( name, alias ) )
-		    return cpt;
-
-		  /* Otherwise, restore the original content of the
-		   * working copy of the "lookup name", in preperation
-		   * for any subsequent attempt to find a match.
-		   */
-		  *cpt_name = '-';
-		}
-	      }
-	    }
-
-	    /* ...otherwise, continue checking any other "components"
-	     * which may be defined within the current "package.
-	     */
-	    cpt = cpt->GetNext();
-	  }
-	}
+	const char *cpt_name = cpt->GetPropVal( name_key, "" );
+	const char *cpt_class = cpt->GetPropVal( class_key, "" );
+	Add( cpt_name, strlen( cpt_name ), subsystem, cpt );
+	AddAliases( pkg_name, cpt_class, subsystem, cpt );
+	AddAliases( alias, cpt_class, subsystem, cpt );
 
-	/* ...otherwise, continue searching among any further
-	 * entries in the current "package-collection"...
-	 */
-	pkg = pkg->GetNext();
+	cpt = cpt->FindNextAssociate( component_key );
       }
+      pkg = pkg->FindNextAssociate( package_key );
     }
-    /* ...and ultimately, in any further "package-collection" elements
-     * which may be present.
-     */
-    dir = dir->GetNext();
+    dir = dir->FindNextAssociate( package_collection_key );
   }
+}
 
-  /* If we get to here, we didn't find the required "package";
-   * return NULL, to indicate failure.
+pkgPackageIndex::~pkgPackageIndex()
+{
+  /* Destructor: release all memory allocated to the index.
    */
-  return NULL;
+  for( unsigned long i = 0; i < size; i++ )
+    while( table[i] != NULL )
+    {
+      entry *ref = table[i]; table[i] = ref->next;
+      free( (void *)(ref) );
+    }
+  free( (void *)(table) );
 }
 
-static
-pkgXmlNode* pkgFindNextAssociate( pkgXmlNode* pkg, const char* tagname )
+pkgXmlNode *pkgPackageIndex::Lookup( const char *name, const char *subsystem )
 {
-  /* Core implementation for both pkgXmlNode::FindFirstAssociate
-   * and pkgXmlNode::FindNextAssociate methods.  This helper starts
-   * at the node specified by "pkg", examining it, and if necessary,
-   * each of its siblings in turn, until one of an element type
-   * matching "tagname" is found.
+  /* Retrieve the first element, in document order, which is known
+   * by "name", within a "package-collection" which is compatible with
+   * the specified "subsystem"; return NULL, if there is none.
    */
-  while( pkg != NULL )
+  entry *found = NULL;
+  if( size > 0 )
   {
-    /* We still have this "pkg" node, not yet examined...
-     */
-    if( pkg->IsElementOfType( tagname ) )
-      /*
-       * ...it matches our search criterion; return it...
-       */
-      return pkg;
+    entry *ref = table[pkg_name_hash( name, strlen( name ) ) & (size - 1)];
+    while( ref != NULL )
+    {
+      if( ((found == NULL) || (ref->sequence < found->sequence))
+      &&  (strcmp( ref->name, name ) == 0)
+      &&  subsystem_strcmp( subsystem, ref->subsystem )  )
+	found = ref;
+      ref = ref->next;
+    }
+  }
+  return (found != NULL) ? found->node : NULL;
+}
 
-    /* The current "pkg" node didn't match our criterion;
-     * move on, to examine its next sibling, if any...
-     */
-    pkg = pkg->GetNext();
+pkgXmlDocument::~pkgXmlDocument()
+{
+  /* Destructor: discard the package name index, the record of
+   * resolved dependencies, and the sysroot map, if any.
+   */
+  delete package_index; package_index = NULL;
+  DiscardResolvedDependencies();
+  DiscardSysRootMap();
+}
+
+void pkgXmlDocument::ContentChanged( TiXmlNode *node )
+{
+  /* Discard the package name index, if the children, or attributes,
+   * of "node" are changed, and the index depends on them; this is the
+   * case for the document itself, its root element, and each element
+   * representing a package-collection, a package, or a component, (for
+   * which only changes to the name, alias, class, or subsystem attributes
+   * are significant, but those to any others are sufficiently rare that
+   * we need not distinguish them).
+   */
+  if( (package_index != NULL) && (  (node == this) || (node->Parent() == this)
+  ||  ((pkgXmlNode *)(node))->IsElementOfType( package_collection_key )
+  ||  ((pkgXmlNode *)(node))->IsElementOfType( package_key )
+  ||  ((pkgXmlNode *)(node))->IsElementOfType( component_key ))  )
+  {
+    delete package_index;
+    package_index = NULL;
   }
+}
+
+pkgXmlNode *
+pkgXmlDocument::FindPackageByName( const char *lookup, const char *subsystem )
+{
+  /* Search all "package-collection" XML nodes, to locate a package,
+   * or a package component, by "name"; return a pointer to the XML
+   * node which contains its specification, or NULL if no such package.
+   *
+   * Rather than walking the entire package directory, for each look-up,
+   * we consult an index of all known package names; this is constructed
+   * on first use, and rebuilt after any change to the package catalogue
+   * has caused ContentChanged() to discard it.
+   */
+  if( package_index == NULL )
+    package_index = new pkgPackageIndex( GetRoot() );
+  return package_index->Lookup( lookup, subsystem );
+}
 
-  /* We ran out of siblings to examine, without finding any
-   * to match our criterion; return nothing...
+void pkgXmlDocument::RegisterKeys()
+{
+  /* Register each of the standard XML database keys as an interned
+   * name, (once only), so that each becomes its own atom.
    */
-  return NULL;
+  static bool registered = false;
+  if( ! registered )
+  {
+    for( const char ***key = pkg_xml_keys; *key != NULL; key++ )
+      TiXmlAtom::Register( **key );
+    registered = true;
+  }
 }
 
 pkgXmlNode*
@@ -182,8 +291,18 @@ pkgXmlNode::FindFirstAssociate( const char* tagname )
   /* For the node on which this method is invoked,
    * return the first, if any, of its immediate children,
    * which is an element of the type specified by "tagname"...
+   *
+   * Element names are interned, so we resolve "tagname" to its
+   * atom, and delegate the search to tinyxml, which compares only
+   * atoms; (if "tagname" has never been interned, then no element
+   * can match it).  Where the search must skip many siblings, the
+   * children of this node are indexed by atom, so that this, and
+   * each subsequent search among them, visits matching elements
+   * only; (any change to the children discards that index).
    */
-  return this ? pkgFindNextAssociate( GetChildren(), tagname ) : NULL;
+  return this
+    ? (pkgXmlNode*)(FirstChildOfAtom( TiXmlAtom::Find( tagname ) ))
+    : NULL;
 }
 
 pkgXmlNode*
@@ -194,7 +313,9 @@ pkgXmlNode::FindNextAssociate( const char* tagname )
    * return the next sibling node, if any, which is an element
    * of the type specified by "tagname"...
    */
-  return this ? pkgFindNextAssociate( GetNext(), tagname ) : NULL;
+  return this
+    ? (pkgXmlNode*)(NextSiblingOfAtom( TiXmlAtom::Find( tagname ) ))
+    : NULL;
 }
 
 /* $RCSfile: pkgfind.cpp,v $: end of file */
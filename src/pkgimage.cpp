@@ -0,0 +1,615 @@
+/*
+ * pkgimage.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Implementation of the pkgXmlImage class; this provides methods for
+ * compiling XML data, (typically package catalogues), into a binary
+ * image file, and for restoring the XML content from such an image,
+ * without incurring the overhead of parsing the XML source.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "mkpath.h"
+#include "pkgkeys.h"
+#include "pkgimage.h"
+
+#ifndef O_BINARY
+/*
+ * MS-Windows nuisances...
+ * Files are expected to be either explicitly text or binary;
+ * (UNIX makes no such specific distinction).  We want to force
+ * treatment of all files as binary; define a "no-op" substitute
+ * for the appropriate MS-Windows attribute, for when we compile
+ * on UNIX, so we may henceforth just use it unconditionally.
+ */
+# ifdef _O_BINARY
+#  define O_BINARY _O_BINARY
+# else
+#  define O_BINARY  0
+# endif
+#endif
+
+/* The signature, and format version, which identify a compiled image;
+ * note that, since the image is intended only as a local cache, it is
+ * always written in host byte order; the version number is chosen such
+ * that it will not match, if the image is read with the opposite byte
+ * order, so that such an image will simply be discarded.
+ */
+#define PKGIMAGE_MAGIC		"MGXI"
+#define PKGIMAGE_VERSION	0x00010000UL
+
+/* Type codes, used to identify each entity record within the image.
+ */
+#define PKGIMAGE_ELEMENT	1
+#define PKGIMAGE_TEXT		2
+
+struct pkgXmlImageHeader
+{
+  /* Layout specification for the fixed format header, which
+   * introduces each compiled image file.
+   */
+  char		magic[4];	/* signature: PKGIMAGE_MAGIC */
+  uint32_t	version;	/* format version: PKGIMAGE_VERSION */
+  int64_t	mtime;		/* last modification time of XML source */
+  int64_t	length;		/* size of XML source file, in bytes */
+  uint32_t	serial;		/* pool offset of source's issue serial */
+  uint32_t	entities;	/* number of words in entity table */
+  uint32_t	pool_size;	/* number of bytes in string pool */
+  uint32_t	reserved;	/* padding; always zero */
+};
+
+/* Each entity record within the entity table is expressed as a
+ * sequence of 32-bit words; the first word specifies the entity type,
+ * and the second specifies the total number of words in the record,
+ * (including those of all nested records), so that any record may be
+ * skipped without inspection of its content.  The remaining words
+ * are as follows:
+ *
+ *   PKGIMAGE_TEXT:	pool offset of the text
+ *
+ *   PKGIMAGE_ELEMENT:	pool offset of the tag name,
+ *   			number of attributes,
+ *   			number of child entities,
+ *   			for each attribute, pool offsets of its name and value,
+ *   			followed by the child entity records.
+ */
+#define PKGIMAGE_RECORD_TYPE	0
+#define PKGIMAGE_RECORD_EXTENT	1
+#define PKGIMAGE_RECORD_NAME	2
+#define PKGIMAGE_RECORD_ATTRS	3
+#define PKGIMAGE_RECORD_CHILDREN 4
+#define PKGIMAGE_RECORD_HEADER	5
+
+static const char *source_serial( const char *source, char *buf, size_t max )
+{
+  /* Helper to retrieve the issue serial number from an XML source
+   * file, without parsing the entire file; we assume that the issue
+   * attribute, if present, will be specified within the start tag of
+   * the root element, which we expect to find within the first "max"
+   * bytes of the file.  Returns a pointer to the serial number, within
+   * "buf", (or to an empty string, if there is no serial number), or
+   * NULL if the root element cannot be found.
+   */
+  int fd;
+  if( (fd = open( source, O_RDONLY | O_BINARY )) >= 0 )
+  {
+    int count = read( fd, buf, max - 1 );
+    close( fd );
+
+    char *ref = buf;
+    if( count > 0 )
+    {
+      /* Locate the root element's start tag; this is introduced
+       * by the first '<' which is not followed by '?' or '!', (which
+       * would introduce a declaration, or a comment)...
+       */
+      buf[count] = '\0';
+      while( ((ref = strchr( ref, '<' )) != NULL)
+      &&     ((*++ref == '?') || (*ref == '!'))  )
+	;
+      char *end;
+      if( (ref != NULL) && ((end = strchr( ref, '>' )) != NULL) )
+      {
+	/* ...and limit the scope of our search for the issue
+	 * attribute, to the content of this start tag.
+	 */
+	size_t len = strlen( issue_key ); *end = '\0';
+	while( (ref = strstr( ref, issue_key )) != NULL )
+	{
+	  /* We found a possible match for the attribute name; it
+	   * is only valid if it is a complete word, followed by '='
+	   * and then by a quoted value.
+	   */
+	  char *val = ref + len;
+	  while( isspace( *val ) ) ++val;
+	  if( isspace( ref[-1] ) && (*val == '=') )
+	  {
+	    while( isspace( *++val ) )
+	      ;
+	    if( ((*val == '"') || (*val == '\''))
+	    &&  ((end = strchr( val + 1, *val )) != NULL)  )
+	    {
+	      /* This is the serial number; return it, as
+	       * a NUL terminated string.
+	       */
+	      *end = '\0';
+	      return val + 1;
+	    }
+	    /* The attribute is malformed; we can't interpret it.
+	     */
+	    return NULL;
+	  }
+	  ref = val;
+	}
+	/* The root element has no issue attribute; this is not
+	 * an error, but we simply return an empty serial number.
+	 */
+	return end;
+      }
+    }
+  }
+  /* If we get to here, the source file is either inaccessible,
+   * or we couldn't locate the root element.
+   */
+  return NULL;
+}
+
+pkgXmlImage::pkgXmlImage( const char *filename, const char *source ):
+image( NULL )
+{
+  /* Constructor: load a compiled image file; if a "source" file
+   * is specified, we also require that it has not been modified since
+   * the image was compiled, otherwise we discard the image.
+   */
+  int fd;
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+  {
+    /* The image file exists; read it in its entirety...
+     */
+    struct stat info;
+    if( (fstat( fd, &info ) == 0)
+    &&  (info.st_size > (off_t)(sizeof( struct pkgXmlImageHeader )))
+    &&  ((image = (char *)(malloc( info.st_size ))) != NULL)  )
+    {
+      int count, total = 0;
+      while( (total < info.st_size)
+      &&     ((count = read( fd, image + total, info.st_size - total )) > 0) )
+	total += count;
+
+      /* ...and check that it has a valid header, which is
+       * consistent with the overall file size.
+       */
+      struct pkgXmlImageHeader *header = (struct pkgXmlImageHeader *)(image);
+      if( (total != info.st_size)
+      ||  (memcmp( header->magic, PKGIMAGE_MAGIC, sizeof( header->magic )) != 0)
+      ||  (header->version != PKGIMAGE_VERSION)
+      ||  (header->pool_size == 0) || (header->serial >= header->pool_size)
+      ||  (header->entities < PKGIMAGE_RECORD_HEADER)
+      ||  ((sizeof( struct pkgXmlImageHeader ) + header->pool_size
+	    + header->entities * sizeof( uint32_t )) != (size_t)(total))  )
+      {
+	/* The image is invalid, or incompletely written; discard it.
+	 */
+	free( (void *)(image) );
+	image = NULL;
+      }
+      else
+      { /* The image appears to be valid; establish references
+	 * to its entity table, and to its string pool.
+	 */
+	entity = (const uint32_t *)(image + sizeof( struct pkgXmlImageHeader ));
+	pool = (const char *)(entity + (entities = header->entities));
+	serial = header->serial; pool_size = header->pool_size;
+	if( pool[pool_size - 1] != '\0' )
+	{
+	  /* The final string in the pool is not terminated;
+	   * the pool must be corrupt, so discard the image.
+	   */
+	  free( (void *)(image) );
+	  image = NULL;
+	}
+      }
+    }
+    close( fd );
+  }
+
+  /* When a source file is specified, confirm that it has not changed,
+   * (as indicated by its time stamp, size, and issue serial number),
+   * since the image was compiled from it.
+   */
+  struct stat info;
+  if( (image != NULL) && (source != NULL) )
+  {
+    char buf[4096]; const char *issue;
+    struct pkgXmlImageHeader *header = (struct pkgXmlImageHeader *)(image);
+    if( (stat( source, &info ) != 0)
+    ||  (header->mtime != (int64_t)(info.st_mtime))
+    ||  (header->length != (int64_t)(info.st_size))
+    ||  ((issue = source_serial( source, buf, sizeof( buf ) )) == NULL)
+    ||  (strcmp( issue, pool + serial ) != 0)  )
+    {
+      /* The image is stale; discard it.
+       */
+      free( (void *)(image) );
+      image = NULL;
+    }
+  }
+}
+
+TiXmlNode *pkgXmlImage::Restore( const uint32_t *record, uint32_t limit )
+{
+  /* Private helper method, to reconstruct a single XML entity,
+   * and all of its content, from its image record; note that we take
+   * care to verify that all extents and pool references lie within
+   * the bounds of the image, returning NULL if not.
+   */
+  uint32_t extent;
+  if( (limit < 3) || ((extent = record[PKGIMAGE_RECORD_EXTENT]) > limit)
+  ||  (extent < 3) || (record[PKGIMAGE_RECORD_NAME] >= pool_size)  )
+    return NULL;
+
+  if( record[PKGIMAGE_RECORD_TYPE] == PKGIMAGE_TEXT )
+    /*
+     * A text entity is trivially reconstructed.
+     */
+    return new TiXmlText( pool + record[PKGIMAGE_RECORD_NAME] );
+
+  if( (record[PKGIMAGE_RECORD_TYPE] != PKGIMAGE_ELEMENT)
+  ||  (extent < PKGIMAGE_RECORD_HEADER)
+  ||  (record[PKGIMAGE_RECORD_ATTRS] > (extent - PKGIMAGE_RECORD_HEADER) / 2)  )
+    return NULL;
+
+  /* For an element, we must reconstruct its attributes...
+   */
+  pkgXmlNode *element = new pkgXmlNode( pool + record[PKGIMAGE_RECORD_NAME] );
+  const uint32_t *ref = record + PKGIMAGE_RECORD_HEADER;
+  for( uint32_t count = record[PKGIMAGE_RECORD_ATTRS]; count > 0; count-- )
+  {
+    if( (ref[0] < pool_size) && (ref[1] < pool_size) )
+      element->SetAttribute( pool + ref[0], pool + ref[1] );
+    ref += 2;
+  }
+
+  /* ...and recursively, all of its children.
+   */
+  for( uint32_t count = record[PKGIMAGE_RECORD_CHILDREN]; count > 0; count-- )
+  {
+    TiXmlNode *child;
+    if( (child = Restore( ref, extent - (ref - record) )) == NULL )
+    {
+      /* This child record is corrupt; we cannot reliably locate
+       * any which follow it, so abandon the entire element.
+       */
+      delete element;
+      return NULL;
+    }
+    element->LinkEndChild( child );
+    ref += ref[PKGIMAGE_RECORD_EXTENT];
+  }
+  return element;
+}
+
+int pkgXmlImage::Restore( pkgXmlNode *parent, const char *tagname )
+{
+  /* Reconstruct XML elements from the image, attaching them to the
+   * specified parent; we consider only the immediate children of the
+   * image root element, restoring those which match "tagname", (or all
+   * of them, when "tagname" is NULL), and return the number restored,
+   * or -1 if any record proves to be corrupt.
+   */
+  int restored = 0;
+  TiXmlNode *mark = parent->LastChild();
+  if( (image == NULL) || (entity[PKGIMAGE_RECORD_TYPE] != PKGIMAGE_ELEMENT)
+  ||  (entity[PKGIMAGE_RECORD_EXTENT] > entities)  )
+    return -1;
+
+  /* Locate the first child record of the root element...
+   */
+  uint32_t extent = entity[PKGIMAGE_RECORD_EXTENT];
+  const uint32_t *ref = entity + PKGIMAGE_RECORD_HEADER
+    + 2 * entity[PKGIMAGE_RECORD_ATTRS];
+
+  /* ...then visit each in turn, while we remain within the
+   * bounds of the root element record.
+   */
+  for( uint32_t count = entity[PKGIMAGE_RECORD_CHILDREN]; count > 0; count-- )
+  {
+    uint32_t limit = extent - (ref - entity);
+    if( (ref >= entity + extent) || (ref[PKGIMAGE_RECORD_EXTENT] > limit)
+    ||  (ref[PKGIMAGE_RECORD_EXTENT] < 3) || (ref[PKGIMAGE_RECORD_NAME] >= pool_size)  )
+    {
+      restored = -1;
+      break;
+    }
+
+    if( (ref[PKGIMAGE_RECORD_TYPE] == PKGIMAGE_ELEMENT)
+    &&  ((tagname == NULL) || (strcmp( pool + ref[PKGIMAGE_RECORD_NAME], tagname ) == 0)) )
+    {
+      /* This is a record of interest; reconstruct it.
+       */
+      TiXmlNode *child;
+      if( (child = Restore( ref, limit )) == NULL )
+      {
+	restored = -1;
+	break;
+      }
+      parent->LinkEndChild( child );
+      ++restored;
+    }
+    ref += ref[PKGIMAGE_RECORD_EXTENT];
+  }
+  if( restored < 0 )
+  {
+    /* The image is corrupt; the caller must fall back to the XML
+     * source, so discard any elements we have already attached.
+     */
+    TiXmlNode *child;
+    while( (child = parent->LastChild()) != mark )
+      parent->RemoveChild( child );
+  }
+  return restored;
+}
+
+class pkgXmlImageWriter
+{
+  /* A locally implemented class, to facilitate construction of
+   * the entity table and the string pool for a new image; strings
+   * are hashed, so that each distinct string appears only once in
+   * the pool, however often it may be referenced.
+   */
+  public:
+    pkgXmlImageWriter();
+    ~pkgXmlImageWriter();
+
+    inline bool IsOk(){ return ok; }
+    uint32_t String( const char* );
+    bool Entity( TiXmlNode* );
+    int Write( const char*, struct pkgXmlImageHeader* );
+
+  private:
+    bool ok;
+    uint32_t *word; uint32_t words, word_max;
+    char *pool; uint32_t pool_size, pool_max;
+    uint32_t *hash; uint32_t hash_size, hash_count;
+
+    uint32_t Append( uint32_t );
+    void *Expand( void*, uint32_t*, uint32_t, size_t );
+};
+
+pkgXmlImageWriter::pkgXmlImageWriter():
+ok( true ), word( NULL ), words( 0 ), word_max( 0 ),
+pool( NULL ), pool_size( 0 ), pool_max( 0 ),
+hash( NULL ), hash_size( 0 ), hash_count( 0 )
+{
+  /* Constructor: ensure that pool offset zero always refers to
+   * an empty string, which we may use as a default.
+   */
+  String( "" );
+}
+
+pkgXmlImageWriter::~pkgXmlImageWriter()
+{
+  /* Destructor: release all memory allocated on the heap.
+   */
+  free( (void *)(word) );
+  free( (void *)(pool) );
+  free( (void *)(hash) );
+}
+
+void *pkgXmlImageWriter::Expand
+( void *ref, uint32_t *max, uint32_t want, size_t size )
+{
+  /* Helper method to grow a heap allocated buffer, such that it
+   * can accommodate at least "want" elements, each of "size" bytes;
+   * on failure, we mark the entire image as invalid.
+   */
+  if( want > *max )
+  {
+    uint32_t alloc = (*max > 0) ? *max : 1024;
+    while( alloc < want ) alloc <<= 1;
+    void *tmp;
+    if( (tmp = realloc( ref, alloc * size )) == NULL )
+    {
+      ok = false;
+      return ref;
+    }
+    *max = alloc; ref = tmp;
+  }
+  return ref;
+}
+
+uint32_t pkgXmlImageWriter::Append( uint32_t value )
+{
+  /* Append a single word to the entity table, returning its index.
+   */
+  word = (uint32_t *)(Expand( word, &word_max, words + 1, sizeof( uint32_t ) ));
+  if( ok ) word[words] = value;
+  return ok ? words++ : 0;
+}
+
+static __inline__ __attribute__((__always_inline__))
+uint32_t string_hash( const char *text )
+{
+  /* FNV-1a hash, used to index the string pool.
+   */
+  uint32_t hash = 2166136261UL;
+  while( *text ) hash = (hash ^ (unsigned char)(*text++)) * 16777619UL;
+  return hash;
+}
+
+uint32_t pkgXmlImageWriter::String( const char *text )
+{
+  /* Add a string to the pool, returning its offset; if an identical
+   * string has been added previously, we simply return the offset of
+   * the existing copy.
+   */
+  if( text == NULL ) text = "";
+  if( (hash_count + 1) * 2 > hash_size )
+  {
+    /* The hash table is becoming crowded; double its size, and
+     * rehash all existing entries, (each of which is stored as its
+     * pool offset plus one, so that zero may denote an empty slot).
+     */
+    uint32_t new_size = hash_size ? hash_size << 1 : 1024;
+    uint32_t *new_hash;
+    if( (new_hash = (uint32_t *)(calloc( new_size, sizeof( uint32_t )))) == NULL )
+    {
+      ok = false;
+      return 0;
+    }
+    for( uint32_t i = 0; i < hash_size; i++ )
+      if( hash[i] != 0 )
+      {
+	uint32_t slot = string_hash( pool + hash[i] - 1 ) & (new_size - 1);
+	while( new_hash[slot] != 0 ) slot = (slot + 1) & (new_size - 1);
+	new_hash[slot] = hash[i];
+      }
+    free( (void *)(hash) );
+    hash = new_hash; hash_size = new_size;
+  }
+
+  /* Look up the string in the hash table...
+   */
+  uint32_t slot = string_hash( text ) & (hash_size - 1);
+  while( hash[slot] != 0 )
+  {
+    if( strcmp( pool + hash[slot] - 1, text ) == 0 )
+      /*
+       * ...returning the offset of any existing copy...
+       */
+      return hash[slot] - 1;
+    slot = (slot + 1) & (hash_size - 1);
+  }
+
+  /* ...otherwise, append it to the pool, and record it.
+   */
+  uint32_t len = strlen( text ) + 1;
+  pool = (char *)(Expand( pool, &pool_max, pool_size + len, sizeof( char ) ));
+  if( ! ok ) return 0;
+  memcpy( pool + pool_size, text, len );
+  hash[slot] = pool_size + 1; ++hash_count;
+  return (pool_size += len) - len;
+}
+
+bool pkgXmlImageWriter::Entity( TiXmlNode *node )
+{
+  /* Compile a single XML entity, with all of its content, into
+   * the entity table; returns true if a record was created, or false
+   * if the entity was ignored, (as are comments and declarations).
+   */
+  if( node->Type() == TiXmlNode::TEXT )
+  {
+    /* Text entities are compiled to a simple three word record.
+     */
+    Append( PKGIMAGE_TEXT ); Append( 3 ); Append( String( node->Value() ) );
+    return ok;
+  }
+
+  TiXmlElement *element;
+  if( (element = node->ToElement()) != NULL )
+  {
+    /* Elements require a header, followed by attribute references,
+     * and the records for all nested content.
+     */
+    uint32_t record = Append( PKGIMAGE_ELEMENT );
+    Append( 0 ); Append( String( element->Value() ) );
+    uint32_t attrs = Append( 0 ), children = Append( 0 );
+
+    for( TiXmlAttribute *ref = element->FirstAttribute(); ref; ref = ref->Next() )
+    {
+      uint32_t name = String( ref->Name() );
+      uint32_t value = String( ref->Value() );
+      Append( name ); Append( value );
+      if( ok ) ++word[attrs];
+    }
+    for( TiXmlNode *child = element->FirstChild(); child; child = child->NextSibling() )
+      if( Entity( child ) && ok ) ++word[children];
+
+    /* Finally, go back and record the total extent of this record.
+     */
+    if( ok ) word[record + PKGIMAGE_RECORD_EXTENT] = words - record;
+    return ok;
+  }
+  return false;
+}
+
+int pkgXmlImageWriter::Write
+( const char *filename, struct pkgXmlImageHeader *header )
+{
+  /* Write the completed image, with its header, to a named file;
+   * returns zero on success, or -1 on failure.
+   */
+  int fd;
+  if( ok && ((fd = set_output_stream( filename, 0644 )) >= 0) )
+  {
+    header->entities = words; header->pool_size = pool_size;
+    size_t tablesize = words * sizeof( uint32_t );
+    if( (write( fd, header, sizeof( *header )) == (int)(sizeof( *header )))
+    &&  (write( fd, word, tablesize ) == (int)(tablesize))
+    &&  (write( fd, pool, pool_size ) == (int)(pool_size))  )
+    {
+      close( fd );
+      return 0;
+    }
+    /* We failed to write the complete image; don't leave
+     * an incomplete file in place.
+     */
+    close( fd );
+    unlink( filename );
+  }
+  return -1;
+}
+
+int pkgXmlImage::Compile( const char *filename, const char *source, pkgXmlNode *root )
+{
+  /* Compile the XML content of "root" into a new image file; if the
+   * image represents a "source" file, record its time stamp and size,
+   * so that the image may be discarded if the source changes.
+   */
+  struct stat info;
+  struct pkgXmlImageHeader header;
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, PKGIMAGE_MAGIC, sizeof( header.magic ) );
+  header.version = PKGIMAGE_VERSION;
+  if( (source != NULL) && (stat( source, &info ) == 0) )
+  {
+    header.mtime = (int64_t)(info.st_mtime);
+    header.length = (int64_t)(info.st_size);
+  }
+
+  pkgXmlImageWriter image;
+  if( root != NULL )
+  {
+    header.serial = image.String( root->GetPropVal( issue_key, NULL ) );
+    if( image.Entity( root ) )
+      return image.Write( filename, &header );
+  }
+
+  return -1;
+}
+
+/* $RCSfile: pkgimage.cpp,v $: end of file */
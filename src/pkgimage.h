@@ -0,0 +1,94 @@
+#ifndef PKGIMAGE_H
+/*
+ * pkgimage.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Declaration of the pkgXmlImage class, which provides a compiled,
+ * binary representation of XML data, such as the package catalogues,
+ * which may be restored into the internal XML database image without
+ * incurring the overhead of re-parsing the original XML source.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define PKGIMAGE_H  1
+
+#include <stdint.h>
+
+#include "pkgbase.h"
+
+class pkgXmlImage
+{
+  /* A class to manage compiled binary images of XML documents;
+   * each image comprises a fixed format header, followed by a table
+   * of entity records, (each a sequence of 32-bit words, in which all
+   * references are expressed as offsets), and finally, a pool of NUL
+   * terminated strings.  Since the image contains no pointers, it is
+   * position independent, and may be loaded by a single read, (or
+   * mapped), with no parsing required before it is used.
+   *
+   * Note that the image is not used in place; the catalogue records
+   * it contains are restored as pkgXmlNode elements, (one allocation
+   * per node and per attribute, albeit from the profile's storage
+   * arena), because the rest of mingw-get, which navigates, searches,
+   * and modifies the profile, does so exclusively through the tinyxml
+   * node interface.  Thus, the image saves only the lexical analysis,
+   * entity decoding, and validation of the XML source, not the cost of
+   * building the tree; to avoid that too, every consumer of catalogue
+   * data would need to be adapted to an image based index.
+   */
+  public:
+    /* The constructor loads an image file, and (optionally) checks
+     * that it remains current with respect to the XML source file from
+     * which it was compiled; the destructor discards it.
+     */
+    pkgXmlImage( const char*, const char* = NULL );
+    ~pkgXmlImage(){ free( (void *)(image) ); }
+
+    /* Accessors...
+     */
+    inline bool IsOk(){ return image != NULL; }
+    inline const char *Serial(){ return image ? pool + serial : NULL; }
+
+    /* Method to reconstruct XML elements from the image, attaching
+     * them as children of a nominated parent; only those top level
+     * elements, (i.e. immediate children of the image root), which
+     * match a specified tag name are restored, (or all of them, if
+     * the tag name is specified as NULL).  Returns the number of
+     * elements restored, or -1 if the image proves to be corrupt, in
+     * which case none are attached.
+     */
+    int Restore( pkgXmlNode*, const char* );
+
+    /* Static method to compile an XML element, and all of its
+     * content, into a new image file, recording the time stamp and
+     * issue serial number of the XML source file, (if any).
+     */
+    static int Compile( const char*, const char*, pkgXmlNode* );
+
+  private:
+    char *image;
+    const uint32_t *entity;
+    const char *pool;
+    uint32_t entities, pool_size, serial;
+
+    TiXmlNode *Restore( const uint32_t*, uint32_t );
+};
+
+#endif /* PKGIMAGE_H: $RCSfile: pkgimage.h,v $: end of file */
@@ -39,10 +39,14 @@
  */
 #define dmh_dialogue_context()	GetConsoleWindow()
 
+#include <stdio.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <wininet.h>
+#include <process.h>
 #include <errno.h>
 
 #include "dmh.h"
@@ -51,7 +55,9 @@
 
 #include "pkgbase.h"
 #include "pkgkeys.h"
+#include "pkgopts.h"
 #include "pkgtask.h"
+#include "pkgxfer.h"
 
 class pkgDownloadMeter
 {
@@ -74,6 +80,19 @@ class pkgDownloadMeter
     int SizeFormat( char*, unsigned long );
 };
 
+/* Status reports are assembled in fixed size buffers, which must be
+ * large enough to accommodate the widest possible rendering of each of
+ * their component fields: a pair of byte counts, each formatted by the
+ * SizeFormat() method, (in no more than ten characters), separated by
+ * " / "; a padding interval of at least one space, and the bar graph,
+ * with its delimiters; the percentage tally, and its terminating NUL.
+ * Group reports are further prefixed by a "[done/expected] " tally of
+ * files, in which each count may have as many as ten digits.
+ */
+#define PKG_DL_SIZE_FIELD	(10 + 3 + 10)
+#define PKG_DL_TALLY_FIELD	(1 + 10 + 1 + 10 + 2)
+#define PKG_DL_REPORT_SIZE(BAR) (PKG_DL_SIZE_FIELD + 2 + (BAR) + 5 + 1)
+
 class pkgDownloadMeterTTY : public pkgDownloadMeter
 {
   /* Implementation of a download meter class, displaying download
@@ -90,7 +109,7 @@ class pkgDownloadMeterTTY : public pkgDownloadMeter
      * in preparation for display on the console.
      */
     const char *source_url;
-    char status_report[80];
+    char status_report[PKG_DL_REPORT_SIZE( 48 )];
 };
 
 pkgDownloadMeterTTY::pkgDownloadMeterTTY( const char *url, unsigned long length )
@@ -147,14 +166,17 @@ int pkgDownloadMeterTTY::Update( unsigned long count )
     : (content_length > 0) ? 48 : 0;
 
   /* We may safely use sprintf() to assemble the status report, because
-   * we control the field lengths to always fit within the buffer.
+   * we control the field lengths to always fit within the buffer, (which
+   * is sized to accommodate the widest of each, with the bar graph in
+   * the column which follows the widest size field).
    */
   p += SizeFormat( p, count );
   p += sprintf( p, " / " );
   p += (content_length > 0)
     ? SizeFormat( p, content_length )
     : sprintf( p, "????.?? ??" );
-  p += sprintf( p, "%*c", status_report + 25 - p, '|' ); p[barlen] = '\0';
+  p += sprintf( p, "%*c", (int)(status_report + PKG_DL_SIZE_FIELD + 2 - p), '|' );
+  p[barlen] = '\0';
   p += sprintf( p, "%-48s", (char *)(memset( p, '=', barlen )) );
   p += ( (content_length > 0) && (content_length >= count) )
     ? sprintf( p, "|%4lu", percentage( count, content_length ) )
@@ -214,11 +236,357 @@ int pkgDownloadMeter::SizeFormat( char *buf, unsigned long filesize )
   return retval;
 }
 
-class pkgInternetAgent
+class pkgDownloadMeterGroup : public pkgDownloadMeter
+{
+  /* Implementation of a download meter class, displaying combined
+   * download statistics for a group of concurrently active downloads,
+   * within a CLI application context; each member of the group reports
+   * its progress via its own pkgDownloadMeterMember, (see below), which
+   * forwards it to this, for display in a single status report.
+   */
+  public:
+    pkgDownloadMeterGroup( unsigned );
+    virtual ~pkgDownloadMeterGroup();
+
+    virtual int Update( unsigned long );
+
+    /* Methods invoked on behalf of individual group members, (or of
+     * the controlling scheduler), to report changes in status.
+     */
+    void Attach( const char*, unsigned long );
+    void Detach( unsigned long, unsigned long );
+    void Advance( unsigned long );
+    void Complete();
+
+    /* Method to temporarily erase the status report, allowing other
+     * messages to be displayed on the console...
+     */
+    void Suspend();
+
+    /* ...and to enable, or disable, its display for an extended period,
+     * (e.g. while downloads continue in the background, and other
+     * activities make use of the console).
+     */
+    void Show( bool );
+
+  private:
+    unsigned files_expected, files_done;
+    unsigned long tally;
+    bool displayed, visible;
+
+    char status_report[PKG_DL_TALLY_FIELD + PKG_DL_REPORT_SIZE( 40 )];
+};
+
+class pkgDownloadMonitor
+{
+  /* A minimal, locally implemented class, instantiated ONCE as a
+   * global object, to serialise access to those resources which are
+   * shared among concurrently active download threads; these include
+   * the console, on which diagnostics and progress reports are shown,
+   * and the wininet session, while it is being initialised.
+   */
+  public:
+    inline pkgDownloadMonitor():meter( NULL ), depth( 0 )
+    {
+      InitializeCriticalSection( &lock );
+    }
+    inline ~pkgDownloadMonitor()
+    {
+      DeleteCriticalSection( &lock );
+    }
+    inline void Acquire(){ EnterCriticalSection( &lock ); ++depth; }
+    inline void Release(){ --depth; LeaveCriticalSection( &lock ); }
+
+    /* When archives are downloaded concurrently, their progress is
+     * reported by a shared group meter; we keep a reference to it here,
+     * so that it may be suspended while displaying other messages.  The
+     * lock may be reacquired by its owner, (e.g. when any message is
+     * displayed while it is held); only the outermost acquisition need
+     * suspend the meter, which itself displays messages.
+     */
+    inline pkgDownloadMeterGroup *Meter(){ return meter; }
+    inline void SetMeter( pkgDownloadMeterGroup *group ){ meter = group; }
+    inline void Interrupt()
+    {
+      Acquire();
+      if( (meter != NULL) && (depth == 1) )
+	meter->Suspend();
+    }
+
+  private:
+    CRITICAL_SECTION lock;
+    pkgDownloadMeterGroup *meter;
+    unsigned depth;
+};
+
+/* This is the one and only instantiation of an object of this class.
+ */
+static pkgDownloadMonitor download_monitor;
+
+class pkgDownloadLock
+{
+  /* A trivial helper class; an instance of this should be placed in
+   * the scope of any code which displays diagnostic messages, or which
+   * may otherwise interact with the user, from within any download
+   * thread; it serialises such interactions, while keeping them clear
+   * of any group progress report.
+   */
+  public:
+    inline pkgDownloadLock(){ download_monitor.Interrupt(); }
+    inline ~pkgDownloadLock(){ download_monitor.Release(); }
+};
+
+/* While download threads are active, every diagnostic message, from
+ * whichever thread, is serialised by the same lock; these functions
+ * are registered with the diagnostic message handler, for the purpose.
+ */
+static void download_monitor_acquire(){ download_monitor.Interrupt(); }
+static void download_monitor_release(){ download_monitor.Release(); }
+
+pkgDownloadMeterGroup::pkgDownloadMeterGroup( unsigned files ):
+files_expected( files ), files_done( 0 ), tally( 0 ), displayed( false ),
+visible( true )
+{
+  content_length = 0;
+}
+
+pkgDownloadMeterGroup::~pkgDownloadMeterGroup()
+{
+  if( displayed )
+    dmh_printf( "\n" );
+}
+
+int pkgDownloadMeterGroup::Update( unsigned long count )
+{
+  /* Implementation of method to update the combined progress report;
+   * this mimics the pkgDownloadMeterTTY::Update() method, but prefixes
+   * the report with a tally of completed downloads, and thus displays
+   * a shorter (40-segment) bar graph.  Note that, since the combined
+   * byte counts may be large, we compute the proportions in 64-bit
+   * arithmetic; callers MUST hold the download_monitor lock.
+   */
+  if( ! visible )
+    return 0;
+
+  char *p = status_report;
+  int barlen = (content_length > count)
+    ? (int)(((uint64_t)(count) * 40) / content_length)
+    : (content_length > 0) ? 40 : 0;
+
+  p += sprintf( p, "[%u/%u] ", files_done, files_expected );
+  p += SizeFormat( p, count );
+  p += sprintf( p, " / " );
+  p += (content_length > 0)
+    ? SizeFormat( p, content_length )
+    : sprintf( p, "????.?? ??" );
+  /* The bar graph is normally aligned in a fixed column, but the tally
+   * of files may be wide enough to displace it; we always allow at least
+   * the minimum padding interval, as the buffer size anticipates.
+   */
+  int pad = status_report + 33 - p;
+  p += sprintf( p, "%*c", (pad > 2) ? pad : 2, '|' );
+  p[barlen] = '\0';
+  p += sprintf( p, "%-40s", (char *)(memset( p, '=', barlen )) );
+  p += ( (content_length > 0) && (content_length >= count) )
+    ? sprintf( p, "|%4lu",
+	(unsigned long)(((uint64_t)(count) * 100) / content_length)
+      )
+    : sprintf( p, "| ???" );
+
+  displayed = true;
+  return dmh_printf( "\r%s%%", status_report );
+}
+
+void pkgDownloadMeterGroup::Suspend()
+{
+  /* Erase the status report, if it is currently displayed, (including
+   * the trailing '%' sign); it will be redisplayed on the next update.
+   */
+  if( displayed )
+    dmh_printf( "\r%*s\r", (int)(strlen( status_report ) + 1), "" );
+  displayed = false;
+}
+
+void pkgDownloadMeterGroup::Show( bool enable )
+{
+  /* Enable, or disable, display of the status report; callers MUST
+   * hold the download_monitor lock.
+   */
+  if( (visible = enable) == true )
+    Update( tally );
+  else
+    Suspend();
+}
+
+void pkgDownloadMeterGroup::Attach( const char *url, unsigned long length )
+{
+  /* Register the start of a member download, announcing its source
+   * URL, and adding its expected size to the combined total.
+   */
+  download_monitor.Acquire();
+  Suspend(); dmh_printf( "%s\n", url );
+  content_length += length;
+  Update( tally );
+  download_monitor.Release();
+}
+
+void pkgDownloadMeterGroup::Advance( unsigned long count )
+{
+  /* Accumulate the byte count reported by any member download.
+   */
+  download_monitor.Acquire();
+  Update( tally += count );
+  download_monitor.Release();
+}
+
+void pkgDownloadMeterGroup::Detach( unsigned long expected, unsigned long actual )
+{
+  /* Register the end of a member download; its actual size may not
+   * be what we expected, (it may have been unknown, or the download
+   * may have failed), so adjust the combined total accordingly.
+   */
+  download_monitor.Acquire();
+  content_length += actual - expected;
+  Update( tally );
+  download_monitor.Release();
+}
+
+void pkgDownloadMeterGroup::Complete()
+{
+  /* Tally each request as it is completed, (whether or not it required
+   * any data to be downloaded, and whether successful, or not).
+   */
+  download_monitor.Acquire();
+  ++files_done;
+  if( displayed )
+    Update( tally );
+  download_monitor.Release();
+}
+
+class pkgDownloadMeterMember : public pkgDownloadMeter
+{
+  /* Implementation of a download meter class, which reports progress
+   * of a single download, on behalf of a pkgDownloadMeterGroup.
+   */
+  public:
+    pkgDownloadMeterMember( pkgDownloadMeterGroup*, const char*, unsigned long );
+    virtual ~pkgDownloadMeterMember();
+
+    virtual int Update( unsigned long );
+
+  private:
+    pkgDownloadMeterGroup *group;
+    unsigned long tally;
+};
+
+pkgDownloadMeterMember::pkgDownloadMeterMember
+( pkgDownloadMeterGroup *owner, const char *url, unsigned long length ):
+group( owner ), tally( 0 )
+{
+  content_length = length;
+  group->Attach( url, length );
+}
+
+pkgDownloadMeterMember::~pkgDownloadMeterMember()
+{
+  group->Detach( content_length, tally );
+}
+
+int pkgDownloadMeterMember::Update( unsigned long count )
+{
+  /* The group meter accumulates only the increment since the
+   * preceding update, from each of its members.
+   */
+  group->Advance( count - tally );
+  tally = count;
+  return 0;
+}
+
+class pkgWinInetResource : public pkgInternetResource
+{
+  /* Implementation of the transport resource interface, for URLs
+   * which have been opened by the wininet API; the methods are simple
+   * inline wrappers for the wininet functions we plan to use...
+   */
+  public:
+    pkgWinInetResource( HINTERNET id ):handle( id ), validator( NULL ){}
+    virtual ~pkgWinInetResource()
+    {
+      InternetCloseHandle( handle );
+      free( validator );
+    }
+
+    static inline unsigned long QueryStatus( HINTERNET id )
+    {
+      unsigned long ok, idx = 0, len = sizeof( ok );
+      if( HttpQueryInfo( id, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
+	    &ok, &len, &idx )
+	) return ok;
+      return 0;
+    }
+    static inline unsigned long QueryContentLength( HINTERNET id )
+    {
+      unsigned long content_len, idx = 0, len = sizeof( content_len );
+      if( HttpQueryInfo( id, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_CONTENT_LENGTH,
+	    &content_len, &len, &idx )
+	) return content_len;
+      return 0;
+    }
+    virtual unsigned long Status(){ return QueryStatus( handle ); }
+    virtual unsigned long ContentLength(){ return QueryContentLength( handle ); }
+    virtual int Read( char *buf, size_t max, unsigned long *count )
+    {
+      return InternetReadFile( handle, buf, max, count );
+    }
+    virtual unsigned long Offset();
+    virtual const char *Validator();
+
+  private:
+    HINTERNET handle;
+    char *validator;
+};
+
+unsigned long pkgWinInetResource::Offset()
+{
+  /* Retrieve the offset of the first byte of a partial response, from
+   * its "Content-Range: bytes first-last/total" header; (wininet has no
+   * predefined query for this, so we must use a custom query).
+   */
+  char range[80] = "Content-Range";
+  unsigned long offset, idx = 0, len = sizeof( range );
+  if(  HttpQueryInfo( handle, HTTP_QUERY_CUSTOM, range, &len, &idx )
+  &&  (sscanf( range, "bytes %lu-", &offset ) == 1)  )
+    return offset;
+  return 0;
+}
+
+const char *pkgWinInetResource::Validator()
+{
+  /* Retrieve, (and cache), the entity tag for the resource, or failing
+   * that, (or if it is a weak tag, which cannot validate a range), its
+   * time stamp.
+   */
+  if( validator == NULL )
+  {
+    char buf[256];
+    unsigned long idx = 0, len = sizeof( buf );
+    if(  (HttpQueryInfo( handle, HTTP_QUERY_ETAG, buf, &len, &idx )
+	 && (strncmp( buf, "W/", 2 ) != 0))
+    ||  ((idx = 0, len = sizeof( buf )) > 0
+	 && HttpQueryInfo( handle, HTTP_QUERY_LAST_MODIFIED, buf, &len, &idx ))  )
+      validator = strdup( buf );
+  }
+  return validator;
+}
+
+class pkgInternetAgent : public pkgInternetTransport
 {
   /* A minimal, locally implemented class, instantiated ONCE as a
    * global object, to ensure that wininet's global initialisation is
-   * completed at the proper time, without us doing it explicitly.
+   * completed at the proper time, without us doing it explicitly; it
+   * also dispatches each request to the appropriate transport, which
+   * is normally wininet itself, but may be one of the portable agents
+   * from pkgxfer.cpp, for "file:" URLs, or when selected by the user.
    */
   private:
     HINTERNET SessionHandle;
@@ -242,30 +610,17 @@ class pkgInternetAgent
       if( SessionHandle != NULL )
 	Close( SessionHandle );
     }
-    HINTERNET OpenURL( const char* );
+    virtual pkgInternetResource *Open
+      ( const char*, unsigned long = 0, const char* = NULL );
 
-    /* Remaining methods are simple inline wrappers for the
-     * wininet functions we plan to use...
+  private:
+    /* The wininet specific implementation of Open(), with inline
+     * wrappers for the additional wininet functions it uses.
      */
+    HINTERNET OpenURL( const char*, const char* );
     inline unsigned long QueryStatus( HINTERNET id )
     {
-      unsigned long ok, idx = 0, len = sizeof( ok );
-      if( HttpQueryInfo( id, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-	    &ok, &len, &idx )
-	) return ok;
-      return 0;
-    }
-    inline unsigned long QueryContentLength( HINTERNET id )
-    {
-      unsigned long content_len, idx = 0, len = sizeof( content_len );
-      if( HttpQueryInfo( id, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_CONTENT_LENGTH,
-	    &content_len, &len, &idx )
-	) return content_len;
-      return 0;
-    }
-    inline int Read( HINTERNET dl, char *buf, size_t max, unsigned long *count )
-    {
-      return InternetReadFile( dl, buf, max, count );
+      return pkgWinInetResource::QueryStatus( id );
     }
     inline int Close( HINTERNET id )
     {
@@ -288,12 +643,13 @@ class pkgInternetStreamingAgent
     const char *dest_template;
 
     char *dest_file;
-    HINTERNET dl_host;
+    pkgInternetResource *dl_host;
     pkgDownloadMeter *dl_meter;
     int dl_status;
 
   private:
     virtual int TransferData( int );
+    virtual bool Resumable(){ return true; }
 
   public:
     pkgInternetStreamingAgent( const char*, const char* );
@@ -323,7 +679,80 @@ pkgInternetStreamingAgent::~pkgInternetStreamingAgent()
   free( (void *)(dest_file) );
 }
 
-HINTERNET pkgInternetAgent::OpenURL( const char *URL )
+pkgInternetResource *pkgInternetAgent::Open
+( const char *URL, unsigned long offset, const char *validator )
+{
+  /* Dispatch a request to open a URL to the appropriate transport;
+   * "file:" URLs are always handled by the portable file transport,
+   * while others are handled by wininet, unless the user has selected
+   * the portable HTTP transport, (which supports only plain "http:"
+   * URLs, and takes no account of any proxy configuration), by way of
+   * the "socket-transport" option.
+   */
+  char *redirect = NULL;
+  pkgInternetTransport *transport = NULL;
+  if( strncasecmp( URL, "file:", 5 ) == 0 )
+    transport = pkgFileTransport();
+
+  else if( (strncasecmp( URL, "http:", 5 ) == 0)
+  &&  (pkgOptions()->Test( OPTION_SOCKET_TRANSPORT, OPTION_EXTRA_FLAGS ) != 0)  )
+    transport = pkgHttpTransport();
+
+  if( transport != NULL )
+  {
+    /* A portable transport has been selected; delegate the request,
+     * diagnosing any failure, as wininet's OpenURL() would.
+     */
+    pkgInternetResource *resource;
+    if( (resource = transport->Open( URL, offset, validator )) == NULL )
+    {
+      pkgDownloadLock serialise;
+      dmh_notify( DMH_ERROR, "%s:cannot open URL\n", URL );
+      return NULL;
+    }
+
+    /* The HTTP transport cannot follow a redirection to any scheme
+     * other than "http:", (as SourceForge's mirrors commonly require,
+     * for "https:"); in this case, it returns the redirection response
+     * itself, and we pass the location it specifies on to wininet.
+     */
+    unsigned long status = resource->Status();
+    const char *location = resource->Location();
+    if( (status < 300) || (status >= 400) || (location == NULL)
+    ||  (strncasecmp( location, "https:", 6 ) != 0)
+    ||  ((redirect = strdup( location )) == NULL)  )
+      return resource;
+
+    delete resource;
+    URL = redirect;
+  }
+
+  /* In the default case, we use wininet; when resuming a download,
+   * we must add our own headers to the request.
+   */
+  HINTERNET ResourceHandle;
+  char range[48 + ((validator != NULL) ? strlen( validator ) : 0)];
+  if( (offset > 0) && (validator != NULL) )
+    sprintf( range, "Range: bytes=%lu-\r\nIf-Range: %s\r\n", offset, validator );
+  else
+    *range = '\0';
+
+  pkgInternetResource *resource = NULL;
+  if( (ResourceHandle = OpenURL( URL, range )) != NULL )
+    resource = new pkgWinInetResource( ResourceHandle );
+  free( redirect );
+  return resource;
+}
+
+static inline bool http_request_ok( unsigned long status )
+{
+  /* Helper to identify a successful response status; when resuming
+   * a download, a partial content response is also acceptable.
+   */
+  return (status == HTTP_STATUS_OK) || (status == HTTP_STATUS_PARTIAL_CONTENT);
+}
+
+HINTERNET pkgInternetAgent::OpenURL( const char *URL, const char *headers )
 {
   /* Open an internet data stream.
    */
@@ -332,18 +761,23 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
   /* This requires an internet
    * connection to have been established...
    */
-  if(  (SessionHandle == NULL)
-  &&   (InternetAttemptConnect( 0 ) == ERROR_SUCCESS)  )
-    /*
-     * ...so, on first call, we perform the connection setup
+  if( SessionHandle == NULL )
+  {
+    /* ...so, on first call, we perform the connection setup
      * which we deferred from the class constructor; (MSDN
      * cautions that this MUST NOT be done in the constructor
-     * for any global class object such as ours).
+     * for any global class object such as ours).  Since we
+     * may be called concurrently, from several download threads,
+     * we must ensure that only one of them performs this setup.
      */
-    SessionHandle = InternetOpen
-      ( "MinGW Installer", INTERNET_OPEN_TYPE_PRECONFIG,
-	 NULL, NULL, 0
-      );
+    pkgDownloadLock serialise;
+    if(  (SessionHandle == NULL)
+    &&   (InternetAttemptConnect( 0 ) == ERROR_SUCCESS)  )
+      SessionHandle = InternetOpen
+	( "MinGW Installer", INTERNET_OPEN_TYPE_PRECONFIG,
+	   NULL, NULL, 0
+	);
+  }
   
   /* Aggressively attempt to acquire a resource handle, which we may use
    * to access the specified URL; (schedule a maximum of five attempts).
@@ -366,7 +800,8 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 	    * specify it anyway, on the off-chance that it may introduce
 	    * an undocumented benefit beyond wishful thinking.
 	    */
-	   SessionHandle, URL, NULL, 0, INTERNET_FLAG_EXISTING_CONNECT, 0
+	   SessionHandle, URL, *headers ? headers : NULL, *headers ? -1L : 0,
+	   INTERNET_FLAG_EXISTING_CONNECT, 0
 	 );
        if( ResourceHandle == NULL )
        {
@@ -374,10 +809,12 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 	  * unless we have exhausted the specified retry limit...
 	  */
 	 if( --retries < 1 )
-	   /*
-	    * ...in which case, we diagnose failure to open the URL.
+	 {
+	   /* ...in which case, we diagnose failure to open the URL.
 	    */
+	   pkgDownloadLock serialise;
 	   dmh_notify( DMH_ERROR, "%s:cannot open URL\n", URL );
+	 }
 
 	 else DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
 	   dmh_printf( "%s\nConnecting ... failed(status=%u); retrying...\n",
@@ -408,8 +845,11 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 		 * Furthermore, this particular implementation provides only
 		 * for proxy authentication, ignoring the possibility that
 		 * server authentication may be required.  We may wish to
-		 * revisit this later.
+		 * revisit this later.  Note that, when several downloads
+		 * are active concurrently, we must ensure that only one of
+		 * them at a time solicits any such user response.
 		 */
+		pkgDownloadLock serialise;
 		unsigned long user_response;
 		do { user_response = InternetErrorDlg
 		       ( dmh_dialogue_context(), ResourceHandle, ResourceErrno,
@@ -428,7 +868,7 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 			*/
 		       ResourceErrno = GetLastError();
 		       ResourceStatus = QueryStatus( ResourceHandle );
-		       if( ResourceStatus == HTTP_STATUS_OK )
+		       if( http_request_ok( ResourceStatus ) )
 			 /*
 			  * ...ensure that the response is anything but 'retry',
 			  * so that we will break out of the retry loop...
@@ -439,7 +879,7 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 		      */
 		   } while( user_response == ERROR_INTERNET_FORCE_RETRY );
 	      }
-	      else if( ResourceStatus != HTTP_STATUS_OK )
+	      else if( ! http_request_ok( ResourceStatus ) )
 	      {
 		/* Other failure modes may not be so readily recoverable;
 		 * with little hope of success, retry anyway.
@@ -451,11 +891,11 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 		if( HttpSendRequest( ResourceHandle, NULL, 0, 0, 0 ) )
 		  ResourceStatus = QueryStatus( ResourceHandle );
 	      }
-	    } while( (ResourceStatus != HTTP_STATUS_OK) && (retry-- > 0) );
+	    } while( ! http_request_ok( ResourceStatus ) && (retry-- > 0) );
 
 	 /* Confirm that the URL was (eventually) opened successfully...
 	  */
-	 if( ResourceStatus == HTTP_STATUS_OK )
+	 if( http_request_ok( ResourceStatus ) )
 	   /*
 	    * ...in which case, we have no need to schedule any further
 	    * retries.
@@ -479,6 +919,7 @@ HINTERNET pkgInternetAgent::OpenURL( const char *URL )
 	     /* Issue a diagnostic advising the user to refer the problem
 	      * to the mingw-get maintainer for possible follow-up.
 	      */
+	     pkgDownloadLock serialise;
 	     dmh_control( DMH_BEGIN_DIGEST );
 	     dmh_notify( DMH_WARNING,
 		 "%s: opened with unexpected status: code = %u\n",
@@ -509,7 +950,7 @@ int pkgInternetStreamingAgent::TransferData( int fd )
    * and write a verbatim copy to the destination file.
    */
   char buf[8192]; unsigned long count, tally = 0;
-  do { dl_status = pkgDownloadAgent.Read( dl_host, buf, sizeof( buf ), &count );
+  do { dl_status = dl_host->Read( buf, sizeof( buf ), &count );
        dl_meter->Update( tally += count );
        write( fd, buf, count );
      } while( dl_status && (count > 0) );
@@ -571,6 +1012,62 @@ int set_transit_path( const char *path, const char *file, char *buf = NULL )
   return mkpath( buf, path, file, transit_dir );
 }
 
+static char *get_resume_state( const char *state_file, unsigned long *total )
+{
+  /* Helper to retrieve the record which describes a partially completed
+   * download; this comprises the expected total size of the file, and
+   * the validator which the server associated with it, separated by a
+   * single space.  Returns the validator, (allocated on the heap), and
+   * the expected size, or NULL if no viable record exists.
+   */
+  FILE *fp;
+  char *validator = NULL;
+  if( (fp = fopen( state_file, "r" )) != NULL )
+  {
+    char record[512], *ref;
+    if( (fgets( record, sizeof( record ), fp ) != NULL)
+    &&  ((*total = strtoul( record, &ref, 10 )) > 0) && (*ref++ == ' ')  )
+    {
+      /* Discard the line terminator, before saving the validator.
+       */
+      ref[strcspn( ref, "\r\n" )] = '\0';
+      if( *ref != '\0' )
+	validator = strdup( ref );
+    }
+    fclose( fp );
+  }
+  return validator;
+}
+
+static bool set_resume_state
+( const char *state_file, unsigned long total, const char *validator )
+{
+  /* Helper to record the state for a download which is about to start,
+   * so that it may be resumed, should it be interrupted; returns true
+   * if the record was successfully written.
+   */
+  FILE *fp;
+  if( (total > 0) && (validator != NULL) && (*validator != '\0')
+  &&  (strpbrk( validator, "\r\n" ) == NULL)
+  &&  ((fp = fopen( state_file, "w" )) != NULL)  )
+  {
+    bool ok = fprintf( fp, "%lu %s\n", total, validator ) > 0;
+    return (fclose( fp ) == 0) && ok;
+  }
+  return false;
+}
+
+static inline
+bool resumed( pkgInternetResource *dl, unsigned long offset, unsigned long total )
+{
+  /* Helper to confirm that the server has agreed to resume a download
+   * at the specified offset, returning the remainder of a file of the
+   * expected size.
+   */
+  return (offset > 0) && (dl->Status() == HTTP_STATUS_PARTIAL_CONTENT)
+    && (dl->Offset() == offset) && (offset + dl->ContentLength() == total);
+}
+
 int pkgInternetStreamingAgent::Get( const char *from_url )
 {
   /* Download a file from the specified internet URL.
@@ -579,55 +1076,134 @@ int pkgInternetStreamingAgent::Get( const char *from_url )
    */
   dl_status = 0;
 
-  /* Set up a "transit-file" to receive the downloaded content.
+  /* Identify the "transit-file" which is to receive the downloaded
+   * content, and the associated record of its resumable state.
    */
   char transit_file[set_transit_path( dest_template, filename )];
-  int fd; set_transit_path( dest_template, filename, transit_file );
-
-  if( (fd = set_output_stream( transit_file, 0644 )) >= 0 )
+  set_transit_path( dest_template, filename, transit_file );
+  char state_file[8 + sizeof( transit_file )];
+  sprintf( state_file, "%s.resume", transit_file );
+
+  /* When a previous attempt to download this file was interrupted, it
+   * may have left a partial "transit-file", together with a record of
+   * the expected file size, and the validator which identifies it; in
+   * this case, we ask the server to send just the remainder of it.
+   */
+  struct stat info;
+  unsigned long offset = 0, total = 0;
+  char *validator = Resumable() ? get_resume_state( state_file, &total ) : NULL;
+  if(  (validator != NULL) && (stat( transit_file, &info ) == 0)
+  &&   (info.st_size > 0) && ((unsigned long)(info.st_size) < total)  )
+    offset = info.st_size;
+
+  dl_host = pkgDownloadAgent.Open( from_url, offset, validator );
+  free( validator );
+
+  if(  (dl_host != NULL) && (offset > 0)
+  &&   (dl_host->Status() != HTTP_STATUS_OK) && ! resumed( dl_host, offset, total )  )
   {
-    /* The "transit-file" is ready to receive incoming data...
-     * Configure and invoke the download handler to copy the data
-     * from the appropriate host URL, to this "transit-file".
+    /* The server declined to resume the download, (or responded in a
+     * manner which is inconsistent with our request); abandon the
+     * partial "transit-file", and start over.
      */
-    if( (dl_host = pkgDownloadAgent.OpenURL( from_url )) != NULL )
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	dmh_printf( "%s: cannot resume at offset %lu; status = %lu\n",
+	  from_url, offset, dl_host->Status()
+      ));
+    delete dl_host;
+    dl_host = pkgDownloadAgent.Open( from_url );
+  }
+
+  if( dl_host != NULL )
+  {
+    int fd = -1;
+    bool keep = false;
+    unsigned long content_length = dl_host->ContentLength();
+    if( resumed( dl_host, offset, total ) )
+    {
+      /* The server has agreed to resume the download; we append the
+       * remaining data to the existing "transit-file", and we may keep
+       * it again, should this attempt also be interrupted.
+       */
+      fd = open( transit_file, O_WRONLY | O_APPEND | O_BINARY );
+      keep = true;
+    }
+    else if( dl_host->Status() == HTTP_STATUS_OK )
+    {
+      /* We are to download the entire file; discard any record of
+       * resumable state from any prior attempt, then set up a new, (or
+       * truncated), "transit-file" to receive the incoming data, and
+       * record its new resumable state, (if the server identifies it
+       * sufficiently for us to resume it, should that be necessary).
+       */
+      unlink( state_file );
+      if( (fd = set_output_stream( transit_file, 0644 )) >= 0 )
+	keep = Resumable() && set_resume_state(
+	    state_file, total = content_length, dl_host->Validator()
+	  );
+    }
+    else DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	dmh_printf( "OpenURL:error:%d\n", GetLastError() )
+      );
+
+    if( fd >= 0 )
     {
-      if( pkgDownloadAgent.QueryStatus( dl_host ) == HTTP_STATUS_OK )
+      /* The "transit-file" is ready to receive incoming data; with the
+       * download transaction fully specified, we may request processing
+       * of the file transfer...
+       */
+      pkgDownloadMeterGroup *group = download_monitor.Meter();
+      if( group != NULL )
       {
-	/* With the download transaction fully specified, we may
-	 * request processing of the file transfer...
+	/* ...reporting its progress via the group meter, when this
+	 * is one of several concurrently active downloads...
 	 */
-	pkgDownloadMeterTTY download_meter
-	  (
-	    from_url, pkgDownloadAgent.QueryContentLength( dl_host )
-	  );
+	pkgDownloadMeterMember download_meter( group, from_url, content_length );
+	dl_meter = &download_meter;
+	dl_status = TransferData( fd );
+      }
+      else
+      { /* ...or on a dedicated meter, otherwise.
+	 */
+	pkgDownloadMeterTTY download_meter( from_url, content_length );
 	dl_meter = &download_meter;
 	dl_status = TransferData( fd );
       }
-      else DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
-	  dmh_printf( "OpenURL:error:%d\n", GetLastError() )
-	);
 
-      /* We are done with the URL handle; close it.
+      /* Always close the "transit-file", whether the download
+       * was successful, or not...
        */
-      pkgDownloadAgent.Close( dl_host );
+      close( fd );
+      if(  dl_status && keep
+      &&  ((stat( transit_file, &info ) != 0) || ((unsigned long)(info.st_size) != total))  )
+      {
+	/* ...but, when we know what size to expect, a download which
+	 * ostensibly succeeded, but which doesn't match it, is corrupt;
+	 * it must be discarded, and cannot be resumed.
+	 */
+	dl_status = keep = false;
+	unlink( state_file );
+      }
+      if( dl_status )
+      {
+	/* When successful, we move the "transit-file" to its
+	 * final downloaded location...
+	 */
+	rename( transit_file, dest_file );
+	unlink( state_file );
+      }
+      else if( ! keep )
+	/*
+	 * ...otherwise, we discard the incomplete "transit-file",
+	 * (unless we may resume it later), leaving the caller to
+	 * diagnose the failure.
+	 */
+	unlink( transit_file );
     }
 
-    /* Always close the "transit-file", whether the download
-     * was successful, or not...
+    /* We are done with the URL resource; close it.
      */
-    close( fd );
-    if( dl_status )
-      /*
-       * When successful, we move the "transit-file" to its
-       * final downloaded location...
-       */
-      rename( transit_file, dest_file );
-    else
-      /* ...otherwise, we discard the incomplete "transit-file",
-       * leaving the caller to diagnose the failure.
-       */
-      unlink( transit_file );
+    delete dl_host;
   }
 
   /* Report success or failure to the caller...
@@ -666,96 +1242,485 @@ void pkgActionItem::PrintURI( const char *package_name )
   }
 }
 
-void pkgActionItem::DownloadSingleArchive
-( const char *package_name, const char *archive_cache_path )
+static char *download_url( pkgXmlNode *release, const char *package_name )
 {
+  /* Helper function to construct the URL from which the archive for
+   * a specified package release may be downloaded, as a string on the
+   * heap, (which the caller must free); returns NULL if the package
+   * repository catalogue specifies no template for the URL.
+   */
+  char *package_url = NULL;
+  const char *url_template = get_host_info( release, uri_key );
+  if( url_template != NULL )
+  {
+    const char *mirror = get_host_info( release, mirror_key );
+    package_url = (char *)(malloc( mkpath( NULL, url_template, package_name, mirror ) ));
+    if( package_url != NULL )
+      mkpath( package_url, url_template, package_name, mirror );
+  }
+  return package_url;
+}
+
+static bool download_archive
+( const char *package_name, const char *package_url, const char *archive_cache_path )
+{
+  /* Helper function to fetch a single package archive, from a URL
+   * which has been resolved in advance; since it makes no reference
+   * to the XML database, it may be invoked from any download thread.
+   * Returns true, if the archive is then present in the local cache.
+   */
   pkgInternetStreamingAgent download( package_name, archive_cache_path );
 
   /* Check if the required archive is already available locally...
    */
-  if(  ((flags & ACTION_DOWNLOAD) == ACTION_DOWNLOAD)
-  &&   ((access( download.DestFile(), R_OK ) != 0) && (errno == ENOENT))  )
+  if( (access( download.DestFile(), R_OK ) != 0) && (errno == ENOENT) )
   {
     /* ...if not, ask the download agent to fetch it...
      */
-    const char *url_template = get_host_info( Selection(), uri_key );
-    if( url_template != NULL )
+    if( package_url != NULL )
     {
       /* ...from the URL constructed from the template specified in
        * the package repository catalogue (configuration database)...
        */
-      const char *mirror = get_host_info( Selection(), mirror_key );
-      char package_url[mkpath( NULL, url_template, package_name, mirror )];
-      mkpath( package_url, url_template, package_name, mirror );
       if( download.Get( package_url ) > 0 )
 	/*
-	 * Download was successful; clear the pending flag.
+	 * Download was successful.
 	 */
-	flags &= ~(ACTION_DOWNLOAD);
-      else
-	/* Diagnose failure; leave pending flag set.
-	 */
-	dmh_notify( DMH_ERROR,
-	    "Get package: %s: download failed\n", package_url
-	  );
+	return true;
+
+      /* Diagnose failure.
+       */
+      pkgDownloadLock serialise;
+      dmh_notify( DMH_ERROR,
+	  "Get package: %s: download failed\n", package_url
+	);
     }
     else
-      /* Cannot download; the repository catalogue didn't specify a
+    { /* Cannot download; the repository catalogue didn't specify a
        * template, from which to construct a download URL...
        */
+      pkgDownloadLock serialise;
       dmh_notify( DMH_ERROR,
 	  "Get package: %s: no URL specified for download\n", package_name
 	);
+    }
+    return false;
   }
-  else
-    /* There was no need to download any file to satisfy this request.
+  /* There was no need to download any file to satisfy this request.
+   */
+  return true;
+}
+
+void pkgActionItem::DownloadSingleArchive
+( const char *package_name, const char *archive_cache_path )
+{
+  /* Fetch the archive for this action item, if it is still pending,
+   * clearing the pending flag when the archive becomes available.
+   */
+  if( (flags & ACTION_DOWNLOAD) == ACTION_DOWNLOAD )
+  {
+    char *package_url = download_url( Selection(), package_name );
+    if( download_archive( package_name, package_url, archive_cache_path ) )
+      flags &= ~(ACTION_DOWNLOAD);
+    free( package_url );
+  }
+}
+
+/* By default, we allow as many as four package archives to be downloaded
+ * concurrently; the user may choose any other number, up to a limit which
+ * avoids unreasonable demands on the repository hosts.
+ */
+#define PKG_DOWNLOAD_WORKERS_DEFAULT	4
+#define PKG_DOWNLOAD_WORKERS_MAX	16
+
+class pkgDownloadScheduler
+{
+  /* A locally implemented class, to distribute the pending archive
+   * download requests for an action list among a bounded pool of
+   * concurrently active worker threads; the workers may run to
+   * completion while the caller waits, or they may continue in the
+   * background, while the caller installs each package as soon as
+   * its archive becomes available.  Since the caller may modify the
+   * XML database meanwhile, the workers must never refer to it; each
+   * request is resolved in advance, to the archive name and URL which
+   * the worker needs, and its outcome is subsequently applied to the
+   * action item, by the caller's thread.
+   */
+  public:
+    pkgDownloadScheduler( pkgActionItem**, unsigned );
+    ~pkgDownloadScheduler();
+
+    void Execute( unsigned );
+    void Start( unsigned, bool = false );
+    void Await( pkgActionItem* );
+    void Finish();
+
+  private:
+    struct request
+    {
+      pkgActionItem *item;
+      char *package_name;
+      char *package_url;
+      bool serviced, fetched;
+    } *queue;
+    unsigned pending, next;
+
+    HANDLE thread[PKG_DOWNLOAD_WORKERS_MAX];
+    unsigned started;
+    HANDLE signal;
+
+    pkgDownloadMeterGroup *meter;
+
+    unsigned Next();
+    void Complete( unsigned, bool );
+    void Apply( unsigned );
+    static unsigned __stdcall Worker( void* );
+};
+
+/* When downloads proceed in the background, during installation, the
+ * scheduler which controls them is accessible via this reference.
+ */
+static pkgDownloadScheduler *download_pipeline = NULL;
+
+pkgDownloadScheduler::pkgDownloadScheduler
+( pkgActionItem **list, unsigned count ): pending( count ), next( 0 ),
+started( 0 ), meter( NULL )
+{
+  /* The scheduler may outlive the caller's queue of requests; it
+   * keeps its own copy, resolving the archive name and download URL
+   * for each, while we are still running in the caller's thread, and
+   * recording which have been serviced; it also creates an event by
+   * which the workers signal completion of each request, to any
+   * thread which may be waiting for it.
+   */
+  if( (queue = (struct request *)(calloc( count, sizeof( struct request ) ))) == NULL )
+    pending = 0;
+  else while( count-- > 0 )
+  {
+    const char *package_name = list[count]->Selection()->ArchiveName();
+    queue[count].item = list[count];
+    if( (queue[count].package_name = strdup( package_name )) != NULL )
+      queue[count].package_url = download_url( list[count]->Selection(), package_name );
+  }
+  signal = CreateEvent( NULL, FALSE, FALSE, NULL );
+}
+
+pkgDownloadScheduler::~pkgDownloadScheduler()
+{
+  /* The destructor must wait for any workers which remain active,
+   * before it releases the resources which they share.
+   */
+  Finish();
+  if( signal != NULL )
+    CloseHandle( signal );
+  for( unsigned index = 0; index < pending; index++ )
+  {
+    free( queue[index].package_url );
+    free( queue[index].package_name );
+  }
+  free( queue );
+}
+
+unsigned pkgDownloadScheduler::Next()
+{
+  /* Retrieve the queue index of the next pending request, (or the
+   * queue size, when the queue has been exhausted); since this may be
+   * called by several worker threads concurrently, it must be serialised.
+   */
+  unsigned index;
+  download_monitor.Acquire();
+  if( (index = next) < pending )
+    ++next;
+  download_monitor.Release();
+  return index;
+}
+
+void pkgDownloadScheduler::Complete( unsigned index, bool fetched )
+{
+  /* Record that the request at the specified queue index has been
+   * serviced, and whether successfully, or not, then wake any thread
+   * which may be waiting for it.
+   */
+  download_monitor.Acquire();
+  queue[index].fetched = fetched;
+  queue[index].serviced = true;
+  download_monitor.Release();
+
+  meter->Complete();
+  if( signal != NULL )
+    SetEvent( signal );
+}
+
+unsigned __stdcall pkgDownloadScheduler::Worker( void *scheduler )
+{
+  /* Thread procedure for each worker; it simply services requests from
+   * the queue, until none remain.  Note that each request is only ever
+   * serviced by one worker, which refers only to the archive name and
+   * URL resolved in advance; it leaves the action item untouched, for
+   * the outcome to be applied by Apply(), in the caller's thread.
+   */
+  unsigned index;
+  pkgDownloadScheduler *self = (pkgDownloadScheduler *)(scheduler);
+  while( (index = self->Next()) < self->pending )
+  {
+    struct request *ref = self->queue + index;
+    self->Complete( index, (ref->package_name != NULL)
+	&& download_archive( ref->package_name, ref->package_url, pkgArchivePath() )
+      );
+  }
+  return 0;
+}
+
+void pkgDownloadScheduler::Start( unsigned workers, bool background )
+{
+  /* Begin servicing the requests in the queue, using a pool of as many
+   * as the specified number of worker threads, and reporting combined
+   * progress on a single group meter; when the downloads proceed in the
+   * background, the meter is displayed only while the caller waits.
+   */
+  meter = new pkgDownloadMeterGroup( pending );
+  meter->Show( ! background );
+  download_monitor.SetMeter( meter );
+  dmh_serialise( download_monitor_acquire, download_monitor_release );
+
+  if( signal == NULL )
+    /*
+     * Without an event, by which workers may report completion of each
+     * request, we cannot safely run them in the background.
      */
-    flags &= ~(ACTION_DOWNLOAD);
+    workers = 0;
+
+  else if( workers > PKG_DOWNLOAD_WORKERS_MAX )
+    workers = PKG_DOWNLOAD_WORKERS_MAX;
+
+  while( started < workers )
+  {
+    /* Start each worker in turn; (we use _beginthreadex(), rather than
+     * CreateThread(), to ensure that the C runtime is properly set up
+     * for use within each thread).
+     */
+    HANDLE worker = (HANDLE)(_beginthreadex( NULL, 0, Worker, this, 0, NULL ));
+    if( worker == NULL )
+      break;
+    thread[started++] = worker;
+  }
+  if( started == 0 )
+    /*
+     * If we were unable to start any worker thread, service the
+     * entire queue within the calling thread.
+     */
+    Worker( this );
+}
+
+void pkgDownloadScheduler::Await( pkgActionItem *item )
+{
+  /* Wait until the request, if any, for the specified action item has
+   * been serviced, displaying download progress meanwhile; should it
+   * have failed, we retry it once, (as we would have done, had we been
+   * downloading all archives in advance of installation).
+   */
+  unsigned index = 0;
+  while( (index < pending) && (queue[index].item != item) )
+    ++index;
+
+  if( index < pending )
+  {
+    bool done;
+    download_monitor.Acquire();
+    meter->Show( true );
+    download_monitor.Release();
+    do { download_monitor.Acquire();
+	 done = queue[index].serviced;
+	 download_monitor.Release();
+       } while( ! done && (signal != NULL)
+	   && (WaitForSingleObject( signal, INFINITE ) == WAIT_OBJECT_0)  );
+
+    Apply( index );
+    if( item->HasAttribute( ACTION_DOWNLOAD ) )
+      item->DownloadSingleArchive(
+	  item->Selection()->ArchiveName(), pkgArchivePath()
+	);
+
+    download_monitor.Acquire();
+    meter->Show( false );
+    download_monitor.Release();
+  }
+}
+
+void pkgDownloadScheduler::Finish()
+{
+  /* Wait for all of the workers we did manage to start to complete
+   * their processing of the queue, then release their handles.
+   */
+  if( started > 0 )
+    WaitForMultipleObjects( started, thread, TRUE, INFINITE );
+  while( started > 0 )
+    CloseHandle( thread[--started] );
+
+  if( meter != NULL )
+  {
+    dmh_serialise( NULL, NULL );
+    download_monitor.SetMeter( NULL );
+    delete meter;
+    meter = NULL;
+
+    /* With no worker remaining active, we may now apply the outcome
+     * of every request, which has not already been applied.
+     */
+    for( unsigned index = 0; index < pending; index++ )
+      Apply( index );
+  }
+}
+
+void pkgDownloadScheduler::Apply( unsigned index )
+{
+  /* Helper, invoked only in the caller's thread, to clear the pending
+   * download flag of the action item at the specified queue index, when
+   * its archive has been successfully retrieved; when it has not, the
+   * flag remains set, exactly as it would, had the archives been
+   * downloaded sequentially.
+   */
+  download_monitor.Acquire();
+  if( queue[index].serviced && queue[index].fetched )
+    queue[index].item->flags &= ~(ACTION_DOWNLOAD);
+  download_monitor.Release();
 }
 
-void pkgActionItem::DownloadArchiveFiles( pkgActionItem *current )
+void pkgDownloadScheduler::Execute( unsigned workers )
+{
+  /* Service all requests in the queue, while the caller waits.
+   */
+  Start( workers );
+  Finish();
+}
+
+static unsigned download_workers( unsigned pending )
+{
+  /* Helper function to determine how many worker threads should
+   * be used, to service a specified number of pending downloads; the
+   * user may specify this, either on the command line, or as an XML
+   * preference, but we never use more workers than we have requests.
+   */
+  unsigned workers = pkgOptions()->IsSet( OPTION_PARALLEL_DOWNLOADS )
+    ? pkgOptions()->GetValue( OPTION_PARALLEL_DOWNLOADS )
+    : PKG_DOWNLOAD_WORKERS_DEFAULT;
+
+  if( workers > PKG_DOWNLOAD_WORKERS_MAX )
+    workers = PKG_DOWNLOAD_WORKERS_MAX;
+  return (workers < pending) ? workers : pending;
+}
+
+void pkgActionItem::DownloadArchiveFiles( pkgActionItem *current, bool background )
 {
   /* Update the local package cache, to ensure that all packages needed
    * to complete the current set of scheduled actions are present; if any
    * are missing, invoke an Internet download agent to fetch them.  This
-   * requires us to walk the action list...
+   * requires us to walk the action list, first to identify those items
+   * for which a download may be required; (when the user has asked for
+   * archives to be streamed directly into the installer, we need fetch
+   * only those which will replace a prior installation, since it is
+   * removed before installation begins, and must not be lost should
+   * the download fail part way through)...
    */
-  while( current != NULL )
+  bool streaming =
+    (pkgOptions()->Test( OPTION_STREAM_INSTALL ) == OPTION_STREAM_INSTALL)
+    && (pkgOptions()->Test( OPTION_DOWNLOAD_ONLY ) != OPTION_DOWNLOAD_ONLY);
+
+  unsigned pending = 0;
+  pkgActionItem *item;
+  for( item = current; item != NULL; item = item->next )
   {
     /* ...while we haven't run off the end...
      */
-    if( (current->flags & ACTION_INSTALL) == ACTION_INSTALL )
+    if( (item->flags & ACTION_INSTALL) == ACTION_INSTALL )
     {
       /* For all packages specified in the current action list,
        * for which an "install" action is scheduled, and for which
        * no associated archive file is present in the local archive
        * cache, place an Internet download agent on standby to fetch
        * the required archive from a suitable internet mirror host.
-       */
-      const char *package_name = current->Selection()->ArchiveName();
-
-      /* An explicit package name of "none" is a special case;
+       *
+       * An explicit package name of "none" is a special case;
        * it identifies a "virtual" meta-package...
        */
-      if( match_if_explicit( package_name, value_none ) )
+      if( match_if_explicit( item->Selection()->ArchiveName(), value_none ) )
 	/*
 	 * ...which requires nothing to be downloaded...
 	 */
-	current->flags &= ~(ACTION_DOWNLOAD);
+	item->flags &= ~(ACTION_DOWNLOAD);
 
-      else
-	/* ...but we expect any other package to provide real content,
-	 * for which we may need to download the package archive...
+      else if( ((item->flags & ACTION_DOWNLOAD) == ACTION_DOWNLOAD)
+      &&  (! streaming || (item->Selection( to_remove ) != NULL))  )
+	/*
+	 * ...but we expect any other package to provide real content,
+	 * for which we may need to download the package archive.
 	 */
-	current->DownloadSingleArchive( package_name, pkgArchivePath() );
+	++pending;
     }
-    /* Repeat download action, for any additional packages specified
-     * in the current "actions" list.
+  }
+
+  if( pending > 0 )
+  {
+    /* There is at least one archive which we may need to download,
+     * (and which we must download now, rather than deferring it until
+     * installation); collect all such download requests into a queue...
      */
-    current = current->next;
+    pkgActionItem *queue[pending];
+    for( pending = 0, item = current; item != NULL; item = item->next )
+      if(  ((item->flags & ACTION_INSTALL) == ACTION_INSTALL)
+      &&   ((item->flags & ACTION_DOWNLOAD) == ACTION_DOWNLOAD)
+      &&   (! streaming || (item->Selection( to_remove ) != NULL))  )
+	queue[pending++] = item;
+
+    unsigned workers = download_workers( pending );
+    if( background )
+    {
+      /* ...and, when the caller is to proceed with installation while
+       * the downloads continue, dispatch them to a pool of background
+       * worker threads, (at least one, even when the user has asked
+       * for them to be processed sequentially); the caller must then
+       * use AwaitArchiveDownload(), to wait for each archive in turn,
+       * and finally, FinishArchiveDownloads().
+       */
+      download_pipeline = new pkgDownloadScheduler( queue, pending );
+      download_pipeline->Start( (workers > 0) ? workers : 1, true );
+    }
+    else if( workers > 1 )
+      /*
+       * ...or, when concurrent downloads are permitted, dispatch
+       * them to a pool of download worker threads...
+       */
+      pkgDownloadScheduler( queue, pending ).Execute( workers );
+
+    else for( unsigned index = 0; index < pending; index++ )
+      /*
+       * ...otherwise, simply process them sequentially, in order.
+       */
+      queue[index]->DownloadSingleArchive(
+	  queue[index]->Selection()->ArchiveName(), pkgArchivePath()
+	);
   }
 }
 
+void pkgActionItem::AwaitArchiveDownload()
+{
+  /* When package archives are being downloaded in the background,
+   * wait until the archive for this action item, (if any), has been
+   * retrieved, (or its retrieval has failed).
+   */
+  if( download_pipeline != NULL )
+    download_pipeline->Await( this );
+}
+
+void pkgActionItem::FinishArchiveDownloads()
+{
+  /* Wait for any background download activity to be completed, and
+   * release the resources associated with it.
+   */
+  delete download_pipeline;
+  download_pipeline = NULL;
+}
+
 #define DATA_CACHE_PATH		"%R" "var/cache/mingw-get/data"
 #define WORKING_DATA_PATH	"%R" "var/lib/mingw-get/data"
 
@@ -794,6 +1759,11 @@ public pkgInternetStreamingAgent, public pkgLzmaArchiveStream
      */
     virtual int GetRawData( int, uint8_t*, size_t );
     virtual int TransferData( int );
+
+    /* Since the data we download is decompressed, as we receive it,
+     * an interrupted transfer cannot be resumed.
+     */
+    virtual bool Resumable(){ return false; }
 };
 
 /* This specialisation of the pkgInternetStreamingAgent class needs its
@@ -822,7 +1792,7 @@ int pkgInternetLzmaStreamingAgent::GetRawData( int fd, uint8_t *buf, size_t max
    * may retrieve it, via the filter, as an uncompressed stream.
    */
   unsigned long count;
-  dl_status = pkgDownloadAgent.Read( dl_host, (char *)(buf), max, &count );
+  dl_status = dl_host->Read( (char *)(buf), max, &count );
   return (int)(count);
 }
 
@@ -844,6 +1814,243 @@ int pkgInternetLzmaStreamingAgent::TransferData( int fd )
   return dl_status;
 }
 
+/* When the user asks for package archives to be streamed directly into
+ * the installer, rather than downloaded into the local cache before it
+ * is invoked, we use a further variant of pkgInternetStreamingAgent; in
+ * this case, it also serves as the raw data source for the decompression
+ * filter, through which the installer reads the archive, optionally
+ * copying the data into the local cache, as it passes through.
+ */
+class pkgInternetArchiveStream :
+public pkgInternetStreamingAgent, public pkgArchiveStream
+{
+  public:
+    pkgInternetArchiveStream( const char*, const char* );
+    virtual ~pkgInternetArchiveStream();
+
+    bool Open( const char*, bool );
+
+    inline bool IsReady(){ return dl_host != NULL; }
+    virtual int Read( char*, size_t );
+
+  private:
+    /* When a copy of the archive is to be placed in the local cache,
+     * it is written to a "transit-file", and moved to its final location
+     * only when the download is known to be complete; (since the data are
+     * consumed as they arrive, an interrupted download cannot be resumed).
+     */
+    char *transit_file;
+    int cache_fd;
+    unsigned long content_length, tally;
+
+    virtual bool Resumable(){ return false; }
+    void Finish();
+};
+
+pkgInternetArchiveStream::pkgInternetArchiveStream
+( const char *local_name, const char *dest_specification ):
+pkgInternetStreamingAgent( local_name, dest_specification ),
+transit_file( NULL ), cache_fd( -1 ), content_length( 0 ), tally( 0 )
+{
+  /* The constructor merely establishes the initial state; no data
+   * stream becomes available, until the Open() method is invoked.
+   */
+  dl_host = NULL;
+  dl_meter = NULL;
+  dl_status = 0;
+}
+
+bool pkgInternetArchiveStream::Open( const char *from_url, bool keep )
+{
+  /* Initiate the download of an archive, from the specified URL, and,
+   * when "keep" is true, prepare to save a copy in the local cache.
+   */
+  if( (dl_host = pkgDownloadAgent.Open( from_url )) != NULL )
+  {
+    if( dl_host->Status() == HTTP_STATUS_OK )
+    {
+      /* The server will deliver the archive; we may begin reading,
+       * reporting progress as the installer consumes the data.
+       */
+      dl_status = 1;
+      content_length = dl_host->ContentLength();
+      dl_meter = new pkgDownloadMeterTTY( from_url, content_length );
+      dl_meter->Update( 0 );
+      if( keep )
+      {
+	/* Establish the "transit-file"; since we will always rewrite
+	 * it entirely, we must discard any record which may remain from
+	 * an interrupted attempt to download it by the regular method.
+	 */
+	char transit_path[set_transit_path( dest_template, filename )];
+	set_transit_path( dest_template, filename, transit_path );
+	char state_file[8 + sizeof( transit_path )];
+	sprintf( state_file, "%s.resume", transit_path );
+	unlink( state_file );
+
+	if( (cache_fd = set_output_stream( transit_path, 0644 )) >= 0 )
+	  transit_file = strdup( transit_path );
+      }
+    }
+    else
+    { /* The server declined to deliver the archive; we have nothing
+       * to read, so we may close the URL resource immediately.
+       */
+      DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	  dmh_printf( "%s: status = %lu\n", from_url, dl_host->Status() )
+	);
+      delete dl_host;
+      dl_host = NULL;
+    }
+  }
+  return IsReady();
+}
+
+int pkgInternetArchiveStream::Read( char *buf, size_t max )
+{
+  /* Read raw archive data, as it is downloaded; note that, since the
+   * decompression filters interpret a short read as end-of-data, we must
+   * continue reading, until the request is satisfied, or the download
+   * is complete.
+   */
+  size_t total = 0;
+  unsigned long count = 0;
+  while( dl_status && (dl_host != NULL) && (total < max)
+  &&    (dl_status = dl_host->Read( buf + total, max - total, &count ))
+  &&    (count > 0)  )
+  {
+    /* As each block of data arrives, copy it to the "transit-file",
+     * if any; should this fail, we simply abandon the cached copy, (we
+     * may still be able to complete the installation).
+     */
+    if( (cache_fd >= 0) && (write( cache_fd, buf + total, count ) != (int)(count)) )
+    {
+      close( cache_fd );
+      cache_fd = -1;
+    }
+    total += count; tally += count;
+  }
+  if( dl_meter != NULL )
+    dl_meter->Update( tally );
+
+  if( (dl_host != NULL) && (max > 0) && ((dl_status == 0) || (count == 0)) )
+  {
+    /* The download is complete, or has failed; we are done with the
+     * URL resource, (which may now be released for reuse).
+     */
+    DEBUG_INVOKE_IF(
+	DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ) && (dl_status == 0),
+	dmh_printf( "\nInternetReadFile:download error:%d\n", GetLastError() )
+      );
+    Finish();
+  }
+  return total;
+}
+
+void pkgInternetArchiveStream::Finish()
+{
+  /* Helper to close the URL resource, and to move the cached copy of
+   * the archive, if any, into the local cache, provided the download
+   * completed successfully, with no less data than we expected.
+   */
+  delete dl_host;
+  dl_host = NULL;
+  delete dl_meter;
+  dl_meter = NULL;
+
+  if( cache_fd >= 0 )
+  {
+    close( cache_fd );
+    cache_fd = -1;
+    if( dl_status && ((content_length == 0) || (tally == content_length)) )
+      rename( transit_file, dest_file );
+  }
+  if( transit_file != NULL )
+  {
+    /* In any case, we no longer need the "transit-file".
+     */
+    unlink( transit_file );
+    free( transit_file );
+    transit_file = NULL;
+  }
+}
+
+pkgInternetArchiveStream::~pkgInternetArchiveStream()
+{
+  /* The installer may not read the archive to its physical end, (tar
+   * archives may carry padding beyond their logical end); when we are
+   * storing a copy in the local cache, we must complete the download,
+   * before we close the URL resource.
+   */
+  if( cache_fd >= 0 )
+  {
+    char buf[8192];
+    while( Read( buf, sizeof( buf ) ) == (int)(sizeof( buf )) )
+      ;
+  }
+  if( dl_host != NULL )
+  {
+    dl_status = 0;
+    Finish();
+  }
+}
+
+void pkgActionItem::StreamSingleArchive
+( const char *package_name, const char *archive_cache_path )
+{
+  pkgInternetArchiveStream *download;
+  download = new pkgInternetArchiveStream( package_name, archive_cache_path );
+
+  /* Check if the required archive is already available locally...
+   */
+  if( (access( download->DestFile(), R_OK ) != 0) && (errno == ENOENT) )
+  {
+    /* ...if not, initiate the download...
+     */
+    const char *url_template = get_host_info( Selection(), uri_key );
+    if( url_template != NULL )
+    {
+      /* ...from the URL constructed from the template specified in
+       * the package repository catalogue, copying it into the local
+       * cache as it arrives, unless the user has asked us not to.
+       */
+      const char *mirror = get_host_info( Selection(), mirror_key );
+      char package_url[mkpath( NULL, url_template, package_name, mirror )];
+      mkpath( package_url, url_template, package_name, mirror );
+      bool keep = pkgOptions()->Test( OPTION_NO_CACHE ) != OPTION_NO_CACHE;
+      if( download->Open( package_url, keep ) )
+      {
+	/* Download has been initiated; attach the decompression filter
+	 * through which the installer will read the archive, and clear
+	 * the pending flag.
+	 */
+	archive_stream = pkgOpenStreamingArchive( package_name, download );
+	flags &= ~(ACTION_DOWNLOAD);
+	return;
+      }
+      /* Diagnose failure; leave pending flag set.
+       */
+      dmh_notify( DMH_ERROR,
+	  "Get package: %s: download failed\n", package_url
+	);
+    }
+    else
+      /* Cannot download; the repository catalogue didn't specify a
+       * template, from which to construct a download URL...
+       */
+      dmh_notify( DMH_ERROR,
+	  "Get package: %s: no URL specified for download\n", package_name
+	);
+  }
+  else
+    /* The archive is already present in the local cache; there is no
+     * need to download it, and the installer will read it from there.
+     */
+    flags &= ~(ACTION_DOWNLOAD);
+
+  delete download;
+}
+
 static const char *serial_number( const char *catalogue )
 {
   /* Local helper function to retrieve issue numbers from any repository
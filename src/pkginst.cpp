@@ -25,20 +25,216 @@
  * arising from the use of this software.
  *
  */
+#include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "dmh.h"
+#include "mkpath.h"
 
 #include "pkginfo.h"
 #include "pkgkeys.h"
+#include "pkgmfst.h"
+#include "pkgopts.h"
+#include "pkgownr.h"
 #include "pkgproc.h"
 #include "pkgtask.h"
 
 EXTERN_C const char *hashed_name( int, const char *, const char * );
 
+class pkgManifestIndex
+{
+  /* A local class, maintaining the persistent index which maps each
+   * package tarname to the hashed name of its manifest file; this allows
+   * the pkgManifest constructor to locate an existing manifest with one
+   * look-up, and one parse, in place of probing each of the possible
+   * hashed file names, and parsing every candidate it finds.  The index
+   * is loaded on first reference; changes are accumulated in memory, and
+   * committed to disk, by replacing the entire index file, only when the
+   * system map is updated, (or, failing that, when the index is itself
+   * destroyed), so that rebuilding an index which has been lost costs
+   * one write, rather than one for each installed package.
+   */
+  public:
+    pkgManifestIndex(): index( NULL ), modified( false ){}
+    ~pkgManifestIndex(){ Commit(); delete index; }
+
+    const char *Lookup( const char* );
+    void Assign( const char*, const char* );
+    void Remove( const char* );
+    void Commit();
+
+  private:
+    pkgXmlDocument *index;
+    bool modified;
+    pkgXmlNode *Entry( const char* );
+};
+
+/* The tag name for the root element of the index file, (which also
+ * serves as the base name for the file itself).
+ */
+static const char *manifest_index_key = "manifest-index";
+
+pkgXmlNode *pkgManifestIndex::Entry( const char *tarname )
+{
+  /* Private helper, to load the index if necessary, and then to
+   * retrieve its entry for the specified tarname, (if any).
+   */
+  if( index == NULL )
+  {
+    /* The index has not yet been loaded; do it now, or create
+     * an empty index if there is no existing index file.
+     */
+    const char *indexfile = xmlfile( manifest_index_key );
+    index = new pkgXmlDocument( indexfile );
+    free( (void *)(indexfile) );
+
+    pkgXmlNode *root;
+    if( ! index->IsOk() || ((root = index->GetRoot()) == NULL)
+    ||  ! root->IsElementOfType( manifest_index_key )  )
+    {
+      /* There is no usable index file; discard anything we may have
+       * loaded, and start anew; the index will be rebuilt, as existing
+       * manifests are subsequently located by probing for them.
+       */
+      delete index;
+      index = new pkgXmlDocument();
+      index->AddDeclaration( "1.0", "UTF-8", value_yes );
+      index->SetRoot( new pkgXmlNode( manifest_index_key ) );
+    }
+  }
+  pkgXmlNode *ref = index->GetRoot()->FindFirstAssociate( manifest_key );
+  while( (ref != NULL) && ! pkg_strcmp( tarname, ref->GetPropVal( tarname_key, NULL )) )
+    ref = ref->FindNextAssociate( manifest_key );
+  return ref;
+}
+
+const char *pkgManifestIndex::Lookup( const char *tarname )
+{
+  /* Retrieve the hashed name of the manifest recorded for the
+   * specified tarname, or NULL if there is none.
+   */
+  pkgXmlNode *ref = Entry( tarname );
+  return (ref != NULL) ? ref->GetPropVal( id_key, NULL ) : NULL;
+}
+
+void pkgManifestIndex::Assign( const char *tarname, const char *signame )
+{
+  /* Record the hashed name of the manifest for the specified tarname,
+   * marking the index as modified, if this changes it.
+   */
+  pkgXmlNode *ref;
+  if( (ref = Entry( tarname )) == NULL )
+  {
+    ref = new pkgXmlNode( manifest_key );
+    ref->SetAttribute( tarname_key, tarname );
+    index->GetRoot()->AddChild( ref );
+  }
+  else if( strcmp( signame, ref->GetPropVal( id_key, value_unknown )) == 0 )
+    return;
+
+  ref->SetAttribute( id_key, signame );
+  modified = true;
+}
+
+void pkgManifestIndex::Remove( const char *tarname )
+{
+  /* Delete the index entry, if any, for the specified tarname,
+   * when the manifest to which it refers has been deleted.
+   */
+  pkgXmlNode *ref;
+  if( (ref = Entry( tarname )) != NULL )
+  {
+    index->GetRoot()->DeleteChild( ref );
+    modified = true;
+  }
+}
+
+void pkgManifestIndex::Commit()
+{
+  /* Write the index to disk, if it has been modified since it was
+   * loaded, or last committed; to ensure that the index file is never
+   * left in a partially written state, we write it to a temporary file,
+   * which we then move into place, replacing the original.
+   */
+  if( ! modified )
+    return;
+
+  modified = false;
+  const char *indexfile = xmlfile( manifest_index_key );
+  char tmpfile[5 + strlen( indexfile )]; sprintf( tmpfile, "%s.tmp", indexfile );
+  if( ! index->Save( tmpfile )
+  ||  ! MoveFileEx( tmpfile, indexfile, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+  {
+    /* We were unable to update the index; the best we can do is to
+     * discard it entirely, so that it will be rebuilt later, rather
+     * than leave it in an inconsistent state.
+     */
+    unlink( tmpfile );
+    unlink( indexfile );
+  }
+  free( (void *)(indexfile) );
+}
+
+static pkgManifestIndex &manifest_index()
+{
+  /* Accessor for the one manifest index; this is constructed on first
+   * reference, rather than at namespace scope, so that it is destroyed,
+   * (committing any outstanding changes), before any of the statics on
+   * which its XML document depends.
+   */
+  static pkgManifestIndex index;
+  return index;
+}
+
+void pkgManifest::CommitIndex()
+{
+  /* Commit any outstanding changes to the manifest index; this is
+   * called when the system map is updated.
+   */
+  manifest_index().Commit();
+}
+
+/* The attribute, and its value, which mark a manifest's inventory
+ * section as having its content recorded in compact form.
+ */
+static const char *format_key = "format";
+static const char *value_compact = "compact";
+
+static const char *compact_manifest_file( const char *signame )
+{
+  /* Construct the full path name for the compact form of the content
+   * inventory, for the manifest identified by "signame"; (this is
+   * analogous to xmlfile(), and the file is maintained alongside the
+   * XML manifest itself).
+   */
+  const char *datapath = "%R" "var/lib/mingw-get/data" "%/M/%F.bin";
+  char *datafile = (char *)(malloc( mkpath( NULL, datapath, signame, NULL ) ));
+
+  mkpath( datafile, datapath, signame, NULL );
+  return (const char *)(datafile);
+}
+
+static bool is_manifest_for
+( pkgXmlNode *root, const char *tag, const char *signame, const char *tarname )
+{
+  /* Helper to confirm that a manifest file, as loaded, is identified
+   * by the expected hashed name, and that it relates to the specified
+   * package tarname.
+   */
+  pkgXmlNode *rel;
+  const char *pkg_id, *pkg_tarname;
+  return ((root != NULL)
+    &&  ((root->IsElementOfType( tag )))
+    &&  ((pkg_id = root->GetPropVal( id_key, NULL )) != NULL)
+    &&  ((strcmp( pkg_id, signame ) == 0))
+    &&  ((rel = root->FindFirstAssociate( release_key )) != NULL)
+    &&  ((pkg_tarname = rel->GetPropVal( tarname_key, NULL )) != NULL)
+    &&  ((pkg_strcmp( pkg_tarname, tarname )))  );
+}
+
 pkgManifest::pkgManifest( const char *tag, const char *tarname )
 {
   /* Construct an in-memory image for processing a package manifest.
@@ -48,12 +244,38 @@ pkgManifest::pkgManifest( const char *tag, const char *tarname )
    */
   manifest = NULL;
   inventory = NULL;
+  compact = NULL;
 
   /* Then we check that a package tarname has been provided...
    */
   if( tarname != NULL )
   {
-    /* ...in which case, we proceed to set up the reference data...
+    /* ...in which case, we first consult the manifest index, to see
+     * if it identifies an existing manifest for this package...
+     */
+    const char *signame = manifest_index().Lookup( tarname );
+    if( signame != NULL )
+    {
+      const char *sigfile = xmlfile( signame, NULL );
+      if( (manifest = new pkgXmlDocument( sigfile ))->IsOk()
+      &&  is_manifest_for( manifest->GetRoot(), tag, signame, tarname )  )
+      {
+	/* ...and, when it does, we need look no further.
+	 */
+	free( (void *)(sigfile) );
+	return;
+      }
+      /* The index entry was stale; discard it, and anything we may
+       * have loaded, then fall through to locate the manifest from
+       * the possible hashed file names, (thus repairing the index).
+       */
+      free( (void *)(sigfile) );
+      delete manifest;
+      manifest = NULL;
+    }
+
+    /* When the index cannot identify the manifest, we proceed to set up
+     * the reference data...
      */
     int retry = 0;
     while( retry < 16 )
@@ -72,7 +294,7 @@ pkgManifest::pkgManifest( const char *tag, const char *tarname )
        * use this to create a new installation record file.
        */
       pkgXmlDocument *chkfile;
-      const char *signame = hashed_name( retry++, manifest_key, tarname );
+      signame = hashed_name( retry++, manifest_key, tarname );
       const char *sigfile = xmlfile( signame, NULL );
 
       /* Check for an existing file associated with the hash value...
@@ -92,20 +314,13 @@ pkgManifest::pkgManifest( const char *tag, const char *tarname )
 	   * to here we have already incremented 7 to become 8,
 	   * hence the check for retry < 9).
 	   */
-	  pkgXmlNode *root, *rel;
-	  const char *pkg_id, *pkg_tarname;
-	  if( ((root = chkfile->GetRoot()) != NULL)
-	  &&  ((root->IsElementOfType( tag )))
-	  &&  ((pkg_id = root->GetPropVal( id_key, NULL )) != NULL)
-	  &&  ((strcmp( pkg_id, signame ) == 0))
-	  &&  ((rel = root->FindFirstAssociate( release_key )) != NULL)
-	  &&  ((pkg_tarname = rel->GetPropVal( tarname_key, NULL )) != NULL)
-	  &&  ((pkg_strcmp( pkg_tarname, tarname )))  )
+	  if( is_manifest_for( chkfile->GetRoot(), tag, signame, tarname ) )
 	  {
 	    /* This is the manifest file we require...
-	     * assign it for return, and force an early exit
-	     * from the retry loop.
+	     * assign it for return, record it in the index,
+	     * and force an early exit from the retry loop.
 	     */
+	    manifest_index().Assign( tarname, signame );
 	    manifest = chkfile;
 	    retry = 16;
 	  }
@@ -147,6 +362,13 @@ pkgManifest::pkgManifest( const char *tag, const char *tarname )
 	inventory = new pkgXmlNode( manifest_key );
 	root->AddChild( inventory );
 
+	/* When the user has asked for the content manifest to be kept in
+	 * compact form, we accumulate its entries in a flat buffer, rather
+	 * than in the XML inventory section.
+	 */
+	if( pkgOptions()->Test( OPTION_COMPACT_MANIFESTS, OPTION_EXTRA_FLAGS ) != 0 )
+	  compact = new pkgCompactManifest();
+
 	/* Finally, having constructed a skeletal manifest,
 	 * force an immediate exit from the retry loop...
 	 */
@@ -234,14 +456,127 @@ void pkgManifest::AddEntry( const char *key, const char *pathname )
     /* ...in which case we allocate a new tracking record, with
      * "dir" or "file" reference key as appropriate, fill it out
      * with the associated path name attribute, and insert it in
-     * the inventory table.
+     * the inventory table, (or in its compact equivalent).
      */
+    if( compact != NULL )
+    {
+      compact->Append( key, pathname );
+      return;
+    }
     pkgXmlNode *entry = new pkgXmlNode( key );
     entry->SetAttribute( pathname_key, pathname );
     inventory->AddChild( entry );
   }
 }
 
+void pkgManifest::AddEntry
+( const char *key, const char *pathname, uint64_t size, time_t mtime,
+  uint32_t checksum )
+{
+  /* Variant of the preceding method, to add a file entry together
+   * with the properties of its content, as extracted; these allow a
+   * subsequent reinstallation, or upgrade, to identify files which it
+   * would leave unchanged, and so need not write again.
+   */
+  if( (this != NULL) && (inventory != NULL) )
+  {
+    if( compact != NULL )
+    {
+      compact->Append( key, pathname, size, mtime, checksum );
+      return;
+    }
+    char value[12];
+    pkgXmlNode *entry = new pkgXmlNode( key );
+    entry->SetAttribute( pathname_key, pathname );
+    sprintf( value, "%lu", (unsigned long)(size) );
+    entry->SetAttribute( size_key, value );
+    sprintf( value, "%lu", (unsigned long)(mtime) );
+    entry->SetAttribute( mtime_key, value );
+    sprintf( value, "%08lx", (unsigned long)(checksum) );
+    entry->SetAttribute( checksum_key, value );
+    inventory->AddChild( entry );
+  }
+}
+
+pkgCompactManifest *pkgManifest::GetCompactInventory()
+{
+  /* Retrieve the compact form of the content inventory, if any; for
+   * an existing manifest, in which the inventory section is marked as
+   * compact, we map the associated file on first reference.
+   */
+  pkgXmlNode *ref;
+  const char *signame;
+  if( (compact == NULL) && (manifest != NULL)
+  &&  ((ref = manifest->GetRoot()) != NULL)
+  &&  ((signame = ref->GetPropVal( id_key, NULL )) != NULL)
+  &&  ((ref = ref->FindFirstAssociate( manifest_key )) != NULL)
+  &&  (strcmp( ref->GetPropVal( format_key, value_unknown ), value_compact ) == 0)  )
+  {
+    const char *datafile = compact_manifest_file( signame );
+    if( ! (compact = new pkgCompactManifest( datafile ))->IsOk() )
+      dmh_notify( DMH_WARNING, "%s: compact manifest is unreadable\n", datafile );
+    free( (void *)(datafile) );
+  }
+  return compact;
+}
+
+void pkgManifest::CommitInventory( const char *signame )
+{
+  /* Private helper, called by the destructor when the manifest is to
+   * be saved; it ensures that the content inventory is committed in the
+   * form which the user has selected, converting an inventory which was
+   * previously recorded in the alternative form, as required.
+   */
+  pkgXmlNode *ref = manifest->GetRoot()->FindFirstAssociate( manifest_key );
+  if( ref == NULL )
+    return;
+
+  const char *datafile = compact_manifest_file( signame );
+  bool is_compact = strcmp( ref->GetPropVal( format_key, value_unknown ), value_compact ) == 0;
+  if( pkgOptions()->Test( OPTION_COMPACT_MANIFESTS, OPTION_EXTRA_FLAGS ) != 0 )
+  {
+    /* The inventory is to be recorded in compact form; unless it is
+     * already so recorded, any existing XML inventory must be converted,
+     * (but, for a new manifest, we already have it in compact form).
+     */
+    if( ! is_compact )
+    {
+      if( compact == NULL )
+	(compact = new pkgCompactManifest())->Import( ref );
+
+      if( compact->Save( datafile ) == 0 )
+      {
+	/* The compact inventory has been saved; remove the equivalent
+	 * XML entries, and mark the inventory section accordingly.
+	 */
+	for( pkgXmlNode *sect = ref; sect != NULL; sect = sect->FindNextAssociate( manifest_key ) )
+	  sect->Clear();
+	ref->SetAttribute( format_key, value_compact );
+      }
+      else if( ref->GetChildren() == NULL )
+	/*
+	 * We failed to save the compact inventory, and there is no XML
+	 * equivalent; fall back to recording it in XML form.
+	 */
+	compact->Export( ref );
+    }
+  }
+  else if( is_compact
+  &&  (GetCompactInventory() != NULL) && compact->IsOk()  )
+  {
+    /* The inventory was previously recorded in compact form, but the
+     * user now prefers XML; convert it, and discard the compact file,
+     * (but only if we can read it; otherwise, we must leave both it,
+     * and the reference to it, intact).
+     */
+    compact->Export( ref );
+    ref->RemoveAttribute( format_key );
+    delete compact; compact = NULL;
+    unlink( datafile );
+  }
+  free( (void *)(datafile) );
+}
+
 pkgManifest::~pkgManifest()
 {
   /* Destructor for package manifest images; it releases
@@ -250,33 +585,49 @@ pkgManifest::~pkgManifest()
    * a disk image as appropriate.
    */
   pkgXmlNode *ref;
-  const char *sigfile;
+  const char *signame, *sigfile, *tarname = NULL;
 
   /* First confirm that an identification signature has been
    * assigned for this manifest...
    */
   if(  ((manifest != NULL)) && ((ref = manifest->GetRoot()) != NULL)
-  &&   ((sigfile = ref->GetPropVal( id_key, NULL )) != NULL)          )
+  &&   ((signame = ref->GetPropVal( id_key, NULL )) != NULL)          )
   {
-    /* ...and map this to a file system reference path name.
+    /* ...and map this to a file system reference path name; also
+     * identify the package tarname, by which it is indexed.
      */
-    sigfile = xmlfile( sigfile );
+    pkgXmlNode *rel;
+    sigfile = xmlfile( signame );
+    if( (rel = ref->FindFirstAssociate( release_key )) != NULL )
+      tarname = rel->GetPropVal( tarname_key, NULL );
 
     /* Check if any current installation, as identified by
      * its sysroot key, refers to this manifest...
      */
     if(  ((ref = ref->FindFirstAssociate( reference_key )) != NULL)
     &&   ((ref = ref->FindFirstAssociate( sysroot_key )) != NULL)    )
-      /*
-       * ...and if so, commit this manifest to disk...
+    {
+      /* ...and if so, commit this manifest, and its content
+       * inventory, to disk, and ensure that the index refers
+       * to it...
        */
-      manifest->Save( sigfile );
-
+      CommitInventory( signame );
+      if( manifest->Save( sigfile ) && (tarname != NULL) )
+	manifest_index().Assign( tarname, signame );
+    }
     else
-      /* ...otherwise, this manifest is defunct, so
-       * delete any current disk copy.
+    { /* ...otherwise, this manifest is defunct, so
+       * delete any current disk copy, (including any compact
+       * form of its inventory), and its index entry.
        */
+      const char *datafile = compact_manifest_file( signame );
+      delete compact; compact = NULL;
+      unlink( datafile );
+      free( (void *)(datafile) );
       unlink( sigfile );
+      if( tarname != NULL )
+	manifest_index().Remove( tarname );
+    }
 
     /* Release the memory used to identify the path name for
      * the on-disk copy of this manifest...
@@ -286,6 +637,7 @@ pkgManifest::~pkgManifest()
 
   /* ...and finally, expunge its in-memory image.
    */
+  delete compact;
   delete manifest;
 }
 
@@ -332,7 +684,15 @@ void record_dependencies( pkgXmlNode *origin, pkgXmlNode *list )
 EXTERN_C void pkgRegister
 ( pkgXmlNode *sysroot, pkgXmlNode *origin, const char *tarname, const char *pkgfile )
 {
-  /* Search the installation records for the current sysroot...
+  /* Register the package in the file ownership index for the current
+   * sysroot, (which we must open before we update the installation
+   * records, so that it may be validated against them)...
+   */
+  pkgOwnershipIndex *owners;
+  if( (owners = pkgOwnershipIndex::Open( sysroot )) != NULL )
+    owners->Register( tarname );
+
+  /* ...then search the installation records for the current sysroot...
    */
   const char *pkg_tarname = NULL;
   pkgXmlNode *ref = sysroot->FindFirstAssociate( installed_key );
@@ -372,7 +732,7 @@ EXTERN_C void pkgRegister
      * record to, the relevant sysroot record.
      */
     sysroot->SetAttribute( modified_key, value_yes );
-    sysroot->AddChild( ref );
+    sysroot->AddInstallationRecord( ref );
   }
 }
 
@@ -434,9 +794,15 @@ EXTERN_C void pkgInstall( pkgActionItem *current )
 	{
 	  /* Here we have a "real" (physical) package to install;
 	   * for the time being, we assume it is packaged in our
-	   * standard "tar" archive format.
+	   * standard "tar" archive format, which we read either from
+	   * the local cache, or from any stream which has been set up
+	   * to deliver it directly from the repository; any files which
+	   * have been retained from a prior installation, are passed to
+	   * the installer, to be overwritten in place, (or skipped, if
+	   * unchanged, when the user has asked for this).
 	   */
-	  pkgTarArchiveInstaller install( pkg );
+	  pkgTarArchiveInstaller install
+	    ( pkg, current->ArchiveStream(), current->RetainedInventory() );
 	  if( install.IsOk() )
 	    install.Process();
 	}
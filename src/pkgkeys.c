@@ -25,9 +25,12 @@
  * arising from the use of this software.
  *
  */
+#include <stddef.h>
+
 const char *alias_key		    =	"alias";
 const char *application_key	    =	"application";
 const char *catalogue_key	    =	"catalogue";
+const char *checksum_key	    =	"crc32";
 const char *class_key		    =	"class";
 const char *component_key	    =	"component";
 const char *defaults_key	    =	"defaults";
@@ -46,6 +49,7 @@ const char *lt_key		    =	"lt";
 const char *manifest_key	    =	"manifest";
 const char *mirror_key		    =	"mirror";
 const char *modified_key	    =	"modified";
+const char *mtime_key		    =	"mtime";
 const char *name_key		    =	"name";
 const char *package_key 	    =	"package";
 const char *package_collection_key  =	"package-collection";
@@ -56,6 +60,7 @@ const char *reference_key	    =	"references";
 const char *release_key 	    =	"release";
 const char *repository_key	    =	"repository";
 const char *requires_key	    =	"requires";
+const char *size_key		    =	"size";
 const char *source_key		    =	"source";
 const char *subsystem_key	    =	"subsystem";
 const char *sysmap_key		    =	"system-map";
@@ -63,6 +68,22 @@ const char *sysroot_key 	    =	"sysroot";
 const char *tarname_key 	    =	"tarname";
 const char *uri_key		    =	"uri";
 
+/* The complete set of the above keys, (terminated by a NULL entry),
+ * for registration as interned XML names.
+ */
+const char **pkg_xml_keys[] =
+{
+  &alias_key, &application_key, &catalogue_key, &checksum_key, &class_key,
+  &component_key, &defaults_key, &dirname_key, &download_key,
+  &download_host_key, &eq_key, &filename_key, &ge_key, &gt_key, &id_key,
+  &installed_key, &issue_key, &le_key, &lt_key, &manifest_key, &mirror_key,
+  &modified_key, &mtime_key, &name_key, &package_key,
+  &package_collection_key, &package_list_key, &pathname_key, &profile_key,
+  &reference_key, &release_key, &repository_key, &requires_key, &size_key,
+  &source_key, &subsystem_key, &sysmap_key, &sysroot_key, &tarname_key,
+  &uri_key, NULL
+};
+
 /* Some standard values, which may be associated with certain
  * of the above keys.
  */
@@ -39,6 +39,7 @@
 EXTERN_C_DECL const char *alias_key;
 EXTERN_C_DECL const char *application_key;
 EXTERN_C_DECL const char *catalogue_key;
+EXTERN_C_DECL const char *checksum_key;
 EXTERN_C_DECL const char *class_key;
 EXTERN_C_DECL const char *component_key;
 EXTERN_C_DECL const char *defaults_key;
@@ -57,6 +58,7 @@ EXTERN_C_DECL const char *lt_key;
 EXTERN_C_DECL const char *manifest_key;
 EXTERN_C_DECL const char *mirror_key;
 EXTERN_C_DECL const char *modified_key;
+EXTERN_C_DECL const char *mtime_key;
 EXTERN_C_DECL const char *name_key;
 EXTERN_C_DECL const char *package_key;
 EXTERN_C_DECL const char *package_collection_key;
@@ -67,6 +69,7 @@ EXTERN_C_DECL const char *reference_key;
 EXTERN_C_DECL const char *release_key;
 EXTERN_C_DECL const char *repository_key;
 EXTERN_C_DECL const char *requires_key;
+EXTERN_C_DECL const char *size_key;
 EXTERN_C_DECL const char *source_key;
 EXTERN_C_DECL const char *subsystem_key;
 EXTERN_C_DECL const char *sysmap_key;
@@ -74,6 +77,10 @@ EXTERN_C_DECL const char *sysroot_key;
 EXTERN_C_DECL const char *tarname_key;
 EXTERN_C_DECL const char *uri_key;
 
+/* The complete set of the above keys, (terminated by a NULL entry).
+ */
+EXTERN_C_DECL const char **pkg_xml_keys[];
+
 /* Some standard values, which may be associated with certain
  * of the above XML database keys.
  */
@@ -0,0 +1,360 @@
+/*
+ * pkgmfst.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Implementation of the pkgCompactManifest class, which maintains the
+ * content inventory of a package manifest, in a compact binary format;
+ * this may be mapped directly into memory, so that no parsing, and no
+ * allocation for each entry, is required to use it.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mkpath.h"
+#include "pkgkeys.h"
+#include "pkgmfst.h"
+
+/* The signature, and format version, which identify a compact manifest;
+ * as for compiled catalogue images, the file is always written in host
+ * byte order, and the version number is chosen such that it will not
+ * match, if the file is read with the opposite byte order.
+ */
+#define PKGMFST_MAGIC		"MGMF"
+#define PKGMFST_VERSION 	0x00010000UL
+
+struct pkgCompactManifestHeader
+{
+  /* Layout specification for the fixed format header, which
+   * introduces each compact manifest file.
+   */
+  char		magic[4];	/* signature: PKGMFST_MAGIC */
+  uint32_t	version;	/* format version: PKGMFST_VERSION */
+  uint32_t	entries;	/* number of entries in path table */
+  uint32_t	pool_size;	/* number of bytes in string pool */
+};
+
+pkgCompactManifest::pkgCompactManifest():
+ok( true ), view( NULL ), table( NULL ), pool( NULL ), entries( 0 ),
+pool_size( 0 ), entry_buf( NULL ), pool_buf( NULL ), entry_max( 0 ),
+pool_max( 0 ){}
+
+pkgCompactManifest::pkgCompactManifest( const char *filename ):
+ok( false ), view( NULL ), table( NULL ), pool( NULL ), entries( 0 ),
+pool_size( 0 ), entry_buf( NULL ), pool_buf( NULL ), entry_max( 0 ),
+pool_max( 0 )
+{
+  /* Constructor: map an existing compact manifest file, read only,
+   * into memory; (we may release the file and mapping handles as soon
+   * as the view has been mapped, since the view itself keeps them open,
+   * for as long as it remains mapped).
+   */
+  HANDLE fd, map;
+  DWORD size = 0;
+  if( (fd = CreateFile( filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+	  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL )) != INVALID_HANDLE_VALUE )
+  {
+    if( ((size = GetFileSize( fd, NULL )) != INVALID_FILE_SIZE)
+    &&  (size >= sizeof( struct pkgCompactManifestHeader ))
+    &&  ((map = CreateFileMapping( fd, NULL, PAGE_READONLY, 0, 0, NULL )) != NULL) )
+    {
+      view = MapViewOfFile( map, FILE_MAP_READ, 0, 0, 0 );
+      CloseHandle( map );
+    }
+    CloseHandle( fd );
+  }
+  if( view != NULL )
+  {
+    /* The file is mapped; check that it has a valid header, which is
+     * consistent with the overall file size...
+     */
+    const struct pkgCompactManifestHeader *header
+      = (const struct pkgCompactManifestHeader *)(view);
+    if( (memcmp( header->magic, PKGMFST_MAGIC, sizeof( header->magic )) == 0)
+    &&  (header->version == PKGMFST_VERSION)
+    &&  ((header->pool_size > 0) || (header->entries == 0))
+    &&  ((sizeof( struct pkgCompactManifestHeader ) + header->pool_size
+	  + header->entries * sizeof( struct pkgCompactManifestEntry )) == size)  )
+    {
+      /* ...then establish references to its path table, and to its
+       * string pool, and confirm that neither can lead us astray.
+       */
+      table = (const struct pkgCompactManifestEntry *)(header + 1);
+      pool = (const char *)(table + (entries = header->entries));
+      ok = ((pool_size = header->pool_size) == 0) || (pool[pool_size - 1] == '\0');
+      for( unsigned index = 0; ok && (index < entries); index++ )
+	ok = (table[index].pathname < pool_size);
+    }
+    if( ! ok )
+    {
+      /* The file is invalid, or incompletely written; discard it.
+       */
+      UnmapViewOfFile( view );
+      view = NULL; table = NULL; pool = NULL; entries = 0;
+    }
+  }
+}
+
+pkgCompactManifest::~pkgCompactManifest()
+{
+  /* Destructor: unmap the view of any existing manifest, and release
+   * all memory allocated on the heap, for accumulating a new one.
+   */
+  if( view != NULL )
+    UnmapViewOfFile( view );
+  free( (void *)(entry_buf) );
+  free( (void *)(pool_buf) );
+}
+
+struct pkgCompactManifestOrder
+{
+  /* A path name reference, paired with the index of its associated
+   * entry in the path table; used when sorting the path table.
+   */
+  const char	*pathname;
+  uint32_t	 index;
+};
+
+static int compact_entry_compare( const void *a, const void *b )
+{
+  /* Comparison function, used to sort the path table by name.
+   */
+  return strcmp( *(const char * const *)(a), *(const char * const *)(b) );
+}
+
+const struct pkgCompactManifestEntry *pkgCompactManifest::Find( const char *pathname )
+{
+  /* Locate the entry for a specified path name; since only a mapped
+   * inventory is sorted, we decline to search any other.
+   */
+  if( (view != NULL) && (entries > 0) )
+  {
+    unsigned lo = 0, hi = entries;
+    while( lo < hi )
+    {
+      /* This is a conventional binary search, but we cannot delegate
+       * it to bsearch(), because the path table refers to its names
+       * by offset, rather than by pointer.
+       */
+      unsigned mid = (lo + hi) >> 1;
+      int cmp = strcmp( pathname, pool + table[mid].pathname );
+      if( cmp == 0 ) return table + mid;
+      if( cmp < 0 ) hi = mid; else lo = mid + 1;
+    }
+  }
+  return NULL;
+}
+
+struct pkgCompactManifestEntry *pkgCompactManifest::NewEntry
+( const char *key, const char *pathname )
+{
+  /* Private helper, to append a new entry to the flat buffers in which
+   * a new inventory is accumulated, expanding them as required; returns
+   * NULL, (and marks the inventory as invalid), on failure.
+   */
+  if( ! ok || (view != NULL) || (pathname == NULL) )
+    return NULL;
+
+  uint32_t len = strlen( pathname ) + 1;
+  if( entries >= entry_max )
+  {
+    uint32_t alloc = (entry_max > 0) ? entry_max << 1 : 1024;
+    struct pkgCompactManifestEntry *tmp;
+    if( (tmp = (struct pkgCompactManifestEntry *)(realloc( entry_buf,
+	    alloc * sizeof( struct pkgCompactManifestEntry ) ))) == NULL )
+    {
+      ok = false;
+      return NULL;
+    }
+    entry_buf = tmp; entry_max = alloc;
+  }
+  if( (pool_size + len) > pool_max )
+  {
+    uint32_t alloc = (pool_max > 0) ? pool_max : 16384;
+    while( alloc < (pool_size + len) ) alloc <<= 1;
+    char *tmp;
+    if( (tmp = (char *)(realloc( pool_buf, alloc ))) == NULL )
+    {
+      ok = false;
+      return NULL;
+    }
+    pool_buf = tmp; pool_max = alloc;
+  }
+  table = entry_buf; pool = pool_buf;
+
+  struct pkgCompactManifestEntry *ref = entry_buf + entries++;
+  memset( ref, 0, sizeof( struct pkgCompactManifestEntry ) );
+  memcpy( pool_buf + (ref->pathname = pool_size), pathname, len );
+  ref->flags = (strcmp( key, dirname_key ) == 0) ? PKGMFST_ENTRY_DIR
+    : PKGMFST_ENTRY_FILE;
+  pool_size += len;
+  return ref;
+}
+
+void pkgCompactManifest::Append( const char *key, const char *pathname )
+{
+  /* Append an entry, with no recorded file properties.
+   */
+  NewEntry( key, pathname );
+}
+
+void pkgCompactManifest::Append
+( const char *key, const char *pathname, uint64_t size, time_t mtime,
+  uint32_t checksum )
+{
+  /* Append an entry, together with the properties of its content.
+   */
+  struct pkgCompactManifestEntry *ref;
+  if( (ref = NewEntry( key, pathname )) != NULL )
+  {
+    ref->size = size; ref->mtime = (int64_t)(mtime); ref->checksum = checksum;
+    ref->flags |= PKGMFST_ENTRY_STAT | PKGMFST_ENTRY_CHECKSUM;
+  }
+}
+
+int pkgCompactManifest::Save( const char *filename )
+{
+  /* Write an accumulated inventory to a named file, sorting its path
+   * table as we go; to ensure that the file is never left in a partially
+   * written state, we write it to a temporary file, which we then move
+   * into place.  Returns zero on success, or -1 on failure.
+   */
+  if( ! ok || (view != NULL) )
+    return -1;
+
+  /* We sort an index of path name references, rather than the path
+   * table itself, so that the comparison function may be applied to
+   * the names directly; each reference is paired with the index of its
+   * associated entry.
+   */
+  struct pkgCompactManifestOrder *order = NULL;
+  if( (entries > 0) && ((order = (struct pkgCompactManifestOrder *)(malloc(
+	    entries * sizeof( struct pkgCompactManifestOrder ) ))) == NULL) )
+    return -1;
+  for( unsigned index = 0; index < entries; index++ )
+  {
+    order[index].pathname = pool + table[index].pathname;
+    order[index].index = index;
+  }
+  qsort( order, entries, sizeof( *order ), compact_entry_compare );
+
+  int fd, status = -1;
+  char tmpfile[5 + strlen( filename )]; sprintf( tmpfile, "%s.tmp", filename );
+  if( (fd = set_output_stream( tmpfile, 0644 )) >= 0 )
+  {
+    struct pkgCompactManifestHeader header;
+    memcpy( header.magic, PKGMFST_MAGIC, sizeof( header.magic ) );
+    header.version = PKGMFST_VERSION;
+    header.entries = entries; header.pool_size = pool_size;
+
+    bool written = write( fd, &header, sizeof( header ) ) == (int)(sizeof( header ));
+    for( unsigned index = 0; written && (index < entries); index++ )
+    {
+      const struct pkgCompactManifestEntry *ref = table + order[index].index;
+      written = write( fd, ref, sizeof( *ref ) ) == (int)(sizeof( *ref ));
+    }
+    if( written )
+      written = write( fd, pool, pool_size ) == (int)(pool_size);
+    close( fd );
+
+    if( written
+    &&  MoveFileEx( tmpfile, filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+      status = 0;
+    else
+      /* We failed to write the complete file; don't leave
+       * an incomplete copy in place.
+       */
+      unlink( tmpfile );
+  }
+  free( (void *)(order) );
+  return status;
+}
+
+void pkgCompactManifest::Import( pkgXmlNode *inventory )
+{
+  /* Append entries equivalent to each of the "dir" and "file" elements
+   * within an XML inventory, (allowing for the possibility that it may be
+   * subdivided into multiple sections).
+   */
+  for( ; inventory != NULL; inventory = inventory->FindNextAssociate( manifest_key ) )
+  {
+    pkgXmlNode *item = inventory->GetChildren();
+    for( ; item != NULL; item = item->GetNext() )
+    {
+      const char *key = item->GetName();
+      const char *pathname = item->GetPropVal( pathname_key, NULL );
+      if( item->IsElementOfType( filename_key ) || item->IsElementOfType( dirname_key ) )
+      {
+	struct pkgCompactManifestEntry *ref;
+	const char *size, *mtime, *checksum;
+	if( (ref = NewEntry( key, pathname )) != NULL )
+	{
+	  if( ((size = item->GetPropVal( size_key, NULL )) != NULL)
+	  &&  ((mtime = item->GetPropVal( mtime_key, NULL )) != NULL)  )
+	  {
+	    ref->size = strtoul( size, NULL, 10 );
+	    ref->mtime = strtoul( mtime, NULL, 10 );
+	    ref->flags |= PKGMFST_ENTRY_STAT;
+	  }
+	  if( (checksum = item->GetPropVal( checksum_key, NULL )) != NULL )
+	  {
+	    ref->checksum = strtoul( checksum, NULL, 16 );
+	    ref->flags |= PKGMFST_ENTRY_CHECKSUM;
+	  }
+	}
+      }
+    }
+  }
+}
+
+void pkgCompactManifest::Export( pkgXmlNode *inventory )
+{
+  /* Add a "dir" or "file" element, equivalent to each entry, to an
+   * XML inventory; this is the exact converse of Import().
+   */
+  for( unsigned index = 0; index < entries; index++ )
+  {
+    char value[12];
+    const struct pkgCompactManifestEntry *ref = table + index;
+    pkgXmlNode *item = new pkgXmlNode( ((ref->flags & PKGMFST_ENTRY_DIR) != 0)
+	? dirname_key : filename_key
+      );
+    item->SetAttribute( pathname_key, pool + ref->pathname );
+    if( (ref->flags & PKGMFST_ENTRY_STAT) != 0 )
+    {
+      sprintf( value, "%lu", (unsigned long)(ref->size) );
+      item->SetAttribute( size_key, value );
+      sprintf( value, "%lu", (unsigned long)(ref->mtime) );
+      item->SetAttribute( mtime_key, value );
+    }
+    if( (ref->flags & PKGMFST_ENTRY_CHECKSUM) != 0 )
+    {
+      sprintf( value, "%08lx", (unsigned long)(ref->checksum) );
+      item->SetAttribute( checksum_key, value );
+    }
+    inventory->AddChild( item );
+  }
+}
+
+/* $RCSfile: pkgmfst.cpp,v $: end of file */
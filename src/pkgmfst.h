@@ -0,0 +1,122 @@
+#ifndef PKGMFST_H
+/*
+ * pkgmfst.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Declaration of the pkgCompactManifest class, which provides a compact
+ * binary representation of the content inventory of a package manifest,
+ * as an alternative to recording each file and directory entry as an
+ * individual XML element.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define PKGMFST_H  1
+
+#include <stdint.h>
+#include <time.h>
+
+#include "pkgbase.h"
+
+/* Attribute flags, which qualify each entry in a compact manifest.
+ */
+#define PKGMFST_ENTRY_DIR	(0x01)	/* entry is a directory */
+#define PKGMFST_ENTRY_FILE	(0x02)	/* entry is a regular file */
+#define PKGMFST_ENTRY_STAT	(0x04)	/* size and mtime are recorded */
+#define PKGMFST_ENTRY_CHECKSUM	(0x08)	/* content checksum is recorded */
+
+struct pkgCompactManifestEntry
+{
+  /* Layout specification for each entry in the path table of
+   * a compact manifest; the path name is expressed as an offset
+   * into the string pool, so that the table is position independent.
+   */
+  uint32_t	pathname;	/* pool offset of path name */
+  uint32_t	flags;		/* PKGMFST_ENTRY_xxx attributes */
+  uint32_t	checksum;	/* CRC-32 of file content */
+  uint32_t	reserved;	/* padding; always zero */
+  uint64_t	size;		/* size of file content, in bytes */
+  int64_t	mtime;		/* modification time of file */
+};
+
+class pkgCompactManifest
+{
+  /* A class to manage the compact form of a package manifest's content
+   * inventory; each comprises a fixed format header, followed by a table
+   * of path entries, sorted by path name, and a pool of NUL terminated
+   * path name strings.  An existing compact manifest is mapped directly
+   * into memory, and used in place; a new one is accumulated in a flat
+   * buffer, to which each entry is appended as it is recorded, and which
+   * is sorted when it is saved.
+   */
+  public:
+    /* The default constructor creates a new, empty inventory, ready
+     * to accumulate entries; the alternative maps an existing file.
+     */
+    pkgCompactManifest();
+    pkgCompactManifest( const char* );
+    ~pkgCompactManifest();
+
+    /* Accessors...
+     */
+    inline bool IsOk(){ return ok; }
+    inline bool IsMapped(){ return view != NULL; }
+    inline unsigned Entries(){ return entries; }
+    inline const struct pkgCompactManifestEntry *Entry( unsigned index )
+    {
+      return (index < entries) ? table + index : NULL;
+    }
+    inline const char *Pathname( const struct pkgCompactManifestEntry *ref )
+    {
+      return pool + ref->pathname;
+    }
+
+    /* Method to locate the entry for a specified path name, within
+     * a mapped inventory, (which is always sorted), by binary search.
+     */
+    const struct pkgCompactManifestEntry *Find( const char* );
+
+    /* Methods to accumulate entries, and then to write the completed
+     * inventory to a named file.
+     */
+    void Append( const char*, const char* );
+    void Append( const char*, const char*, uint64_t, time_t, uint32_t );
+    int Save( const char* );
+
+    /* Methods to convert between the compact form of the inventory,
+     * and the equivalent XML representation.
+     */
+    void Import( pkgXmlNode* );
+    void Export( pkgXmlNode* );
+
+  private:
+    bool ok;
+    void *view;
+    const struct pkgCompactManifestEntry *table;
+    const char *pool;
+    uint32_t entries, pool_size;
+
+    struct pkgCompactManifestEntry *entry_buf;
+    char *pool_buf;
+    uint32_t entry_max, pool_max;
+
+    struct pkgCompactManifestEntry *NewEntry( const char*, const char* );
+};
+
+#endif /* PKGMFST_H: $RCSfile: pkgmfst.h,v $: end of file */
@@ -53,6 +53,11 @@ declare_hook(START_MENU);
 static const char *desktop_option = "--desktop";
 static const char *start_menu_option = "--start-menu";
 static const char *all_users_option = "--all-users";
+static const char *parallel_downloads_option = "--parallel-downloads";
+static const char *xz_threads_option = "--xz-threads";
+static const char *xz_memlimit_option = "--xz-memlimit";
+static const char *compact_manifests_option = "--compact-manifests";
+static const char *socket_transport_option = "--socket-transport";
 
 #define opt_strcmp(OPT,KEY)	strcmp( OPT, KEY + 2 )
 
@@ -69,6 +74,7 @@ class pkgPreferenceEvaluator
     const char *SetName( const char *name ){ return optname = name; }
     void PresetScriptHook( int, const char *, ... );
     void SetScriptHook( const char *, ... );
+    void SetNumericOption( int );
     pkgXmlNode *Current(){ return ref; }
 
   private:
@@ -306,6 +312,33 @@ void pkgPreferenceEvaluator::SetScriptHook( const char *key, ... )
   }
 }
 
+void pkgPreferenceEvaluator::SetNumericOption( int index )
+{
+  /* Method to interpret numeric options specified as XML preferences,
+   * and assign their values within the global options table, provided
+   * no prior assignment has been made by command line settings, (or by
+   * any preceding XML preferences specification).
+   */
+  const char *value = ref->GetPropVal( value_key, NULL );
+  if( (value != NULL) && (pkgOptions()->IsSet( index ) == 0) )
+  {
+    /* The preference specifies a value, and we are free to assign it;
+     * it must be expressed as an unsigned decimal integer...
+     */
+    char *endptr;
+    unsigned long numeric = strtoul( value, &endptr, 10 );
+    if( (*value != '\0') && (*endptr == '\0') )
+      pkgOptions()->SetValue( index, numeric );
+
+    else
+      /* ...otherwise, we diagnose and ignore it.
+       */
+      dmh_notify( DMH_WARNING,
+	  "option '%s': invalid value '%s' ignored\n", optname, value
+	);
+  }
+}
+
 void pkgXmlDocument::EstablishPreferences()
 {
   /* Method to interpret the content of any "preferences" sections
@@ -347,6 +380,39 @@ void pkgXmlDocument::EstablishPreferences()
 	     */
 	    opt.SetScriptHook( PKG_START_MENU_HOOK, NULL );
 
+	  else if( opt_strcmp( optname, parallel_downloads_option ) == 0 )
+	    /*
+	     * Specify how many package archives may be downloaded
+	     * concurrently, when no command line option overrides it.
+	     */
+	    opt.SetNumericOption( OPTION_PARALLEL_DOWNLOADS );
+
+	  else if( opt_strcmp( optname, xz_threads_option ) == 0 )
+	    /*
+	     * Specify how many threads may be used to decompress each
+	     * xz compressed archive...
+	     */
+	    opt.SetNumericOption( OPTION_XZ_THREADS );
+
+	  else if( opt_strcmp( optname, xz_memlimit_option ) == 0 )
+	    /*
+	     * ...and the memory, in MiB, which the decoder may use.
+	     */
+	    opt.SetNumericOption( OPTION_XZ_MEMLIMIT );
+
+	  else if( opt_strcmp( optname, compact_manifests_option ) == 0 )
+	    /*
+	     * Record package content manifests in compact form.
+	     */
+	    pkgOptions()->SetFlags( OPTION_EXTRA_FLAG( OPTION_COMPACT_MANIFESTS ) );
+
+	  else if( opt_strcmp( optname, socket_transport_option ) == 0 )
+	    /*
+	     * Fetch "http:" URLs using the portable socket transport,
+	     * in preference to wininet.
+	     */
+	    pkgOptions()->SetFlags( OPTION_EXTRA_FLAG( OPTION_SOCKET_TRANSPORT ) );
+
 	  else
 	    /* Any unrecognised option specification is simply ignored,
 	     * after posting an appropriate diagnostic message.
@@ -42,6 +42,9 @@ enum
   OPTION_DESKTOP_ARGS,
   OPTION_START_MENU_ARGS,
   OPTION_DEBUGLEVEL,
+  OPTION_DOWNLOAD_WORKERS,
+  OPTION_XZ_THREAD_COUNT,
+  OPTION_XZ_MEMORY_LIMIT,
 
   /* This final entry specifies the size of the parameter array which
    * comprises the data content of the options structure; it MUST be the
@@ -106,9 +109,29 @@ struct pkgopts
 #define OPTION_ALL_DEPS 	(0x00000090)
 #define OPTION_ALL_RELATED	(0x00000100)
 
+#define OPTION_STREAM_INSTALL	(0x00000200)
+#define OPTION_DISCARD_STREAM	(0x00000400)
+#define OPTION_NO_CACHE 	(OPTION_STREAM_INSTALL | OPTION_DISCARD_STREAM)
+
+/* Options controlled by bit-mapped flags within OPTION_EXTRA_FLAGS;
+ * when specified as CLI options, these must be qualified by the
+ * OPTION_EXTRA_FLAG() alignment shift...
+ */
+#define OPTION_SKIP_UNCHANGED	(0x00000001)
+#define OPTION_VERIFY_UNCHANGED	(0x00000003)
+#define OPTION_COMPACT_MANIFESTS	(0x00000004)
+#define OPTION_SOCKET_TRANSPORT	(0x00000008)
+
+#define OPTION_EXTRA_FLAG(F)	((0x00000008 << 24) | (F))
+
 #define OPTION_DESKTOP		(OPTION_STORE_STRING | OPTION_DESKTOP_ARGS)
 #define OPTION_START_MENU	(OPTION_STORE_STRING | OPTION_START_MENU_ARGS)
 
+#define OPTION_PARALLEL_DOWNLOADS  (OPTION_STORE_NUMBER | OPTION_DOWNLOAD_WORKERS)
+
+#define OPTION_XZ_THREADS	(OPTION_STORE_NUMBER | OPTION_XZ_THREAD_COUNT)
+#define OPTION_XZ_MEMLIMIT	(OPTION_STORE_NUMBER | OPTION_XZ_MEMORY_LIMIT)
+
 #if __cplusplus
 /*
  * We provide additional features for use in C++ modules.
@@ -145,6 +168,18 @@ class pkgOpts : protected pkgopts
        */
       return this ? (flags[index & 0xFFF].string) : NULL;
     }
+    inline void SetValue( int index, unsigned value )
+    {
+      /* Assign a numeric data entry, marking it as set; this
+       * mimics the CLI start-up code, for use when the value is
+       * specified by other means, (e.g. as an XML preference).
+       */
+      if( this )
+      {
+	mark_option_as_set( *this, index );
+	flags[index & 0xFFF].numeric = value;
+      }
+    }
     inline unsigned Test( unsigned mask, int index = OPTION_FLAGS )
     {
       /* Test the state of specified bits within
@@ -165,7 +200,7 @@ class pkgOpts : protected pkgopts
       if( (shift = (value & OPTION_SHIFT_MASK) >> 22) < 53 )
       {
 	*(uint64_t *)(flags) &= ~((uint64_t)((value & 0xfff000) >> 12) << shift);
-	*(uint64_t *)(flags) |= (uint64_t)(value) << shift;
+	*(uint64_t *)(flags) |= (uint64_t)(value & 0xfff) << shift;
       }
     }
 };
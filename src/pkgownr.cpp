@@ -0,0 +1,706 @@
+/*
+ * pkgownr.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Implementation of the pkgOwnershipIndex class, which maps the path
+ * name of each file installed within a sysroot, to the tarname of the
+ * package which provides it, and of the "owner" action, which queries
+ * this mapping from the command line.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _MAX_PATH
+/*
+ * Work around a PATH_MAX declaration anomaly in MinGW.
+ */
+# undef  PATH_MAX
+# define PATH_MAX _MAX_PATH
+#endif
+
+#include "dmh.h"
+#include "mkpath.h"
+#include "pkgkeys.h"
+#include "pkgmfst.h"
+#include "pkgownr.h"
+#include "pkgproc.h"
+
+#ifndef O_BINARY
+/*
+ * MS-Windows nuisances: files must be opened in binary mode, but
+ * O_BINARY is not defined on UNIX, where it isn't needed.
+ */
+# ifdef _O_BINARY
+#  define O_BINARY _O_BINARY
+# else
+#  define O_BINARY  0
+# endif
+#endif
+
+/* The signature, and format version, which identify an ownership index
+ * file; as for compact manifests, the file is always written in host
+ * byte order, and the version number is chosen such that it will not
+ * match, if the file is read with the opposite byte order.
+ */
+#define PKGOWNR_MAGIC		"MGOI"
+#define PKGOWNR_VERSION 	0x00010000UL
+
+/* The number of new entries which we will accumulate in the pending
+ * table, before we merge them into the main table.
+ */
+#define PKGOWNR_PENDING_MAX	1024
+
+struct pkgOwnershipIndexHeader
+{
+  /* Layout specification for the fixed format header, which introduces
+   * each ownership index file; it is followed by a table of pool offsets
+   * for the owning package tarnames, a path table of sorted path name
+   * and owner index pairs, and a pool of NUL terminated strings.
+   */
+  char		magic[4];	/* signature: PKGOWNR_MAGIC */
+  uint32_t	version;	/* format version: PKGOWNR_VERSION */
+  uint32_t	owners;		/* number of entries in owner table */
+  uint32_t	entries;	/* number of entries in path table */
+  uint32_t	pool_size;	/* number of bytes in string pool */
+};
+
+struct pkgOwnershipIndexRecord
+{
+  /* Layout specification for each entry in the path table of
+   * an ownership index file.
+   */
+  uint32_t	pathname;	/* pool offset of path name */
+  uint32_t	owner;		/* index into owner table */
+};
+
+/* Path names are compared with file system dependent case sensitivity.
+ */
+#if CASE_INSENSITIVE_FILESYSTEM
+# define owned_path_strcmp  strcasecmp
+#else
+# define owned_path_strcmp  strcmp
+#endif
+
+static int owned_path_compare( const void *a, const void *b )
+{
+  /* Comparison function, used to search the path tables.
+   */
+  return owned_path_strcmp( *(const char * const *)(a), *(const char * const *)(b) );
+}
+
+static const char *ownership_index_file( const char *id )
+{
+  /* Construct the full path name for the ownership index file,
+   * for the sysroot identified by "id"; it is maintained alongside
+   * the sysroot record file itself.
+   */
+  const char *datapath = "%R" "var/lib/mingw-get/data" "%/M/%F.owners";
+  char *datafile = (char *)(malloc( mkpath( NULL, datapath, id, NULL ) ));
+
+  mkpath( datafile, datapath, id, NULL );
+  return (const char *)(datafile);
+}
+
+pkgOwnershipIndex *pkgOwnershipIndex::registry = NULL;
+
+pkgOwnershipIndex::pkgOwnershipIndex( const char *sysroot_id ):
+table( NULL ), pending( NULL ), entries( 0 ), entry_max( 0 ), pendings( 0 ),
+pending_max( 0 ), owner( NULL ), owners( 0 ), owner_max( 0 ), image( NULL ),
+image_size( 0 ), modified( false )
+{
+  /* Private constructor: create an empty index, and add it to the
+   * registry of those already loaded; the caller is expected to load
+   * its content.
+   */
+  id = strdup( sysroot_id );
+  next = registry;
+  registry = this;
+}
+
+pkgOwnershipIndex::~pkgOwnershipIndex()
+{
+  /* Destructor: release all memory allocated for the index; (note
+   * that entries are never deleted while they remain registered).
+   */
+  Discard();
+  free( (void *)(id) );
+}
+
+void pkgOwnershipIndex::Discard()
+{
+  /* Private helper, to release the content of the index, leaving
+   * it empty; path names which are not held in the loaded file image
+   * have been individually allocated, and must be freed.
+   */
+  for( unsigned index = 0; index < entries; index++ )
+    if( ! InImage( table[index].pathname ) )
+      free( (void *)(table[index].pathname) );
+  for( unsigned index = 0; index < pendings; index++ )
+    free( (void *)(pending[index].pathname) );
+  for( unsigned index = 0; index < owners; index++ )
+    free( (void *)(owner[index]) );
+
+  free( (void *)(table) ); table = NULL; entries = entry_max = 0;
+  free( (void *)(pending) ); pending = NULL; pendings = pending_max = 0;
+  free( (void *)(owner) ); owner = NULL; owners = owner_max = 0;
+  free( (void *)(image) ); image = NULL; image_size = 0;
+}
+
+void pkgOwnershipIndex::Load()
+{
+  /* Private helper, to load the index file, in its entirety, leaving
+   * the index empty if it doesn't exist, or if it is invalid.
+   */
+  int fd;
+  const char *filename = ownership_index_file( id );
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+  {
+    struct stat info;
+    if( (fstat( fd, &info ) == 0)
+    &&  (info.st_size > (off_t)(sizeof( struct pkgOwnershipIndexHeader )))
+    &&  ((image = (char *)(malloc( info.st_size ))) != NULL)  )
+    {
+      int count, total = 0;
+      while( (total < info.st_size)
+      &&     ((count = read( fd, image + total, info.st_size - total )) > 0) )
+	total += count;
+
+      /* Check that the file has a valid header, which is consistent
+       * with the overall file size...
+       */
+      struct pkgOwnershipIndexHeader *header = (struct pkgOwnershipIndexHeader *)(image);
+      bool ok = (total == info.st_size)
+	&& (memcmp( header->magic, PKGOWNR_MAGIC, sizeof( header->magic )) == 0)
+	&& (header->version == PKGOWNR_VERSION) && (header->pool_size > 0)
+	&& ((sizeof( struct pkgOwnershipIndexHeader ) + header->pool_size
+	    + header->owners * sizeof( uint32_t )
+	    + header->entries * sizeof( struct pkgOwnershipIndexRecord ))
+	    == (size_t)(total));
+
+      uint32_t *owner_ref = (uint32_t *)(header + 1);
+      struct pkgOwnershipIndexRecord *record
+	= (struct pkgOwnershipIndexRecord *)(owner_ref + header->owners);
+      char *pool = (char *)(record + header->entries);
+      image_size = total;
+
+      /* ...and that none of its references can lead us astray; then
+       * establish the owner table, and the main path table.
+       */
+      if( ok && (pool[header->pool_size - 1] == '\0')
+      &&  ((owner = (char **)(malloc( (header->owners + 1) * sizeof( char* ) ))) != NULL)
+      &&  ((table = (struct entry *)(malloc( (header->entries + 1) * sizeof( struct entry ) ))) != NULL)  )
+      {
+	owner_max = header->owners + 1;
+	entry_max = header->entries + 1;
+	while( ok && (owners < header->owners) )
+	  if( (ok = (owner_ref[owners] < header->pool_size)) )
+	  {
+	    owner[owners] = strdup( pool + owner_ref[owners] );
+	    ++owners;
+	  }
+	for( unsigned index = 0; ok && (index < header->entries); index++ )
+	  if( (ok = (record[index].pathname < header->pool_size)
+	      && (record[index].owner < owners))  )
+	  {
+	    table[entries].pathname = pool + record[index].pathname;
+	    table[entries++].owner = record[index].owner;
+	  }
+
+	/* The path table should already be sorted; in case it isn't,
+	 * (e.g. because the case sensitivity of our path name comparisons
+	 * has changed), we check it, and sort it if necessary.
+	 */
+	for( unsigned index = 1; ok && (index < entries); index++ )
+	  if( owned_path_strcmp( table[index - 1].pathname, table[index].pathname ) > 0 )
+	  {
+	    qsort( table, entries, sizeof( struct entry ), owned_path_compare );
+	    break;
+	  }
+      }
+      else ok = false;
+
+      if( ! ok )
+      {
+	/* The file is invalid, or incompletely written; discard it.
+	 */
+	dmh_notify( DMH_WARNING, "%s: ownership index is invalid\n", filename );
+	entries = 0; Discard();
+      }
+    }
+    close( fd );
+  }
+  free( (void *)(filename) );
+}
+
+bool pkgOwnershipIndex::Covers( pkgXmlNode *sysroot )
+{
+  /* Private helper, to confirm that the set of packages registered in
+   * the index matches the set of installation records in the sysroot.
+   */
+  unsigned matched = 0;
+  pkgXmlNode *ref = sysroot->FindFirstAssociate( installed_key );
+  while( ref != NULL )
+  {
+    const char *tarname = ref->GetPropVal( tarname_key, NULL );
+    unsigned index = 0;
+    if( tarname != NULL )
+    {
+      while( (index < owners) && ! pkg_strcmp( owner[index], tarname ) )
+	++index;
+      if( index == owners )
+	return false;
+      ++matched;
+    }
+    ref = ref->FindNextAssociate( installed_key );
+  }
+  return matched == owners;
+}
+
+void pkgOwnershipIndex::Rebuild( pkgXmlNode *sysroot )
+{
+  /* Private helper, to reconstruct the index from the manifests of all
+   * packages which are recorded as installed in the sysroot; this is the
+   * only occasion on which we need to load every manifest.
+   */
+  Discard();
+  pkgXmlNode *ref = sysroot->FindFirstAssociate( installed_key );
+  while( ref != NULL )
+  {
+    const char *tarname;
+    if( (tarname = ref->GetPropVal( tarname_key, NULL )) != NULL )
+    {
+      /* Register each package, even if it has no manifest, (as for
+       * a virtual package), then claim the files which its manifest
+       * records, whether in compact, or in XML form.
+       */
+      Register( tarname );
+      pkgManifest manifest( package_key, tarname );
+      pkgCompactManifest *compact = manifest.GetCompactInventory();
+      if( compact != NULL )
+      {
+	const struct pkgCompactManifestEntry *item;
+	for( unsigned index = 0; (item = compact->Entry( index )) != NULL; index++ )
+	  if( (item->flags & PKGMFST_ENTRY_DIR) == 0 )
+	    Claim( compact->Pathname( item ), tarname );
+      }
+      else
+      {
+	pkgXmlNode *inventory = manifest.GetRoot()->FindFirstAssociate( manifest_key );
+	for( ; inventory != NULL; inventory = inventory->FindNextAssociate( manifest_key ) )
+	{
+	  pkgXmlNode *item = inventory->FindFirstAssociate( filename_key );
+	  for( ; item != NULL; item = item->FindNextAssociate( filename_key ) )
+	  {
+	    const char *pathname;
+	    if( (pathname = item->GetPropVal( pathname_key, NULL )) != NULL )
+	      Claim( pathname, tarname );
+	  }
+	}
+      }
+    }
+    ref = ref->FindNextAssociate( installed_key );
+  }
+  modified = true;
+}
+
+pkgOwnershipIndex *pkgOwnershipIndex::Open( pkgXmlNode *sysroot )
+{
+  /* Retrieve the index for the specified sysroot, loading it, (and
+   * rebuilding it, if necessary), on first reference.
+   */
+  const char *sysroot_id;
+  if( (sysroot == NULL) || ((sysroot_id = sysroot->GetPropVal( id_key, NULL )) == NULL) )
+    return NULL;
+
+  pkgOwnershipIndex *index = registry;
+  while( (index != NULL) && (strcmp( index->id, sysroot_id ) != 0) )
+    index = index->next;
+
+  if( index == NULL )
+  {
+    (index = new pkgOwnershipIndex( sysroot_id ))->Load();
+    if( ! index->Covers( sysroot ) )
+      index->Rebuild( sysroot );
+  }
+  return index;
+}
+
+void pkgOwnershipIndex::Commit()
+{
+  /* Save every registered index which has been modified.
+   */
+  for( pkgOwnershipIndex *index = registry; index != NULL; index = index->next )
+    if( index->modified && (index->Save() == 0) )
+      index->modified = false;
+}
+
+unsigned pkgOwnershipIndex::OwnerIndex( const char *tarname )
+{
+  /* Private helper, to retrieve the index of the owner table entry for
+   * a specified package, adding a new entry if there is none; (released
+   * packages leave vacant entries, which we may reuse).
+   */
+  unsigned index, vacant = owners;
+  for( index = 0; index < owners; index++ )
+  {
+    if( owner[index] == NULL )
+      vacant = index;
+    else if( pkg_strcmp( owner[index], tarname ) )
+      return index;
+  }
+  if( (vacant == owners) && (owners == owner_max) )
+  {
+    char **ref;
+    unsigned max = (owner_max > 0) ? owner_max << 1 : 64;
+    if( (ref = (char **)(realloc( owner, max * sizeof( char* ) ))) == NULL )
+      return owners;
+    owner = ref; owner_max = max;
+  }
+  if( vacant == owners )
+    ++owners;
+  owner[vacant] = strdup( tarname );
+  modified = true;
+  return vacant;
+}
+
+struct pkgOwnershipIndex::entry *pkgOwnershipIndex::Find( const char *pathname )
+{
+  /* Private helper, to locate the entry for a specified path name,
+   * in either the main table, or the pending table; both are sorted.
+   */
+  struct entry *ref = (struct entry *)(bsearch( &pathname, table, entries,
+	sizeof( struct entry ), owned_path_compare ));
+  if( ref == NULL )
+    ref = (struct entry *)(bsearch( &pathname, pending, pendings,
+	  sizeof( struct entry ), owned_path_compare ));
+  return ref;
+}
+
+void pkgOwnershipIndex::Merge()
+{
+  /* Private helper, to merge the pending table into the main table.
+   */
+  if( pendings == 0 )
+    return;
+
+  struct entry *merged;
+  unsigned max = entries + pendings + PKGOWNR_PENDING_MAX;
+  if( (merged = (struct entry *)(malloc( max * sizeof( struct entry ) ))) != NULL )
+  {
+    unsigned count = 0, from_table = 0, from_pending = 0;
+    while( (from_table < entries) || (from_pending < pendings) )
+      merged[count++] = ((from_pending == pendings) || ((from_table < entries)
+	    && (owned_path_strcmp( table[from_table].pathname,
+		pending[from_pending].pathname ) < 0)))
+	? table[from_table++] : pending[from_pending++];
+
+    free( (void *)(table) );
+    table = merged; entries = count; entry_max = max;
+    pendings = 0;
+  }
+}
+
+const char *pkgOwnershipIndex::Owner( const char *pathname )
+{
+  /* Identify the package which provides the specified file, (if any).
+   */
+  struct entry *ref = Find( pathname );
+  return (ref != NULL) ? owner[ref->owner] : NULL;
+}
+
+const char *pkgOwnershipIndex::Claim( const char *pathname, const char *tarname )
+{
+  /* Assign ownership of the specified file to the specified package;
+   * if the file was previously assigned to any other package, return
+   * the tarname of that other package, otherwise return NULL.
+   */
+  const char *prior = NULL;
+  unsigned index = OwnerIndex( tarname );
+  if( index == owners )
+    return NULL;
+
+  struct entry *ref;
+  if( (ref = Find( pathname )) != NULL )
+  {
+    if( ref->owner != index )
+    {
+      prior = owner[ref->owner];
+      ref->owner = index;
+      modified = true;
+    }
+    return prior;
+  }
+
+  /* The file has no prior owner; insert a new entry, in order, in the
+   * pending table, merging it into the main table when it is full.
+   */
+  if( pendings == PKGOWNR_PENDING_MAX )
+    Merge();
+  if( pending_max == 0 )
+  {
+    if( (pending = (struct entry *)(malloc( PKGOWNR_PENDING_MAX * sizeof( struct entry ) ))) == NULL )
+      return NULL;
+    pending_max = PKGOWNR_PENDING_MAX;
+  }
+  if( pendings < pending_max )
+  {
+    unsigned lo = 0, hi = pendings;
+    while( lo < hi )
+    {
+      unsigned mid = (lo + hi) >> 1;
+      if( owned_path_strcmp( pending[mid].pathname, pathname ) < 0 )
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+    memmove( pending + lo + 1, pending + lo, (pendings - lo) * sizeof( struct entry ) );
+    pending[lo].pathname = strdup( pathname );
+    pending[lo].owner = index;
+    ++pendings;
+    modified = true;
+  }
+  return NULL;
+}
+
+void pkgOwnershipIndex::Register( const char *tarname )
+{
+  /* Record that the specified package is installed, whether or not
+   * it provides any files.
+   */
+  OwnerIndex( tarname );
+}
+
+void pkgOwnershipIndex::Release( const char *tarname )
+{
+  /* Remove the specified package, and every entry which assigns file
+   * ownership to it, from the index.
+   */
+  unsigned index;
+  for( index = 0; index < owners; index++ )
+    if( (owner[index] != NULL) && pkg_strcmp( owner[index], tarname ) )
+      break;
+  if( index == owners )
+    return;
+
+  Merge();
+  unsigned count = 0;
+  for( unsigned ref = 0; ref < entries; ref++ )
+  {
+    if( table[ref].owner != index )
+      table[count++] = table[ref];
+    else if( ! InImage( table[ref].pathname ) )
+      free( (void *)(table[ref].pathname) );
+  }
+  entries = count;
+  free( (void *)(owner[index]) );
+  owner[index] = NULL;
+  modified = true;
+}
+
+int pkgOwnershipIndex::Save()
+{
+  /* Private helper, to write the index to its file; vacant owner table
+   * entries are elided, and the path table is renumbered accordingly.
+   * As for compact manifests, we write a temporary file, which we then
+   * move into place.  Returns zero on success, or -1 on failure.
+   */
+  Merge();
+  unsigned live = 0, renumber[owners + 1];
+  size_t pool_size = 0;
+  for( unsigned index = 0; index < owners; index++ )
+    if( owner[index] != NULL )
+    {
+      renumber[index] = live++;
+      pool_size += strlen( owner[index] ) + 1;
+    }
+  for( unsigned index = 0; index < entries; index++ )
+    pool_size += strlen( table[index].pathname ) + 1;
+  if( pool_size == 0 )
+    /*
+     * An empty pool is invalid, so we always store at least one byte.
+     */
+    pool_size = 1;
+
+  /* Assemble the complete file image in memory, so that we may then
+   * write it with a single call.
+   */
+  size_t size = sizeof( struct pkgOwnershipIndexHeader ) + pool_size
+    + live * sizeof( uint32_t ) + entries * sizeof( struct pkgOwnershipIndexRecord );
+  char *buf;
+  if( (buf = (char *)(malloc( size ))) == NULL )
+    return -1;
+
+  struct pkgOwnershipIndexHeader *header = (struct pkgOwnershipIndexHeader *)(buf);
+  memcpy( header->magic, PKGOWNR_MAGIC, sizeof( header->magic ) );
+  header->version = PKGOWNR_VERSION;
+  header->owners = live; header->entries = entries; header->pool_size = pool_size;
+
+  uint32_t *owner_ref = (uint32_t *)(header + 1), offset = 0;
+  struct pkgOwnershipIndexRecord *record
+    = (struct pkgOwnershipIndexRecord *)(owner_ref + live);
+  char *pool = (char *)(record + entries); *pool = '\0';
+  for( unsigned index = 0; index < owners; index++ )
+    if( owner[index] != NULL )
+    {
+      size_t len = strlen( owner[index] ) + 1;
+      memcpy( pool + (owner_ref[renumber[index]] = offset), owner[index], len );
+      offset += len;
+    }
+  for( unsigned index = 0; index < entries; index++ )
+  {
+    size_t len = strlen( table[index].pathname ) + 1;
+    memcpy( pool + (record[index].pathname = offset), table[index].pathname, len );
+    record[index].owner = renumber[table[index].owner];
+    offset += len;
+  }
+
+  int fd, status = -1;
+  const char *filename = ownership_index_file( id );
+  char tmpfile[5 + strlen( filename )]; sprintf( tmpfile, "%s.tmp", filename );
+  if( (fd = set_output_stream( tmpfile, 0644 )) >= 0 )
+  {
+    bool written = write( fd, buf, size ) == (int)(size);
+    close( fd );
+
+    if( written
+    &&  MoveFileEx( tmpfile, filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+      status = 0;
+    else
+      /* We failed to write the complete file; don't leave
+       * an incomplete copy in place.
+       */
+      unlink( tmpfile );
+  }
+  free( (void *)(filename) );
+  free( (void *)(buf) );
+  return status;
+}
+
+static inline bool is_dirsep( int c ){ return (c == '/') || (c == '\\'); }
+
+static const char *sysroot_relative_path( const char *sysroot, const char *pathname )
+{
+  /* Helper for the "owner" action; if "pathname" (which is canonical)
+   * lies within the specified "sysroot" directory, return a pointer to
+   * the path name relative to "sysroot", otherwise return NULL.  Case,
+   * any distinction between '/' and '\' as directory separators, and
+   * any repetition of separators, are ignored.
+   */
+  while( *sysroot )
+  {
+    if( is_dirsep( *sysroot ) )
+    {
+      /* Any sequence of separators in the sysroot path name matches
+       * any such sequence in the file path name, or its end.
+       */
+      if( ! is_dirsep( *pathname ) )
+      {
+	while( is_dirsep( *sysroot ) ) ++sysroot;
+	return ((*sysroot == '\0') && (*pathname == '\0')) ? pathname : NULL;
+      }
+      while( is_dirsep( *sysroot ) ) ++sysroot;
+      while( is_dirsep( *pathname ) ) ++pathname;
+    }
+    else if( tolower( *sysroot++ ) != tolower( *pathname++ ) )
+      return NULL;
+  }
+  /* When the sysroot path name has no trailing separator, the file path
+   * name must have one at this point, if it lies within the sysroot.
+   */
+  if( ! is_dirsep( pathname[-1] ) && (*pathname != '\0') && ! is_dirsep( *pathname ) )
+    return NULL;
+  while( is_dirsep( *pathname ) )
+    ++pathname;
+  return pathname;
+}
+
+void pkgXmlDocument::DisplayFileOwners( int argc, char **argv )
+{
+  /* Implementation of the "owner" action; identify the installed
+   * package which provides each file named on the command line.
+   */
+  while( --argc )
+  {
+    const char *owner = NULL;
+    char canonical[PATH_MAX];
+    if( _fullpath( canonical, *++argv, PATH_MAX ) == NULL )
+    {
+      dmh_notify( DMH_ERROR, "%s: invalid path name\n", *argv );
+      continue;
+    }
+
+    /* Consider each sysroot in turn, until we find one which contains
+     * the file, and which identifies its owner.
+     */
+    pkgXmlNode *sysroot = GetRoot()->FindFirstAssociate( sysroot_key );
+    while( (owner == NULL) && (sysroot != NULL) )
+    {
+      const char *prefix;
+      if( (prefix = sysroot->GetPropVal( pathname_key, NULL )) != NULL )
+      {
+	/* Resolve the sysroot path name, as the installer does, and
+	 * reduce the specified file path name to be relative to it;
+	 * (the index stores '/' as the directory separator).
+	 */
+	const char *template_format = "%F%%/M/%%F";
+	char template_text[mkpath( NULL, template_format, prefix, NULL )];
+	mkpath( template_text, template_format, prefix, NULL );
+	char syspath[mkpath( NULL, template_text, "", NULL )];
+	mkpath( syspath, template_text, "", NULL );
+
+	char sysroot_dir[PATH_MAX];
+	const char *refname = (_fullpath( sysroot_dir, syspath, PATH_MAX ) != NULL)
+	  ? sysroot_relative_path( sysroot_dir, canonical ) : NULL;
+
+	pkgOwnershipIndex *index;
+	if( (refname != NULL) && (*refname != '\0')
+	&&  ((index = pkgOwnershipIndex::Open( sysroot )) != NULL)  )
+	{
+	  char lookup[1 + strlen( refname )];
+	  for( char *p = strcpy( lookup, refname ); *p; p++ )
+	    if( *p == '\\' ) *p = '/';
+	  owner = index->Owner( lookup );
+	}
+      }
+      sysroot = sysroot->FindNextAssociate( sysroot_key );
+    }
+    if( owner != NULL )
+      dmh_printf( "%s: %s\n", *argv, owner );
+    else
+      dmh_notify( DMH_INFO, "%s: not provided by any installed package\n", *argv );
+  }
+  /* Any index which we had to rebuild, in order to answer the query,
+   * (including the manifest index, which may have been rebuilt as the
+   * manifests were located), should be saved, so that we need not
+   * rebuild it again.
+   */
+  pkgOwnershipIndex::Commit();
+  pkgManifest::CommitIndex();
+}
+
+/* $RCSfile: pkgownr.cpp,v $: end of file */
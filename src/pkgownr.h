@@ -0,0 +1,105 @@
+#ifndef PKGOWNR_H
+/*
+ * pkgownr.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Declaration of the pkgOwnershipIndex class, which maps the path name
+ * of each file installed within a sysroot, to the tarname of the package
+ * which provides it.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define PKGOWNR_H  1
+
+#include <stddef.h>
+
+#include "pkgbase.h"
+
+class pkgOwnershipIndex
+{
+  /* A class to maintain the reverse mapping, from installed file path
+   * names, (relative to the sysroot, as they are recorded in manifests),
+   * to the tarnames of the packages which provide them; there is one
+   * such index for each sysroot, kept in a binary file alongside the
+   * sysroot record itself, and loaded on first reference.  Each index
+   * also records the set of packages which it covers; if this does not
+   * match the installation records for the sysroot, (e.g. because some
+   * other tool has changed the installation), the index is rebuilt from
+   * the manifests for all installed packages.  Path names are held in a
+   * sorted table, for look-up by binary search; new entries are sorted
+   * into a separate, smaller table, which is periodically merged into
+   * the main table, to avoid repeatedly shifting the latter.
+   */
+  public:
+    /* Access to the index, if any, for a specified sysroot record, and
+     * a method to commit all indexes which have been modified; (this is
+     * called when the system map is updated, thus keeping each index in
+     * step with the installation records in its sysroot).
+     */
+    static pkgOwnershipIndex *Open( pkgXmlNode* );
+    static void Commit();
+
+    /* Methods to identify the owner of a file, to assign ownership of a
+     * file, (returning the prior owner, if any, when it differs), and to
+     * register, or release, a package as a whole.
+     */
+    const char *Owner( const char* );
+    const char *Claim( const char*, const char* );
+    void Register( const char* );
+    void Release( const char* );
+
+  private:
+    pkgOwnershipIndex( const char* );
+    ~pkgOwnershipIndex();
+
+    struct entry
+    {
+      const char *pathname;
+      unsigned    owner;
+    } *table, *pending;
+    unsigned entries, entry_max, pendings, pending_max;
+
+    char **owner;
+    unsigned owners, owner_max;
+
+    char *id, *image;
+    size_t image_size;
+    bool modified;
+
+    pkgOwnershipIndex *next;
+    static pkgOwnershipIndex *registry;
+
+    inline bool InImage( const char *ref )
+    {
+      return (ref >= image) && (ref < image + image_size);
+    }
+
+    void Load();
+    void Discard();
+    bool Covers( pkgXmlNode* );
+    void Rebuild( pkgXmlNode* );
+    void Merge();
+    int Save();
+
+    unsigned OwnerIndex( const char* );
+    struct entry *Find( const char* );
+};
+
+#endif /* PKGOWNR_H: $RCSfile: pkgownr.h,v $: end of file */
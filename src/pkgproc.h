@@ -35,6 +35,10 @@
 EXTERN_C void pkgInstall( pkgActionItem* );
 EXTERN_C void pkgRegister( pkgXmlNode*, pkgXmlNode*, const char*, const char* );
 EXTERN_C void pkgRemove( pkgActionItem* );
+EXTERN_C void pkgExportSysRoot( const char* );
+
+class pkgCompactManifest;
+class pkgOwnershipIndex;
 
 class pkgManifest
 {
@@ -46,15 +50,116 @@ class pkgManifest
     ~pkgManifest();
 
     void AddEntry( const char*, const char* );
+    void AddEntry( const char*, const char*, uint64_t, time_t, uint32_t );
     void BindSysRoot( pkgXmlNode*, const char* );
     void DetachSysRoot( const char* );
 
+    /* Commit outstanding changes to the index, which maps package
+     * tarnames to the hashed names of their manifests.
+     */
+    static void CommitIndex();
+
     inline pkgXmlNode *GetRoot(){ return manifest->GetRoot(); }
     pkgXmlNode *GetSysRootReference( const char* );
 
+    /* When the content inventory is recorded in compact form, rather
+     * than within the XML manifest itself, this provides access to it;
+     * otherwise, it returns NULL.
+     */
+    pkgCompactManifest *GetCompactInventory();
+
   private:
     pkgXmlDocument *manifest;
     pkgXmlNode     *inventory;
+    pkgCompactManifest *compact;
+
+    void CommitInventory( const char* );
+};
+
+class pkgRetainedInventory
+{
+  /* The inventory of files from a prior installation of a package,
+   * which are retained on disk when that installation is removed in
+   * preparation for its replacement, (by reinstallation or upgrade);
+   * the installer claims each which the replacement also provides,
+   * overwriting it in place, (or leaving it untouched, if it is to be
+   * skipped when unchanged).  When the inventory is deleted, all
+   * unclaimed files are removed, and any directories which become
+   * empty are pruned, thus completing the removal.
+   */
+  public:
+    pkgRetainedInventory( pkgXmlNode*, const char* );
+    pkgRetainedInventory( pkgCompactManifest*, const char* );
+    ~pkgRetainedInventory();
+
+    bool Claim( const char*, const char*, uint64_t, time_t, const uint32_t* );
+
+    /* When files recorded in the inventory have since been overwritten
+     * by another package, they must not be removed; this identifies, and
+     * retains them, given the file ownership index, and the tarname of
+     * the package to which the inventory belongs, (or NULL, after that
+     * package has released its claims, to retain every file which now
+     * has any owner).
+     */
+    void Exempt( pkgOwnershipIndex*, const char* );
+
+    /* Method to complete the removal of a collection of inventories,
+     * in a single sweep, (deleting the union of their unclaimed files,
+     * and then pruning the union of their directories); each of them
+     * may then be deleted, without further effect on the file system.
+     */
+    static void Purge( pkgRetainedInventory**, unsigned );
+
+  private:
+    struct entry
+    {
+      char	*pathname;
+      uint64_t	 size;
+      time_t	 mtime;
+      uint32_t	 checksum;
+      int	 flags;
+    } *file;
+    unsigned files;
+
+    char **dir;
+    unsigned dirs;
+
+    char *syspath, *pool;
+    bool sorted, purged;
+};
+
+class pkgRemovalBatch
+{
+  /* A class to collect the removals which are scheduled, within any
+   * single pass over the list of action items, so that the file system
+   * effects of all of them may be completed together; (the installation
+   * records for each package are still updated individually, as each is
+   * removed).  While any such batch is in scope, it is the active batch,
+   * to which pkgRemove() defers the inventory, and post-remove script,
+   * of each package which is removed outright, and the installer defers
+   * any residue of each prior installation which it replaces.
+   */
+  public:
+    pkgRemovalBatch();
+    ~pkgRemovalBatch();
+
+    static inline pkgRemovalBatch *Active(){ return active; }
+
+    void Defer( pkgRetainedInventory*, pkgOwnershipIndex*, pkgXmlNode*, const char* );
+    void Complete();
+
+  private:
+    struct deferral
+    {
+      pkgRetainedInventory	*inventory;
+      pkgOwnershipIndex		*owners;
+      pkgXmlNode		*package;
+      const char		*sysroot_path;
+    } *item;
+    unsigned items, item_max;
+
+    pkgRemovalBatch *prior;
+    static pkgRemovalBatch *active;
 };
 
 class pkgArchiveProcessor
@@ -89,6 +194,11 @@ class pkgArchiveProcessor
     virtual int ExtractFile( int, const char*, int );
 };
 
+/* Opaque reference to the pipeline of writer threads, to which the
+ * tar archive processor may delegate the extraction of file data.
+ */
+class pkgExtractionPipeline;
+
 /* Our standard package format specifies the use of tar archives;
  * the following specialisation of pkgArchiveProcessor provides the
  * tools we need for processing such archives.
@@ -149,8 +259,8 @@ class pkgTarArchiveProcessor : public pkgArchiveProcessor
   public:
     /* Constructors and destructor...
      */
-    pkgTarArchiveProcessor(){}
-    pkgTarArchiveProcessor( pkgXmlNode* );
+    pkgTarArchiveProcessor():writer( NULL ), retained( NULL ){}
+    pkgTarArchiveProcessor( pkgXmlNode*, pkgArchiveStream* = NULL );
     virtual ~pkgTarArchiveProcessor();
 
     inline bool IsOk(){ return stream->IsReady(); }
@@ -161,15 +271,28 @@ class pkgTarArchiveProcessor : public pkgArchiveProcessor
      */
     pkgArchiveStream *stream;
     union tar_archive_header header;
+    pkgExtractionPipeline *writer;
+    pkgRetainedInventory *retained;
 
     /* Internal archive processing methods...
      * These are divided into two categories: those for which the
      * abstract base class furnishes a generic implementation...
      */
     virtual int GetArchiveEntry();
-    virtual int ProcessEntityData( int );
+    virtual int ProcessEntityData( int, uint32_t* = NULL );
     virtual char *EntityDataAsString();
 
+    /* ...helpers for extraction of regular files, which may be
+     * delegated to the writer pipeline, and for recording entries
+     * in the installation manifest, in archive order, regardless of
+     * the order in which such delegated extractions complete...
+     */
+    int ExtractDataStream( const char*, const char* );
+    void RecordEntry( const char*, const char* );
+    void RecordEntry( const char*, const char*, uint64_t, time_t, uint32_t );
+
+    void FlushExtractedEntities();
+
     /* ...those for which each specialisation is expected to
      * furnish its own task specific implementation...
      */
@@ -206,12 +329,19 @@ class pkgTarArchiveInstaller : public pkgTarArchiveProcessor
   public:
     /* Constructor and destructor...
      */
-    pkgTarArchiveInstaller( pkgXmlNode* );
-    virtual ~pkgTarArchiveInstaller(){}
+    pkgTarArchiveInstaller
+      ( pkgXmlNode*, pkgArchiveStream* = NULL, pkgRetainedInventory* = NULL );
+    virtual ~pkgTarArchiveInstaller();
 
     virtual int Process();
 
   private:
+    /* The file ownership index for the sysroot, in which we record
+     * each file which we install, and detect any which conflict with
+     * files provided by other installed packages.
+     */
+    pkgOwnershipIndex *owners;
+
     /* Specialised implementations of the archive processing methods...
      */
     virtual int ProcessDirectory( const char* );
@@ -16,6 +16,7 @@
  *   bzip2  (compressed)
  *   lzma   (compressed)
  *   xz     (compressed)
+ *   zstd   (compressed)
  *
  *
  * This is free software.  Permission is granted to copy, modify and
@@ -34,6 +35,7 @@
  */
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
 
 #ifndef O_BINARY
 /*
@@ -55,6 +57,7 @@
  */
 #define  PKGSTRM_H_SPECIAL  1
 #include "pkgstrm.h"
+#include "pkgopts.h"
 
 /*****
  *
@@ -73,10 +76,13 @@ int pkgArchiveStream::GetRawData( int fd, uint8_t *buf, size_t max )
 {
   /* Generic helper function for reading a compressed data stream into
    * its decompressing filter's input buffer.  The default implementation
-   * assumes a file stream, and simply invokes a read() request; however,
-   * we segregate this function, to facilitate an override to handle
-   * other input streaming capabilities.
+   * assumes a file stream, and simply invokes a read() request, unless
+   * a source stream has been attached, in which case we read from that;
+   * however, we segregate this function, to facilitate an override to
+   * handle other input streaming capabilities.
    */
+  if( source != NULL )
+    return source->Read( (char *)(buf), max );
   return read( fd, buf, max );
 }
 
@@ -96,11 +102,14 @@ pkgRawArchiveStream::pkgRawArchiveStream( const char *filename )
   fd = open( filename, O_RDONLY | O_BINARY );
 }
 
+pkgRawArchiveStream::pkgRawArchiveStream( int fileno ):fd( fileno ){}
+
 pkgRawArchiveStream::~pkgRawArchiveStream()
 {
   /* The destructor needs only to close the data stream.
    */
-  close( fd );
+  if( fd >= 0 )
+    close( fd );
 }
 
 int pkgRawArchiveStream::Read( char *buf, size_t max )
@@ -108,7 +117,7 @@ int pkgRawArchiveStream::Read( char *buf, size_t max )
   /* While the stream reader simply transfers the requested number
    * of bytes from the stream, to the caller's buffer.
    */
-  return read( fd, buf, max );
+  return GetRawData( fd, (uint8_t *)(buf), max );
 }
 
 /*****
@@ -117,33 +126,139 @@ int pkgRawArchiveStream::Read( char *buf, size_t max )
  *
  * This class creates an input streaming interface, suitable for
  * reading archives which have been stored with gzip compression.
- * The implementation is based on the use of libz.a, which allows
- * for a similar implementation to that of pkgRawArchiveStream.
+ * The implementation is based on the use of libz.a; rather than
+ * using its gzread() interface, which can read only from a file,
+ * we drive the inflate() decoder directly, in the same fashion
+ * as the lzma and xz decoders below, so that the compressed data
+ * may be delivered by GetRawData(), from any source.
  *
  */
+static
+void gzip_stream_initialise( z_stream *stream, int *status )
+{
+  /* This simple helper establishes the initial state for the inflate()
+   * decoder; (a window size of 15 + 32 directs it to accept either the
+   * gzip or the zlib format, with automatic detection of the header).
+   */
+  stream->zalloc = Z_NULL;
+  stream->zfree = Z_NULL;
+  stream->opaque = Z_NULL;
+  stream->next_in = Z_NULL;
+  stream->avail_in = 0;
+  *status = inflateInit2( stream, 15 + 32 );
+}
+
 pkgGzipArchiveStream::pkgGzipArchiveStream( const char *filename )
 {
-  /* Once more, the constructor has little to do but open the stream;
-   * in this case, the method is analogous to C's fopen().
+  /* The constructor must first open a file stream...
+   */
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the inflate() decoder.
+     */
+    gzip_stream_initialise( &stream, &status );
+}
+
+pkgGzipArchiveStream::pkgGzipArchiveStream( int fileno ):fd( fileno )
+{
+  /* When we are given an existing stream, we need only set up
+   * the inflate() decoder.
    */
-  stream = gzopen( filename, "rb" );
+  if( fd != -1 )
+    gzip_stream_initialise( &stream, &status );
 }
 
 pkgGzipArchiveStream::~pkgGzipArchiveStream()
 {
-  /* Another destructor, with little to do but close the stream; the
-   * gzclose() call suffices for the purpose.
+  /* The destructor frees memory resources allocated to the decoder,
+   * and closes the input stream file descriptor.
    */
-  gzclose( stream );
+  if( fd != -1 )
+  {
+    inflateEnd( &stream );
+    if( fd >= 0 )
+      close( fd );
+  }
 }
 
 int pkgGzipArchiveStream::Read( char *buf, size_t max )
 {
-  /* The reader is again served by a single function call, to transfer
-   * the requested volume of decompressed data from the raw input file
-   * to the caller's buffer.
+  /* Read a gzip compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( fd == -1 )
+    /*
+     * We cannot read from a stream with an invalid descriptor;
+     * in this circumstance, just say "nothing was read"...
+     */
+    return fd;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
+   */
+  stream.next_out = (Bytef *)(buf);
+  stream.avail_out = max;
+
+  while( (stream.avail_out > 0) && (status == Z_OK) )
+  {
+    /* "buf" hasn't been filled yet, and the decoder continues to say
+     * that more data may be available; top up the raw input buffer,
+     * if we have exhausted its current content...
+     */
+    if( stream.avail_in == 0 )
+    {
+      int count = GetRawData( fd, streambuf, BUFSIZ );
+      if( count < 0 )
+	/*
+	 * ...diagnosing any I/O error as a failed read...
+	 */
+	return -1;
+
+      /* ...but, if there is nothing more to be had, we leave the input
+       * buffer empty; the decoder may still hold data which it has not
+       * yet delivered, so we run it once more, and if it then reports
+       * that it can make no further progress, short of the end of the
+       * compressed stream, the stream has been truncated.
+       */
+      stream.next_in = streambuf;
+      stream.avail_in = count;
+    }
+
+    /* Run the decoder, to decompress as much as possible of the data
+     * currently in the raw input buffer, filling available space in
+     * "buf"...
+     */
+    if( (status = inflate( &stream, Z_NO_FLUSH )) == Z_STREAM_END )
+    {
+      /* ...but note that gzip permits any number of compressed members
+       * to be concatenated, and expects them to be decompressed as one;
+       * when we reach the end of any one of them, we must check for any
+       * remaining input, and if there is any, restart the decoder.
+       */
+      if( stream.avail_in == 0 )
+      {
+	int count = GetRawData( fd, streambuf, BUFSIZ );
+	if( count < 0 )
+	  return -1;
+
+	stream.next_in = streambuf;
+	stream.avail_in = count;
+      }
+      if( stream.avail_in > 0 )
+	status = inflateReset( &stream );
+    }
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * reached the end of the compressed stream, (in which case we return
+   * the actual number of bytes stored in "buf", i.e. its total size,
+   * less any residual free space); otherwise the decoder reported an
+   * error, (including Z_BUF_ERROR, when the raw input stream ended
+   * before the compressed stream), and we return -1.
    */
-  return gzread( stream, buf, max );
+  return ((status == Z_OK) || (status == Z_STREAM_END))
+    ? max - stream.avail_out : -1;
 }
 
 /*****
@@ -152,37 +267,155 @@ int pkgGzipArchiveStream::Read( char *buf, size_t max )
  *
  * This class creates an input streaming interface, suitable for
  * reading archives which have been stored with bzip2 compression.
- * The implementation is based on the use of libbz2.a, which again
- * allows for a fairly simple implementation, which is also quite
- * analogous to that of pkgRawArchiveStream.
+ * The implementation is based on the use of libbz2.a; once again,
+ * we use the low level BZ2_bzDecompress() interface, rather than
+ * BZ2_bzRead(), (which can read only from a file), so that the
+ * compressed data may be delivered by GetRawData().
  *
  */
+static
+void bzip_stream_initialise( bz_stream *stream, int *status )
+{
+  /* This simple helper establishes the initial state for the bzip2
+   * decoder, with default memory allocation, and marks its input
+   * buffer as initially empty.
+   */
+  stream->bzalloc = NULL;
+  stream->bzfree = NULL;
+  stream->opaque = NULL;
+  stream->next_in = NULL;
+  stream->avail_in = 0;
+  *status = BZ2_bzDecompressInit( stream, 0, 0 );
+}
+
 pkgBzipArchiveStream::pkgBzipArchiveStream( const char *filename )
 {
-  /* The constructor carries a marginal additional overhead, in
-   * that it must first open a regular file, before associating
-   * a bzip2 control structure with it; subsequent stream access
-   * is directed exclusively through that control structure.
+  /* The constructor must first open a file stream...
    */
-  FILE *streamfile = fopen( filename, "rb" );
-  stream = BZ2_bzReadOpen( &bzerror, streamfile, 0, 0, 0, 0 );
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the bzip2 decoder.
+     */
+    bzip_stream_initialise( &stream, &status );
+}
+
+pkgBzipArchiveStream::pkgBzipArchiveStream( int fileno ):fd( fileno )
+{
+  /* When we are given an existing stream, we need only set up
+   * the bzip2 decoder.
+   */
+  if( fd != -1 )
+    bzip_stream_initialise( &stream, &status );
 }
 
 pkgBzipArchiveStream::~pkgBzipArchiveStream()
 {
-  /* For the destructor, it is again just a matter of closing
-   * the bzip2 stream; (this also takes care of closing the
-   * associated file stream).
+  /* The destructor frees memory resources allocated to the decoder,
+   * and closes the input stream file descriptor.
    */
-  BZ2_bzReadClose( &bzerror, stream );
+  if( fd != -1 )
+  {
+    BZ2_bzDecompressEnd( &stream );
+    if( fd >= 0 )
+      close( fd );
+  }
 }
 
 int pkgBzipArchiveStream::Read( char *buf, size_t max )
 {
-  /* Once again, reading is a simple matter of transferring
-   * the requisite number of bytes to the caller's buffer.
+  /* Read a bzip2 compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( fd == -1 )
+    /*
+     * We cannot read from a stream with an invalid descriptor;
+     * in this circumstance, just say "nothing was read"...
+     */
+    return fd;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
    */
-  return BZ2_bzRead( &bzerror, stream, buf, max );
+  stream.next_out = buf;
+  stream.avail_out = max;
+
+  while( (stream.avail_out > 0) && (status == BZ_OK) )
+  {
+    /* "buf" hasn't been filled yet, and the decoder continues to say
+     * that more data may be available; top up the raw input buffer,
+     * if we have exhausted its current content...
+     */
+    if( stream.avail_in == 0 )
+    {
+      int count = GetRawData( fd, streambuf, BUFSIZ );
+      if( count < 0 )
+	/*
+	 * ...diagnosing any I/O error as a failed read...
+	 */
+	return -1;
+
+      /* ...but, if there is nothing more to be had, we leave the input
+       * buffer empty; the decoder may still hold data which it has not
+       * yet delivered, so we run it once more, and if it then reports
+       * that it can make no further progress, short of the end of the
+       * compressed stream, the stream has been truncated.
+       */
+      stream.next_in = (char *)(streambuf);
+      stream.avail_in = count;
+    }
+
+    /* Run the decoder, to decompress as much as possible of the data
+     * currently in the raw input buffer, filling available space in
+     * "buf"...
+     */
+    unsigned int fed = stream.avail_in, room = stream.avail_out;
+    if( (status = BZ2_bzDecompress( &stream )) == BZ_STREAM_END )
+    {
+      /* ...but, as in the gzip case, archives may comprise several
+       * concatenated bzip2 streams, (as produced by parallel encoders);
+       * when we reach the end of one, we must restart the decoder, if
+       * there is any further input.
+       */
+      if( stream.avail_in == 0 )
+      {
+	int count = GetRawData( fd, streambuf, BUFSIZ );
+	if( count < 0 )
+	  return -1;
+
+	stream.next_in = (char *)(streambuf);
+	stream.avail_in = count;
+      }
+      if( stream.avail_in > 0 )
+      {
+	/* Restarting the decoder discards its buffer references; we
+	 * must preserve them, and restore them afterwards.
+	 */
+	bz_stream state = stream;
+	BZ2_bzDecompressEnd( &stream );
+	bzip_stream_initialise( &stream, &status );
+	stream.next_in = state.next_in; stream.avail_in = state.avail_in;
+	stream.next_out = state.next_out; stream.avail_out = state.avail_out;
+      }
+    }
+    else if( (status == BZ_OK) && (fed == 0) && (stream.avail_out == room) )
+      /*
+       * ...whereas, unlike inflate(), BZ2_bzDecompress() doesn't itself
+       * report a failure to make progress; when it has no input, and it
+       * delivers no more output, the stream has been truncated.
+       */
+      status = BZ_UNEXPECTED_EOF;
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * reached the end of the compressed stream, (in which case we return
+   * the actual number of bytes stored in "buf", i.e. its total size,
+   * less any residual free space); otherwise the decoder reported an
+   * error, or the raw input stream ended before the compressed stream,
+   * and we return -1.
+   */
+  return ((status == BZ_OK) || (status == BZ_STREAM_END))
+    ? max - stream.avail_out : -1;
 }
 
 /*****
@@ -199,13 +432,19 @@ int pkgBzipArchiveStream::Read( char *buf, size_t max )
 static inline
 uint64_t memlimit()
 {
-  /* Naively cap the memory available to lzma and xz decoders.
-   *
-   * FIXME: libarchive appears to use this; however, Lasse Collin
-   * provides a more sophisticated method for xz, based on actual
-   * physical memory footprint; we should adopt it.
+  /* Cap the memory available to lzma and xz decoders; the user may
+   * specify this limit, in MiB, by the "--xz-memlimit" option, or the
+   * equivalent profile preference.  Otherwise, as xz itself does, we
+   * impose no hard limit; (for xz, the multithreaded decoder adopts a
+   * separate, and more conservative, limit on its thread count).
    */
-  return 1ULL << 23 + 1ULL << 21;
+  pkgOpts *opts = pkgOptions();
+  if( opts->IsSet( OPTION_XZ_MEMLIMIT ) )
+  {
+    uint64_t limit = opts->GetValue( OPTION_XZ_MEMLIMIT );
+    if( limit > 0 ) return limit << 20;
+  }
+  return ~(uint64_t)(0);
 }
 
 static
@@ -261,7 +500,8 @@ pkgLzmaArchiveStream::~pkgLzmaArchiveStream()
   if( fd != -1 )
   {
     lzma_end( &stream );
-    close( fd );
+    if( fd >= 0 )
+      close( fd );
   }
 }
 
@@ -329,6 +569,66 @@ int pkgLzmaArchiveStream::Read( char *buf, size_t max )
  * use as an xz decompressor.
  *
  */
+#if LZMA_VERSION >= 50040002
+/* When liblzma is sufficiently recent to provide it, we may use its
+ * multithreaded decoder for xz streams.
+ */
+static inline
+uint32_t xz_threads()
+{
+  /* Determine how many threads the xz decoder may use; the user may
+   * specify this, by the "--xz-threads" option, or the equivalent
+   * profile preference; otherwise, we use one for each processor.
+   */
+  pkgOpts *opts = pkgOptions();
+  return opts->IsSet( OPTION_XZ_THREADS )
+    ? opts->GetValue( OPTION_XZ_THREADS ) : lzma_cputhreads();
+}
+#endif
+
+static
+int xz_stream_initialise( lzma_stream *stream )
+{
+  /* Helper to set up the decoder for an xz stream, in its initial state.
+   */
+  lzma_stream_initialise( stream );
+
+# if LZMA_VERSION >= 50040002
+  /* When more than one thread is available, we prefer the multithreaded
+   * decoder; this decodes independent blocks in parallel, when the archive
+   * has been compressed in multiple blocks, (as "xz -T0" does), but it
+   * otherwise simply falls back to decoding in a single thread.
+   */
+  uint32_t threads = xz_threads();
+  if( threads > 1 )
+  {
+    lzma_mt mt; memset( &mt, 0, sizeof( mt ) );
+    mt.flags = LZMA_CONCATENATED;
+    mt.threads = threads;
+
+    /* The hard memory limit applies to the decoder as a whole; as xz
+     * itself does, we reduce the thread count, if necessary, to keep
+     * within a quarter of physical memory, (or the hard limit, if it
+     * is lower).
+     */
+    mt.memlimit_stop = memlimit();
+    if( (mt.memlimit_threading = lzma_physmem() / 4) == 0 )
+      mt.memlimit_threading = mt.memlimit_stop;
+
+    /* Should liblzma reject this configuration, (e.g. because the user
+     * requested an excessive number of threads), we simply fall back to
+     * the single-threaded decoder.
+     */
+    if( lzma_stream_decoder_mt( stream, &mt ) == LZMA_OK )
+      return LZMA_OK;
+  }
+# endif
+  /* Either multithreading is unsupported, or only a single thread is
+   * available; use the conventional single-threaded decoder.
+   */
+  return lzma_stream_decoder( stream, memlimit(), LZMA_CONCATENATED );
+}
+
 pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
 {
   /* The constructor must first open a file stream...
@@ -338,8 +638,7 @@ pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
     /* ...then set up the lzma decoder, in appropriately
      * initialised state...
      */
-    lzma_stream_initialise( &stream );
-    status = lzma_stream_decoder( &stream, memlimit(), LZMA_CONCATENATED );
+    status = xz_stream_initialise( &stream );
 
     /* Finally, recognising that with LZMA_CONCATENATED data,
      * we will eventually need to switch the decoder from its
@@ -351,6 +650,18 @@ pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
   }
 }
 
+pkgXzArchiveStream::pkgXzArchiveStream( int fileno ):fd( fileno )
+{
+  /* ...then set up the lzma decoder, in appropriately
+   * initialised state...
+   */
+  if( fd != -1 )
+  {
+    status = xz_stream_initialise( &stream );
+    opmode = LZMA_RUN;
+  }
+}
+
 pkgXzArchiveStream::~pkgXzArchiveStream()
 {
   /* This destructor frees memory resources allocated to the decoder,
@@ -361,7 +672,8 @@ pkgXzArchiveStream::~pkgXzArchiveStream()
   if( fd != -1 )
   {
     lzma_end( &stream );
-    close( fd );
+    if( fd >= 0 )
+      close( fd );
   }
 }
 
@@ -389,19 +701,21 @@ int pkgXzArchiveStream::Read( char *buf, size_t max )
     /* "buf" hasn't been filled yet, and the decoder continues to say
      * that more data may be available.
      */
-    if( stream.avail_in == 0 )
+    if( (stream.avail_in == 0) && (opmode == LZMA_RUN) )
     {
       /* We exhausted the current content of the raw input buffer;
-       * top it up again.
+       * top it up again, (unless we already reached end-of-input).
        */
+      int count;
       stream.next_in = streambuf;
-      if( (stream.avail_in = GetRawData( fd, streambuf, BUFSIZ )) < 0 )
+      if( (count = GetRawData( fd, streambuf, sizeof( streambuf ) )) < 0 )
       {
 	/* FIXME: an I/O error occurred here: need to handle it!!!
 	 */
+	count = 0;
       }
 
-      else if( stream.avail_in < BUFSIZ )
+      if( (stream.avail_in = count) < sizeof( streambuf ) )
       {
 	/* A short read indicates end-of-input...
 	 * Unlike the case of the lzma_alone_decoder, (as used for
@@ -423,14 +737,12 @@ int pkgXzArchiveStream::Read( char *buf, size_t max )
     status = lzma_code( &stream, opmode );
 
     /* We need to go round again, in case we exhausted the raw input
-     * data before we ran out of available space in "buf", except...
+     * data before we ran out of available space in "buf"; note that
+     * this remains necessary, even after we've switched to LZMA_FINISH
+     * mode, since the multithreaded decoder may return LZMA_OK while
+     * its worker threads have yet to deliver all pending output, and
+     * a short read would be mistaken for end-of-stream.
      */
-    if( (status == LZMA_OK) && (opmode == LZMA_FINISH) )
-      /*
-       * ...when we've already achieved the LZMA_FINISH state,
-       * this becomes unnecessary, so we break the cycle.
-       */
-      break;
   }
 
   /* When we get to here, we either filled "buf" completely, or we
@@ -441,6 +753,137 @@ int pkgXzArchiveStream::Read( char *buf, size_t max )
   return max - stream.avail_out;
 }
 
+/*****
+ *
+ * Class Implementation: pkgZstdArchiveStream
+ *
+ * This class creates an input streaming interface, suitable for
+ * reading archives which have been stored with zstd compression;
+ * it is based on the use of libzstd.a, which offers much faster
+ * decompression than liblzma.a, for comparable compression ratios.
+ *
+ */
+static
+size_t zstd_stream_initialise( ZSTD_DStream **stream, ZSTD_inBuffer *input )
+{
+  /* This simple helper creates the zstd decoder, and marks its input
+   * buffer as initially empty; it returns the decoder's initial status,
+   * (or an error code, if the decoder could not be created).
+   */
+  input->src = NULL;
+  input->size = input->pos = 0;
+  if( (*stream = ZSTD_createDStream()) == NULL )
+    return (size_t)(-1);
+  return ZSTD_initDStream( *stream );
+}
+
+pkgZstdArchiveStream::pkgZstdArchiveStream( const char *filename )
+{
+  /* The constructor must first open a file stream...
+   */
+  stream = NULL;
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the zstd decoder.
+     */
+    status = zstd_stream_initialise( &stream, &input );
+}
+
+pkgZstdArchiveStream::pkgZstdArchiveStream( int fileno ):fd( fileno )
+{
+  /* When we are given an existing stream, we need only set up
+   * the zstd decoder.
+   */
+  stream = NULL;
+  if( fd != -1 )
+    status = zstd_stream_initialise( &stream, &input );
+}
+
+pkgZstdArchiveStream::~pkgZstdArchiveStream()
+{
+  /* The destructor frees memory resources allocated to the decoder,
+   * and closes the input stream file descriptor.
+   */
+  ZSTD_freeDStream( stream );
+  if( fd >= 0 )
+    close( fd );
+}
+
+int pkgZstdArchiveStream::Read( char *buf, size_t max )
+{
+  /* Read a zstd compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( ! IsReady() )
+    /*
+     * We cannot read from a stream with an invalid descriptor,
+     * or without a decoder; in this circumstance, just say that
+     * "nothing was read"...
+     */
+    return -1;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
+   */
+  ZSTD_outBuffer output = { buf, max, 0 };
+
+  while( (output.pos < output.size) && ! ZSTD_isError( status ) )
+  {
+    /* "buf" hasn't been filled yet, and the decoder has not reported
+     * any error; top up the raw input buffer, if we have exhausted its
+     * current content...
+     */
+    if( input.pos == input.size )
+    {
+      int count = GetRawData( fd, streambuf, sizeof( streambuf ) );
+      if( count < 0 )
+	/*
+	 * ...diagnosing any I/O error as a failed read...
+	 */
+	return -1;
+
+      /* ...but, if there is nothing more to be had, we leave the input
+       * buffer empty; the decoder may still hold data which it has not
+       * yet delivered, so we continue to run it, until it makes no
+       * further progress.
+       */
+      input.src = streambuf;
+      input.size = count;
+      input.pos = 0;
+    }
+
+    /* Run the decoder, to decompress as much as possible of the data
+     * currently in the raw input buffer, filling available space in
+     * "buf"; note that, on reaching the end of any one compressed frame,
+     * the decoder simply proceeds to the next, if any, so concatenated
+     * frames are handled as a single stream.
+     */
+    size_t filled = output.pos;
+    size_t result = ZSTD_decompressStream( stream, &output, &input );
+    if( (input.size == 0) && (output.pos == filled) && ! ZSTD_isError( result ) )
+    {
+      /* The raw input stream is exhausted, and the decoder has nothing
+       * more to deliver; if the preceding productive run left it part
+       * way through a frame, (i.e. with non-zero status), the stream has
+       * been truncated, and once we have returned any data which has
+       * already been decoded, we must report that as an error.
+       */
+      if( (output.pos == 0) && (status != 0) )
+	return -1;
+      break;
+    }
+    status = result;
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * completely exhausted the raw input stream, (in which case we return
+   * the actual number of bytes stored in "buf"), or the decoder reported
+   * an error, (in which case we return -1).
+   */
+  return ZSTD_isError( status ) ? -1 : output.pos;
+}
+
 /*****
  *
  * Auxiliary function: pkgOpenArchiveStream()
@@ -452,7 +895,19 @@ int pkgXzArchiveStream::Read( char *buf, size_t max )
 #include <string.h>
 #include <strings.h>
 
-extern "C" pkgArchiveStream* pkgOpenArchiveStream( const char* filename )
+enum
+{ /* Codes to identify each of the supported compression formats,
+   * as returned by archive_format(), below.
+   */
+  ARCHIVE_FORMAT_RAW,
+  ARCHIVE_FORMAT_GZIP,
+  ARCHIVE_FORMAT_BZIP2,
+  ARCHIVE_FORMAT_LZMA,
+  ARCHIVE_FORMAT_XZ,
+  ARCHIVE_FORMAT_ZSTD
+};
+
+static int archive_format( const char *filename )
 {
   /* Naive decompression filter selection, based on file name extension.
    *
@@ -464,43 +919,112 @@ extern "C" pkgArchiveStream* pkgOpenArchiveStream( const char* filename )
    * Portable Character Set should suffice; we offer no concessions for
    * any usage beyond this.
    */
-  char *ext = strrchr( filename, '.' );
+  const char *ext = strrchr( filename, '.' );
   if( ext != NULL )
   {
     if( strcasecmp( ext, ".gz" ) == 0 )
       /*
-       * We expect this input stream to be "gzip" compressed,
-       * so we return the appropriate decompressor.
+       * We expect this input stream to be "gzip" compressed...
        */
-      return new pkgGzipArchiveStream( filename );
+      return ARCHIVE_FORMAT_GZIP;
 
     else if( strcasecmp( ext, ".bz2" ) == 0 )
       /*
-       * We expect this input stream to be "bzip2" compressed,
-       * so again, we return the appropriate decompressor.
+       * ...or "bzip2" compressed...
        */
-      return new pkgBzipArchiveStream( filename );
+      return ARCHIVE_FORMAT_BZIP2;
 
     else if( strcasecmp( ext, ".lzma" ) == 0 )
       /*
-       * We expect this input stream to be "lzma" compressed,
-       * so again, we return the appropriate decompressor.
+       * ...or "lzma" compressed...
        */
-      return new pkgLzmaArchiveStream( filename );
+      return ARCHIVE_FORMAT_LZMA;
 
     else if( strcasecmp( ext, ".xz" ) == 0 )
       /*
-       * We expect this input stream to be "xz" compressed,
-       * so again, we return the appropriate decompressor.
+       * ...or "xz" compressed...
        */
-      return new pkgXzArchiveStream( filename );
+      return ARCHIVE_FORMAT_XZ;
+
+    else if( strcasecmp( ext, ".zst" ) == 0 )
+      /*
+       * ...or "zstd" compressed.
+       */
+      return ARCHIVE_FORMAT_ZSTD;
   }
 
   /* If we get to here, then we didn't recognise any of the standard
    * compression indicating file name extensions; fall through, to
    * process the stream as raw (uncompressed) data.
    */
+  return ARCHIVE_FORMAT_RAW;
+}
+
+extern "C" pkgArchiveStream* pkgOpenArchiveStream( const char* filename )
+{
+  /* Open the named archive file, returning the appropriate decompressor
+   * for the compression format indicated by its file name extension.
+   */
+  switch( archive_format( filename ) )
+  {
+    case ARCHIVE_FORMAT_GZIP:
+      return new pkgGzipArchiveStream( filename );
+
+    case ARCHIVE_FORMAT_BZIP2:
+      return new pkgBzipArchiveStream( filename );
+
+    case ARCHIVE_FORMAT_LZMA:
+      return new pkgLzmaArchiveStream( filename );
+
+    case ARCHIVE_FORMAT_XZ:
+      return new pkgXzArchiveStream( filename );
+
+    case ARCHIVE_FORMAT_ZSTD:
+      return new pkgZstdArchiveStream( filename );
+  }
   return new pkgRawArchiveStream( filename );
 }
 
+extern "C" pkgArchiveStream*
+pkgOpenStreamingArchive( const char* filename, pkgArchiveStream *feed )
+{
+  /* Attach the decompressor which is appropriate for the named archive
+   * to an alternative raw data source, (such as an internet download).
+   * Since no file descriptor is associated with the stream, we use -2,
+   * (which is never a valid file descriptor, but, unlike -1, does not
+   * mark the stream as invalid), as the decompressor's descriptor.
+   */
+  pkgArchiveStream *stream;
+  switch( archive_format( filename ) )
+  {
+    case ARCHIVE_FORMAT_GZIP:
+      stream = new pkgGzipArchiveStream( -2 );
+      break;
+
+    case ARCHIVE_FORMAT_BZIP2:
+      stream = new pkgBzipArchiveStream( -2 );
+      break;
+
+    case ARCHIVE_FORMAT_LZMA:
+      stream = new pkgLzmaArchiveStream( -2 );
+      break;
+
+    case ARCHIVE_FORMAT_XZ:
+      stream = new pkgXzArchiveStream( -2 );
+      break;
+
+    case ARCHIVE_FORMAT_ZSTD:
+      stream = new pkgZstdArchiveStream( -2 );
+      break;
+
+    default:
+      stream = new pkgRawArchiveStream( -2 );
+  }
+  /* The decompressor takes ownership of its source stream; it will
+   * be deleted, when the decompressor itself is deleted.
+   */
+  stream->SetSource( feed );
+  return stream;
+}
+
 /* $RCSfile: pkgstrm.cpp,v $: end of file */
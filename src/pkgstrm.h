@@ -28,6 +28,7 @@
 #define PKGSTRM_H  1
 
 #include <stdint.h>
+#include <stddef.h>
 
 class pkgArchiveStream
 {
@@ -35,12 +36,19 @@ class pkgArchiveStream
    * All archive streaming classes are be derived from this.
    */
   public:
-    pkgArchiveStream(){}
+    pkgArchiveStream():source( NULL ){}
     virtual bool IsReady() = 0;
     virtual int Read( char*, size_t ) = 0;
-    virtual ~pkgArchiveStream(){}
+    virtual ~pkgArchiveStream(){ delete source; }
+
+    /* A stream may be fed with raw data from another stream, (such as
+     * one which delivers an archive as it is downloaded), rather than
+     * from a file; it assumes ownership of any such source stream.
+     */
+    inline void SetSource( pkgArchiveStream *feed ){ source = feed; }
 
   protected:
+    pkgArchiveStream *source;
     virtual int GetRawData( int, uint8_t*, size_t );
 };
 
@@ -73,20 +81,29 @@ class pkgRawArchiveStream : public pkgArchiveStream
 #include <zlib.h>
 #include <bzlib.h>
 #include <lzma.h>
+#include <zstd.h>
+
+/* Size of the raw input buffer for xz decoders; (must not be less
+ * than BUFSIZ).
+ */
+#define PKGSTRM_XZ_BUFSIZ  (BUFSIZ > 0x10000 ? BUFSIZ : 0x10000)
 
 class pkgGzipArchiveStream : public pkgArchiveStream
 {
   /* A stream compressed using the "gzip" algorithm...
    */
   protected:
-    gzFile stream;
+    int fd;
+    z_stream stream;
+    uint8_t streambuf[BUFSIZ];
+    int status;
 
   public:
     pkgGzipArchiveStream( int );
     pkgGzipArchiveStream( const char* );
     virtual ~pkgGzipArchiveStream();
 
-    inline bool IsReady(){ return stream != NULL; }
+    inline bool IsReady(){ return fd != -1; }
     virtual int Read( char*, size_t );
 };
 
@@ -95,15 +112,17 @@ class pkgBzipArchiveStream : public pkgArchiveStream
   /* A stream compressed using the "bzip2" algorithm...
    */
   protected:
-    BZFILE *stream;
-    int bzerror;
+    int fd;
+    bz_stream stream;
+    uint8_t streambuf[BUFSIZ];
+    int status;
 
   public:
     pkgBzipArchiveStream( int );
     pkgBzipArchiveStream( const char* );
     virtual ~pkgBzipArchiveStream();
 
-    inline bool IsReady(){ return stream != NULL; }
+    inline bool IsReady(){ return fd != -1; }
     virtual int Read( char*, size_t );
 };
 
@@ -129,11 +148,14 @@ class pkgLzmaArchiveStream : public pkgArchiveStream
 class pkgXzArchiveStream : public pkgArchiveStream
 {
   /* A stream compressed using the "xz" algorithm...
+   * (Note that the multithreaded decoder distributes its input among
+   * its worker threads in relatively large chunks; a BUFSIZ buffer, as
+   * used for other formats, would starve it, so we use a larger one).
    */
   protected:
     int fd;
     lzma_stream stream;
-    uint8_t streambuf[BUFSIZ];
+    uint8_t streambuf[PKGSTRM_XZ_BUFSIZ];
     lzma_action opmode;
     int status;
 
@@ -146,6 +168,26 @@ class pkgXzArchiveStream : public pkgArchiveStream
     virtual int Read( char*, size_t );
 };
 
+class pkgZstdArchiveStream : public pkgArchiveStream
+{
+  /* A stream compressed using the "zstd" algorithm...
+   */
+  protected:
+    int fd;
+    ZSTD_DStream *stream;
+    ZSTD_inBuffer input;
+    uint8_t streambuf[ZSTD_BLOCKSIZE_MAX];
+    size_t status;
+
+  public:
+    pkgZstdArchiveStream( int );
+    pkgZstdArchiveStream( const char* );
+    virtual ~pkgZstdArchiveStream();
+
+    inline bool IsReady(){ return (fd != -1) && (stream != NULL); }
+    virtual int Read( char*, size_t );
+};
+
 #endif /* PKGSTRM_H_SPECIAL */
 
 /* A generic helper function, to open an archive stream using
@@ -153,4 +195,11 @@ class pkgXzArchiveStream : public pkgArchiveStream
  */
 extern "C" pkgArchiveStream *pkgOpenArchiveStream( const char* );
 
+/* ...and a variant, to attach the appropriate decompression filter
+ * to a raw data stream from any other source, (such as an internet
+ * download); the archive name is used only to select the filter.
+ */
+extern "C" pkgArchiveStream *pkgOpenStreamingArchive
+( const char*, pkgArchiveStream* );
+
 #endif /* PKGSTRM_H: $RCSfile: pkgstrm.h,v $: end of file */
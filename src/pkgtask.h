@@ -43,6 +43,8 @@ enum
   action_licence,
   action_source,
 
+  action_owner,
+
   end_of_actions
 };
 
@@ -57,6 +59,7 @@ enum
 #define ACTION_UPDATE   	(unsigned long)(action_update)
 #define ACTION_LICENCE  	(unsigned long)(action_licence)
 #define ACTION_SOURCE   	(unsigned long)(action_source)
+#define ACTION_OWNER    	(unsigned long)(action_owner)
 
 #define STRICTLY_GT		(ACTION_MASK + 1)
 #define STRICTLY_LT		(STRICTLY_GT << 1)
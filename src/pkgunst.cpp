@@ -35,7 +35,10 @@
 
 #include "pkginfo.h"
 #include "pkgkeys.h"
+#include "pkgmfst.h"
+#include "pkgownr.h"
 #include "pkgproc.h"
+#include "pkgopts.h"
 #include "pkgtask.h"
 
 #include "mkpath.h"
@@ -50,13 +53,13 @@
 static const char *request_key = "request";
 
 static __inline__ __attribute__((__always_inline__))
-pkgXmlNode *sysroot_lookup( pkgXmlNode *pkg, const char *tarname )
+pkgXmlNode *sysroot_lookup( pkgXmlNode *pkg, const char *tarname, const char **path )
 {
   /* A local helper function, to identify the sysroot association
-   * for any package which is to be uninstalled.
+   * for any package which is to be uninstalled, (and its path name).
    */
   pkgSpecs lookup( tarname );
-  return pkg->GetSysRoot( lookup.GetSubSystemName() );
+  return pkg->GetSysRoot( lookup.GetSubSystemName(), path );
 }
 
 static __inline__ __attribute__((__always_inline__))
@@ -297,6 +300,621 @@ int pkg_unlink( const char *sysroot, const char *pathname )
   return retval;
 }
 
+/* Package removal may be required to delete many thousands of files;
+ * on MS-Windows, each unlink() is a comparatively costly operation, which
+ * spends most of its time waiting on the file system, rather than the CPU,
+ * so we delegate it to a small pool of worker threads, which pick files
+ * from a shared list, and record the outcome for each; (all diagnostics
+ * are deferred to the main thread, to keep them in list order).  We do
+ * not bother with the pool, when there are too few files to make it
+ * worthwhile.
+ */
+#include <windows.h>
+#include <process.h>
+
+#define PKG_REMOVAL_WORKERS		4
+#define PKG_REMOVAL_THRESHOLD		64
+
+struct pkgRemovalEntry
+{
+  /* Each file, or directory, to be removed is identified by its path
+   * name, relative to a sysroot; since a single removal sweep may span
+   * more than one sysroot, each entry must identify both.
+   */
+  const char	*sysroot;
+  const char	*pathname;
+};
+
+struct pkgUnlinkList
+{
+  /* Description of a list of files which are to be removed by the
+   * worker pool; "next" is the index of the entry most recently taken,
+   * by any worker, and "status" receives the "errno" value for each
+   * entry, or zero on success.
+   */
+  struct pkgRemovalEntry	*entry;
+  int				*status;
+  unsigned			 count;
+  LONG				 next;
+};
+
+static int pkg_unlink_file( const char *sysroot, const char *pathname )
+{
+  /* Thread safe counterpart of "pkg_unlink()", for use by the workers;
+   * returns zero on success, or the "errno" value on failure, (but with
+   * ENOENT deemed to indicate success, as for "rm -f"); it produces no
+   * diagnostic output.
+   */
+  char filepath[ mkpath( NULL, sysroot, pathname, NULL ) ];
+  mkpath( filepath, sysroot, pathname, NULL );
+
+  chmod( filepath, S_IWRITE );
+  return ((unlink( filepath ) == 0) || (errno == ENOENT)) ? 0 : errno;
+}
+
+static unsigned __stdcall pkg_unlink_worker( void *ref )
+{
+  /* Thread procedure for each member of the worker pool; it repeatedly
+   * takes the next available entry from the list, and removes it, until
+   * no further entries remain.
+   */
+  struct pkgUnlinkList *list = (struct pkgUnlinkList *)(ref);
+  LONG index;
+
+  while( (unsigned)(index = InterlockedIncrement( &list->next )) < list->count )
+    list->status[index] = pkg_unlink_file(
+	list->entry[index].sysroot, list->entry[index].pathname
+      );
+  return 0;
+}
+
+static void pkg_unlink_batch( struct pkgRemovalEntry *entry, unsigned count )
+{
+  /* Remove all files named in a list, using the worker pool when the
+   * list is long enough to justify it.
+   */
+  struct pkgUnlinkList list = { entry, NULL, count, -1 };
+  if( (count == 0) || ((list.status = (int *)(malloc( count * sizeof( int ) ))) == NULL) )
+  {
+    /* There is nothing to remove, or we cannot record the outcomes
+     * on behalf of the workers; (in the latter case, we must simply
+     * remove each file in turn, reporting any failure immediately).
+     */
+    for( unsigned index = 0; index < count; index++ )
+      pkg_unlink( entry[index].sysroot, entry[index].pathname );
+    return;
+  }
+
+  HANDLE worker[PKG_REMOVAL_WORKERS];
+  unsigned workers = 0;
+  if( count >= PKG_REMOVAL_THRESHOLD )
+    while( workers < PKG_REMOVAL_WORKERS )
+    {
+      /* Start as many workers as we can, up to the pool limit; should
+       * any fail to start, those which did will simply take a larger
+       * share of the work...
+       */
+      HANDLE thread = (HANDLE)(_beginthreadex( NULL, 0, pkg_unlink_worker, &list, 0, NULL ));
+      if( thread == NULL )
+	break;
+      worker[workers++] = thread;
+    }
+
+  /* ...and, when we have no pool, (or could not start any worker),
+   * we simply do the work ourself; otherwise, we wait for the pool
+   * to complete it.
+   */
+  if( workers == 0 )
+    pkg_unlink_worker( &list );
+
+  else
+  { WaitForMultipleObjects( workers, worker, TRUE, INFINITE );
+    while( workers > 0 )
+      CloseHandle( worker[--workers] );
+  }
+
+  /* Finally, report the outcome for each file, in list order.
+   */
+  for( unsigned index = 0; index < count; index++ )
+  {
+    char filepath[ mkpath( NULL, entry[index].sysroot, entry[index].pathname, NULL ) ];
+    mkpath( filepath, entry[index].sysroot, entry[index].pathname, NULL );
+
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  %s: unlink file\n", filepath )
+      );
+    if( list.status[index] != 0 )
+      dmh_notify( DMH_WARNING, "%s:unlink failed; %s\n", filepath, strerror( list.status[index] ) );
+  }
+  free( list.status );
+}
+
+static unsigned pkg_dir_depth( const char *pathname )
+{
+  /* Helper to count the levels of nesting within a directory path
+   * name, (i.e. the number of directory separators it contains, while
+   * disregarding any which is merely a trailing separator).
+   */
+  unsigned depth = 0;
+  while( *pathname )
+    if( ((*pathname++ == '/') || (pathname[-1] == '\\')) && (*pathname != '\0') )
+      ++depth;
+  return depth;
+}
+
+static int pkg_dir_compare( const void *a, const void *b )
+{
+  /* Comparison function, used to sort a list of directories such that
+   * each is placed ahead of any other which may contain it, (i.e. in
+   * order of descending depth of nesting); within each level, entries
+   * are ordered by path name, and then by sysroot, so that duplicates
+   * are brought together.
+   */
+  const struct pkgRemovalEntry *lhs = (const struct pkgRemovalEntry *)(a);
+  const struct pkgRemovalEntry *rhs = (const struct pkgRemovalEntry *)(b);
+  unsigned depth_a = pkg_dir_depth( lhs->pathname );
+  unsigned depth_b = pkg_dir_depth( rhs->pathname );
+  if( depth_a != depth_b )
+    return (depth_a > depth_b) ? -1 : 1;
+
+  int retval = strcmp( lhs->pathname, rhs->pathname );
+  return (retval != 0) ? retval : strcmp( lhs->sysroot, rhs->sysroot );
+}
+
+static void pkg_prune_dirs( struct pkgRemovalEntry *dir, unsigned dirs )
+{
+  /* Attempt to remove each of a list of directories; we note that we
+   * may remove only those which no longer contain any files or other
+   * subdirectories, and that many may also contain files which belong
+   * to other packages, (or, in the case of replacement, to the new
+   * installation); thus we do not consider it to be an error if we are
+   * unable to remove any of them.
+   *
+   * Removal of any leaf directory may expose its own parent as a new
+   * leaf, which may then itself become a candidate for removal; by
+   * sorting the list so that every directory is visited before any
+   * which may contain it, a single pass over it is sufficient, (and
+   * any directory which is listed more than once need be visited only
+   * on the first occasion).
+   */
+  qsort( dir, dirs, sizeof( struct pkgRemovalEntry ), pkg_dir_compare );
+  for( unsigned index = 0; index < dirs; index++ )
+    if( (index == 0) || (pkg_dir_compare( dir + index - 1, dir + index ) != 0) )
+      pkg_rmdir( dir[index].sysroot, dir[index].pathname );
+}
+
+/* Flags which qualify the entries in a pkgRetainedInventory...
+ */
+#define RETAINED_FILE_STAT		(0x01)
+#define RETAINED_FILE_CHECKSUM		(0x02)
+#define RETAINED_FILE_CLAIMED		(0x04)
+
+static int retained_file_compare( const void *a, const void *b )
+{
+  /* Comparison function, used to sort, and subsequently to search,
+   * the file entries in a pkgRetainedInventory, by path name.
+   */
+  return strcmp( *(char * const *)(a), *(char * const *)(b) );
+}
+
+pkgRetainedInventory::pkgRetainedInventory
+( pkgXmlNode *manifest, const char *path ): file( NULL ), files( 0 ),
+dir( NULL ), dirs( 0 ), pool( NULL ), sorted( false ), purged( false )
+{
+  /* Constructor: collect the file and directory records from the
+   * specified manifest, (allowing for the possibility that it may be
+   * subdivided into multiple sections), together with the recorded
+   * properties of each file, (if any); we must copy them, because the
+   * manifest itself may be deleted before we are.
+   */
+  pkgXmlNode *ref;
+  syspath = strdup( path );
+  for( ref = manifest; ref != NULL; ref = ref->FindNextAssociate( manifest_key ) )
+  {
+    pkgXmlNode *item;
+    for( item = ref->FindFirstAssociate( filename_key ); item != NULL;
+	 item = item->FindNextAssociate( filename_key ) ) ++files;
+    for( item = ref->FindFirstAssociate( dirname_key ); item != NULL;
+	 item = item->FindNextAssociate( dirname_key ) ) ++dirs;
+  }
+  if( (files > 0)
+  &&  ((file = (struct entry *)(malloc( files * sizeof( struct entry ) ))) == NULL) )
+    files = 0;
+  if( (dirs > 0) && ((dir = (char **)(malloc( dirs * sizeof( char* ) ))) == NULL) )
+    dirs = 0;
+
+  unsigned file_index = 0, dir_index = 0;
+  for( ref = manifest; ref != NULL; ref = ref->FindNextAssociate( manifest_key ) )
+  {
+    pkgXmlNode *item = ref->FindFirstAssociate( filename_key );
+    while( (item != NULL) && (file_index < files) )
+    {
+      const char *pathname, *size, *mtime, *checksum;
+      if( (pathname = pathname_lookup( item, NULL )) != NULL )
+      {
+	struct entry *retain = file + file_index++;
+	retain->pathname = strdup( pathname );
+	retain->flags = 0;
+	if( ((size = item->GetPropVal( size_key, NULL )) != NULL)
+	&&  ((mtime = item->GetPropVal( mtime_key, NULL )) != NULL)  )
+	{
+	  /* The manifest records the size and time stamp of this file,
+	   * (as originally extracted), so we may check if it is unchanged.
+	   */
+	  retain->size = strtoul( size, NULL, 10 );
+	  retain->mtime = strtoul( mtime, NULL, 10 );
+	  retain->flags |= RETAINED_FILE_STAT;
+	}
+	if( (checksum = item->GetPropVal( checksum_key, NULL )) != NULL )
+	{
+	  /* It also records the checksum of the file content.
+	   */
+	  retain->checksum = strtoul( checksum, NULL, 16 );
+	  retain->flags |= RETAINED_FILE_CHECKSUM;
+	}
+      }
+      item = item->FindNextAssociate( filename_key );
+    }
+    item = ref->FindFirstAssociate( dirname_key );
+    while( (item != NULL) && (dir_index < dirs) )
+    {
+      const char *pathname;
+      if( (pathname = pathname_lookup( item, NULL )) != NULL )
+	dir[dir_index++] = strdup( pathname );
+      item = item->FindNextAssociate( dirname_key );
+    }
+  }
+  /* Adjust the counts, to disregard any records which lacked a path name.
+   */
+  files = file_index; dirs = dir_index;
+}
+
+pkgRetainedInventory::pkgRetainedInventory
+( pkgCompactManifest *manifest, const char *path ): file( NULL ), files( 0 ),
+dir( NULL ), dirs( 0 ), pool( NULL ), sorted( false ), purged( false )
+{
+  /* Alternative constructor, collecting the inventory from the compact
+   * form of a manifest; in this case, we copy all of the path names into
+   * a single pool, rather than allocating each individually.
+   */
+  const struct pkgCompactManifestEntry *ref;
+  size_t pool_size = 0;
+  syspath = strdup( path );
+  for( unsigned index = 0; (ref = manifest->Entry( index )) != NULL; index++ )
+  {
+    if( (ref->flags & PKGMFST_ENTRY_DIR) != 0 ) ++dirs; else ++files;
+    pool_size += strlen( manifest->Pathname( ref ) ) + 1;
+  }
+  if( ((pool_size > 0) && ((pool = (char *)(malloc( pool_size ))) == NULL))
+  ||  ((files > 0)
+  &&   ((file = (struct entry *)(malloc( files * sizeof( struct entry ) ))) == NULL))
+  ||  ((dirs > 0) && ((dir = (char **)(malloc( dirs * sizeof( char* ) ))) == NULL))  )
+    files = dirs = 0;
+
+  char *next = pool;
+  unsigned file_index = 0, dir_index = 0;
+  for( unsigned index = 0; (ref = manifest->Entry( index )) != NULL; index++ )
+  {
+    size_t len = strlen( manifest->Pathname( ref ) ) + 1;
+    if( ((ref->flags & PKGMFST_ENTRY_DIR) != 0) && (dir_index < dirs) )
+      dir[dir_index++] = (char *)(memcpy( next, manifest->Pathname( ref ), len ));
+
+    else if( ((ref->flags & PKGMFST_ENTRY_DIR) == 0) && (file_index < files) )
+    {
+      struct entry *retain = file + file_index++;
+      retain->pathname = (char *)(memcpy( next, manifest->Pathname( ref ), len ));
+      retain->size = ref->size; retain->mtime = (time_t)(ref->mtime);
+      retain->checksum = ref->checksum;
+      retain->flags = 0;
+      if( (ref->flags & PKGMFST_ENTRY_STAT) != 0 )
+	retain->flags |= RETAINED_FILE_STAT;
+      if( (ref->flags & PKGMFST_ENTRY_CHECKSUM) != 0 )
+	retain->flags |= RETAINED_FILE_CHECKSUM;
+    }
+    else continue;
+    next += len;
+  }
+  /* A mapped compact manifest is already sorted by path name, so we
+   * need not sort our copy of it again.
+   */
+  sorted = manifest->IsMapped();
+}
+
+bool pkgRetainedInventory::Claim
+( const char *pathname, const char *refname, uint64_t size, time_t mtime,
+  const uint32_t *checksum )
+{
+  /* Method called by the installer, for each file it is about to extract;
+   * "pathname" is the absolute path name of the file, "refname" is its path
+   * name relative to sysroot, (as recorded in the manifest), while "size",
+   * "mtime" and "checksum" describe the content which is to be extracted,
+   * (but "checksum" may be NULL, if it is not yet known).  If the file is
+   * retained, we claim it, so that it will not be removed when we are
+   * deleted; we return true if it is unchanged, (and the user has asked
+   * us to skip unchanged files), or otherwise we prepare it to be
+   * overwritten in place, and we return false, so that the installer
+   * will write the new content.
+   */
+  if( ! sorted )
+  {
+    /* We search the inventory by path name, but we defer sorting it
+     * until it is first searched.
+     */
+    qsort( file, files, sizeof( struct entry ), retained_file_compare );
+    sorted = true;
+  }
+  struct entry *ref = (struct entry *)(bsearch( &refname, file, files,
+	sizeof( struct entry ), retained_file_compare ));
+
+  if( ref == NULL )
+    /*
+     * The file was not provided by the prior installation; there is
+     * nothing to claim.
+     */
+    return false;
+
+  /* The file is retained; claim it, and check that it is still present
+   * on disk, as a regular file...
+   */
+  struct stat info;
+  ref->flags |= RETAINED_FILE_CLAIMED;
+  if( (stat( pathname, &info ) != 0) || ! S_ISREG( info.st_mode ) )
+  {
+    /* ...(and if not, remove whatever may have replaced it, so that the
+     * installer may create it afresh)...
+     */
+    pkg_unlink( syspath, ref->pathname );
+    return false;
+  }
+
+  /* ...then, if the user has asked us to skip unchanged files, check
+   * that the size and time stamp recorded for the prior installation
+   * match the new content, and the file on disk...
+   */
+  bool unchanged
+    = (pkgOptions()->Test( OPTION_SKIP_UNCHANGED, OPTION_EXTRA_FLAGS ) != 0)
+    && ((ref->flags & RETAINED_FILE_STAT) != 0)
+    && (ref->size == size) && (ref->mtime == mtime)
+    && ((uint64_t)(info.st_size) == size) && (info.st_mtime == mtime);
+
+  /* ...and also the checksum, if the user has asked us to verify it.
+   */
+  if( unchanged
+  &&  (pkgOptions()->Test( OPTION_VERIFY_UNCHANGED, OPTION_EXTRA_FLAGS )
+	== OPTION_VERIFY_UNCHANGED)  )
+    unchanged = (checksum != NULL) && ((ref->flags & RETAINED_FILE_CHECKSUM) != 0)
+      && (ref->checksum == *checksum);
+
+  if( ! unchanged )
+  {
+    /* The file must be rewritten; rather than deleting it, and then
+     * creating it anew, we simply ensure that it is writeable, so that
+     * the installer may overwrite it in place.
+     */
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  %s: overwrite file\n", pathname )
+      );
+    chmod( pathname, info.st_mode | S_IWRITE );
+  }
+  return unchanged;
+}
+
+void pkgRetainedInventory::Exempt( pkgOwnershipIndex *owners, const char *tarname )
+{
+  /* Method called by pkgRemove(), to retain any file which has been
+   * overwritten by another package, since it was installed by the one to
+   * which this inventory belongs; we mark each such file as claimed, so
+   * that it will not be removed when we are deleted.  When the removal
+   * has been deferred, that package will already have released its own
+   * claims, so "tarname" is then NULL, and any remaining owner suffices.
+   */
+  for( unsigned index = 0; index < files; index++ )
+  {
+    const char *owner = owners->Owner( file[index].pathname );
+    if( (owner != NULL) && ((tarname == NULL) || ! pkg_strcmp( owner, tarname )) )
+    {
+      DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	  dmh_printf( "  %s: retained; provided by %s\n", file[index].pathname, owner )
+	);
+      file[index].flags |= RETAINED_FILE_CLAIMED;
+    }
+  }
+}
+
+void pkgRetainedInventory::Purge( pkgRetainedInventory **list, unsigned count )
+{
+  /* Delete each file which has not been claimed, from every inventory
+   * in the list, in a single sweep...
+   */
+  unsigned files = 0, dirs = 0;
+  for( unsigned index = 0; index < count; index++ )
+    if( ! list[index]->purged && (list[index]->syspath != NULL) )
+    {
+      for( unsigned ref = 0; ref < list[index]->files; ref++ )
+	if( (list[index]->file[ref].flags & RETAINED_FILE_CLAIMED) == 0 )
+	  ++files;
+      dirs += list[index]->dirs;
+    }
+
+  struct pkgRemovalEntry *entry = NULL;
+  if( (files + dirs) > 0 )
+    entry = (struct pkgRemovalEntry *)(malloc( (files + dirs) * sizeof( *entry ) ));
+
+  files = dirs = 0;
+  for( unsigned index = 0; index < count; index++ )
+    if( ! list[index]->purged && (list[index]->syspath != NULL) )
+    {
+      pkgRetainedInventory *inventory = list[index];
+      for( unsigned ref = 0; ref < inventory->files; ref++ )
+	if( (inventory->file[ref].flags & RETAINED_FILE_CLAIMED) == 0 )
+	{
+	  if( entry != NULL )
+	  {
+	    entry[files].sysroot = inventory->syspath;
+	    entry[files].pathname = inventory->file[ref].pathname;
+	  }
+	  else
+	    /* We could not allocate the combined list; we must remove
+	     * each file immediately, as we find it.
+	     */
+	    pkg_unlink( inventory->syspath, inventory->file[ref].pathname );
+	  ++files;
+	}
+    }
+  if( entry != NULL )
+    pkg_unlink_batch( entry, files );
+
+  /* ...then attempt to prune any directories which may have been
+   * created during the installation of any of the packages, from the
+   * file system tree; (we reuse the tail of the list of files, which
+   * we have already processed, to collect them).
+   */
+  for( unsigned index = 0; index < count; index++ )
+    if( ! list[index]->purged && (list[index]->syspath != NULL) )
+    {
+      pkgRetainedInventory *inventory = list[index];
+      for( unsigned ref = 0; ref < inventory->dirs; ref++ )
+      {
+	if( entry != NULL )
+	{
+	  entry[files + dirs].sysroot = inventory->syspath;
+	  entry[files + dirs].pathname = inventory->dir[ref];
+	}
+	else
+	  pkg_rmdir( inventory->syspath, inventory->dir[ref] );
+	++dirs;
+      }
+    }
+  if( entry != NULL )
+    pkg_prune_dirs( entry + files, dirs );
+  free( entry );
+
+  /* Mark every inventory as purged, so that none will be removed again.
+   */
+  for( unsigned index = 0; index < count; index++ )
+    list[index]->purged = true;
+}
+
+pkgRetainedInventory::~pkgRetainedInventory()
+{
+  /* Destructor: complete the removal, unless it has been completed
+   * already, as a member of a batch...
+   */
+  if( ! purged )
+  {
+    pkgRetainedInventory *self = this;
+    Purge( &self, 1 );
+  }
+
+  /* ...then release the memory allocated to the inventory itself.
+   */
+  if( pool == NULL )
+  {
+    for( unsigned index = 0; index < files; index++ )
+      free( file[index].pathname );
+    for( unsigned index = 0; index < dirs; index++ )
+      free( dir[index] );
+  }
+  free( file );
+  free( dir );
+  free( pool );
+  free( syspath );
+}
+
+/* A pkgRemovalBatch is normally created on the stack, by the action
+ * item executor, so there is only ever one active batch; however, we
+ * keep a reference to any which was active before, in case they nest.
+ */
+pkgRemovalBatch *pkgRemovalBatch::active = NULL;
+
+pkgRemovalBatch::pkgRemovalBatch():
+item( NULL ), items( 0 ), item_max( 0 ), prior( active )
+{
+  /* Constructor: the new batch becomes the active batch.
+   */
+  active = this;
+}
+
+void pkgRemovalBatch::Defer
+( pkgRetainedInventory *inventory, pkgOwnershipIndex *owners,
+  pkgXmlNode *package, const char *sysroot_path
+)
+{
+  /* Add an inventory, (which may be NULL), to the batch, together with
+   * the file ownership index for its sysroot, and the package, (if any),
+   * for which the post-remove script is to be run, after the removal has
+   * been completed, (with the expanded sysroot path, which is exported
+   * for the benefit of that script).
+   */
+  if( items == item_max )
+  {
+    /* We need more space, to record the deferral; if we cannot get it,
+     * then we simply complete the removal immediately.
+     */
+    unsigned max = (item_max == 0) ? 16 : item_max << 1;
+    struct deferral *ref;
+    if( (ref = (struct deferral *)(realloc( item, max * sizeof( *ref ) ))) == NULL )
+    {
+      delete inventory;
+      if( package != NULL )
+      {
+	pkgExportSysRoot( sysroot_path );
+	package->InvokeScript( "post-remove" );
+      }
+      return;
+    }
+    item = ref; item_max = max;
+  }
+  item[items].inventory = inventory;
+  item[items].owners = owners;
+  item[items].package = package;
+  item[items++].sysroot_path = sysroot_path;
+}
+
+void pkgRemovalBatch::Complete()
+{
+  /* Complete the removal of all deferred inventories, in one sweep;
+   * any file which has been claimed by another package, (since the one
+   * to which its inventory belongs was removed), must be retained.
+   */
+  pkgRetainedInventory *list[items];
+  unsigned count = 0;
+  for( unsigned index = 0; index < items; index++ )
+    if( item[index].inventory != NULL )
+    {
+      if( item[index].owners != NULL )
+	item[index].inventory->Exempt( item[index].owners, NULL );
+      list[count++] = item[index].inventory;
+    }
+  pkgRetainedInventory::Purge( list, count );
+
+  /* Each inventory may now be deleted, and the post-remove script for
+   * each package run, in the order in which the packages were removed;
+   * each such script may refer to its own sysroot, by way of the "SYSROOT"
+   * environment variable, which we must therefore reassign.
+   */
+  for( unsigned index = 0; index < items; index++ )
+  {
+    delete item[index].inventory;
+    if( item[index].package != NULL )
+    {
+      pkgExportSysRoot( item[index].sysroot_path );
+      item[index].package->InvokeScript( "post-remove" );
+    }
+  }
+  items = 0;
+}
+
+pkgRemovalBatch::~pkgRemovalBatch()
+{
+  /* Destructor: complete any removals which remain outstanding, and
+   * restore any previously active batch.
+   */
+  Complete();
+  free( item );
+  active = prior;
+}
+
 EXTERN_C void pkgRemove( pkgActionItem *current )
 {
   /* Common handler for all package removal tasks...
@@ -310,7 +928,23 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
      * and the sysroot with which it is associated.
      */
     const char *tarname = pkg->GetPropVal( tarname_key, value_unknown );
-    pkgXmlNode *sysroot = sysroot_lookup( pkg, tarname );
+    const char *sysroot_path;
+    pkgXmlNode *sysroot = sysroot_lookup( pkg, tarname, &sysroot_path );
+
+    /* We will also need the file ownership index for the sysroot; we
+     * must open it before we change the installation records, against
+     * which it is validated.
+     */
+    pkgOwnershipIndex *owners = pkgOwnershipIndex::Open( sysroot );
+
+    /* Unless it is to be replaced, the package's files will be removed
+     * along with those of any others in the active batch, (if any), and
+     * its post-remove script will then be run; otherwise, these are both
+     * completed here, as each removal is processed.
+     */
+    pkgRetainedInventory *content = NULL;
+    pkgRemovalBatch *batch = (current->HasAttribute( ACTION_INSTALL ) == ACTION_INSTALL)
+      ? NULL : pkgRemovalBatch::Active();
 
     /* If the package we are about to remove has an associated
      * pre-remove script, now is the time to invoke it...
@@ -415,80 +1049,46 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
 	  const char *refpath = pathname_lookup( sysroot, value_unknown );
 	  char syspath[4 + strlen( refpath )]; sprintf( syspath, "%s%%/F", refpath );
 
-	  /* Read the package manifest...
+	  /* Collect the inventory of files and directories, which are
+	   * recorded in the manifest, (or in its compact equivalent)...
 	   */
-	  ref = manifest;
-	  while( ref != NULL )
+	  pkgCompactManifest *compact = inventory.GetCompactInventory();
+	  if( (compact != NULL) && ! compact->IsOk() )
 	  {
-	    /* ...selecting records identifying installed files...
-	     */
-	    pkgXmlNode *files = ref->FindFirstAssociate( filename_key );
-	    while( files != NULL )
-	    {
-	      /* ...and delete each in turn...
-	       */
-	      pkg_unlink( syspath, pathname_lookup( files, NULL ) );
-	      /*
-	       * ...before moving on to the next in the list.
-	       */
-	      files = files->FindNextAssociate( filename_key );
-	    }
-	    /* It should not be, but allow for the possibility that
-	     * the manifest is subdivided into multiple sections.
+	    /* The inventory was recorded in compact form, but we cannot
+	     * read it; were we to proceed, we would discard all record of
+	     * the installed files, leaving them orphaned.  Abandon removal
+	     * of the package, (and any installation which is to replace
+	     * it), leaving it, and its records, intact.
 	     */
-	    ref = ref->FindNextAssociate( manifest_key );
+	    dmh_notify( DMH_ERROR, "not removing installed %s\n", pkg->GetName() );
+	    dmh_notify( DMH_ERROR, "%s is still installed\n", tarname );
+	    current->CancelInstallation();
+	    return;
 	  }
+	  content = (compact != NULL)
+	    ? new pkgRetainedInventory( compact, syspath )
+	    : new pkgRetainedInventory( manifest, syspath );
 
-	  /* Having deleted all files associated with the package,
-	   * we attempt to prune any directories, which may have been
-	   * created during the installation of this package, from the
-	   * file system tree.  We note that we may remove only those
-	   * directories which no longer contain any files or other
-	   * subdirectories, (i.e. those which are leaf directories
-	   * within the file system).  We also note that many of the
-	   * directories associated with the package being removed
-	   * may also contain files belonging to other packages; thus
-	   * we do not consider it to be an error if we are unable to
-	   * remove any directory specified in the package manifest.
-	   *
-	   * Removal of any leaf directory may expose its own parent
-	   * as a new leaf, which may then itself become a candidate
-	   * for removal; thus we adopt an iterative removal procedure,
-	   * restarting with a further iteration after any pass through
-	   * the manifest in which any directory is removed.
+	  /* ...excepting any which have since been overwritten by other
+	   * packages, and are now provided by them...
 	   */
-	  bool restart;
-	  do {
-	       /* Process the entire manifest on each iteration;
-		* initially assume that no restart will be required.
-		*/
-	       ref = manifest; restart = false;
-	       while( ref != NULL )
-	       {
-		 /* Select manifest records which specify directories...
-		  */
-		 pkgXmlNode *dir = ref->FindFirstAssociate( dirname_key );
-		 while( dir != NULL )
-		 {
-		   /* ...attempting to remove each in turn; request a
-		    * restart when at least one such attempt succeeds...
-		    */
-		   restart |= pkg_rmdir( syspath, pathname_lookup( dir, NULL ) );
-		   /*
-		    * ...then move on to the next record, if any.
-		    */
-		   dir = dir->FindNextAssociate( dirname_key );
-		 }
-		 /* As in the case of file removal, allow for the
-		  * possibility of a multisectional manifest.
-		  */
-		 ref = ref->FindNextAssociate( manifest_key );
-	       }
-	       /* Restart the directory removal process, with a new
-		* iteration through the entire manifest, until no more
-		* listed directories can be removed.
-		*/
-	     } while( restart );
+	  if( owners != NULL )
+	    content->Exempt( owners, tarname );
+
+	  if( current->HasAttribute( ACTION_INSTALL ) == ACTION_INSTALL )
+	  {
+	    /* ...and, when this removal is in preparation for replacement,
+	     * (i.e. for upgrade or reinstallation), retain them for the
+	     * installer to claim; it will overwrite, in place, those which
+	     * are also provided by the replacement, (or skip them, when the
+	     * user has asked us to avoid rewriting unchanged files), and it
+	     * will complete the removal of any which it does not claim;
+	     * (otherwise, deleting the inventory removes all of them).
+	     */
+	    current->RetainInventory( content );
+	    content = NULL;
+	  }
 
 	  /* Finally, disassociate the package manifest from the active sysroot;
 	   * this will automatically delete the manifest itself, unless it has a
@@ -520,14 +1120,27 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
 	 * we may delete it, also marking the sysroot record as "modified", so
 	 * that the change will be committed to disk.
 	 */
-	sysroot->DeleteChild( expunge );
+	sysroot->DeleteInstallationRecord( expunge );
 	sysroot->SetAttribute( modified_key, value_yes );
       }
     }
+    /* The package no longer provides any files; release its claims
+     * in the file ownership index.
+     */
+    if( owners != NULL )
+      owners->Release( tarname );
+
     /* After package removal has been completed, we invoke any
-     * post-remove script which may be associated with the package.
+     * post-remove script which may be associated with the package;
+     * when the removal is batched, both are deferred.
      */
-    pkg->InvokeScript( "post-remove" );
+    if( batch != NULL )
+      batch->Defer( content, owners, pkg, sysroot_path );
+
+    else
+    { delete content;
+      pkg->InvokeScript( "post-remove" );
+    }
   }
   else if( (pkg != NULL) && current->HasAttribute( ACTION_DOWNLOAD ) )
   {
@@ -0,0 +1,865 @@
+/*
+ * pkgxfer.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Implementation of the portable download transports for mingw-get;
+ * these provide "file:" URL access, and a minimal HTTP/1.1 client which
+ * keeps connections alive, so that successive requests directed to any
+ * one host may reuse a single connection.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#ifdef _WIN32
+/*
+ * On MS-Windows hosts, we use winsock; we need getaddrinfo(), which
+ * requires a minimum of WinXP, and we must include winsock2.h before
+ * any other header may include windows.h
+ */
+# ifndef _WIN32_WINNT
+#  define _WIN32_WINNT 0x0501
+# endif
+# define WIN32_LEAN_AND_MEAN
+# include <winsock2.h>
+# include <ws2tcpip.h>
+# include <windows.h>
+
+#else
+/* On POSIX hosts, we need the BSD sockets API, and pthreads; we map
+ * the few winsock specific names we use to their POSIX equivalents.
+ */
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/time.h>
+# include <netdb.h>
+# include <strings.h>
+# include <pthread.h>
+
+  typedef int SOCKET;
+# define INVALID_SOCKET  (-1)
+# define closesocket     close
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "dmh.h"
+#include "debug.h"
+#include "pkgxfer.h"
+
+#ifndef O_BINARY
+/* This is a Win32 specific attribute; if it isn't defined
+ * then we are compiling on a POSIX system, which doesn't need it;
+ * define it as zero, so that its effect is a no-op.
+ */
+# define O_BINARY  0
+#endif
+
+#ifndef MSG_NOSIGNAL
+/* Where available, we use this, to avoid SIGPIPE when a peer closes
+ * a connection which we may have considered reusable.
+ */
+# define MSG_NOSIGNAL  0
+#endif
+
+#define STATIC_INLINE  static __inline__ __attribute__((__always_inline__))
+
+class pkgTransportLock
+{
+  /* A minimal, portable mutex; the HTTP transport's connection pool
+   * may be accessed concurrently, from several download threads.
+   */
+  public:
+#   ifdef _WIN32
+    pkgTransportLock(){ InitializeCriticalSection( &lock ); }
+    ~pkgTransportLock(){ DeleteCriticalSection( &lock ); }
+    inline void Acquire(){ EnterCriticalSection( &lock ); }
+    inline void Release(){ LeaveCriticalSection( &lock ); }
+
+  private:
+    CRITICAL_SECTION lock;
+
+#   else
+    pkgTransportLock(){ pthread_mutex_init( &lock, NULL ); }
+    ~pkgTransportLock(){ pthread_mutex_destroy( &lock ); }
+    inline void Acquire(){ pthread_mutex_lock( &lock ); }
+    inline void Release(){ pthread_mutex_unlock( &lock ); }
+
+  private:
+    pthread_mutex_t lock;
+#   endif
+};
+
+STATIC_INLINE int hexval( int c )
+{
+  /* Helper to interpret a single hexadecimal digit; returns -1
+   * if the argument is not a valid hexadecimal digit.
+   */
+  if( isdigit( c ) ) return c - '0';
+  if( isxdigit( c ) ) return tolower( c ) - 'a' + 10;
+  return -1;
+}
+
+STATIC_INLINE bool match_scheme( const char *url, const char *scheme )
+{
+  /* Helper to check for a specified (case insensitive) URL scheme,
+   * (inclusive of the "//" authority prefix).
+   */
+  return strncasecmp( url, scheme, strlen( scheme ) ) == 0;
+}
+
+STATIC_INLINE bool has_scheme( const char *url )
+{
+  /* Helper to check whether a URL reference specifies any scheme,
+   * (i.e. it is absolute), rather than being relative to its base.
+   */
+  const char *mark = url + strcspn( url, ":/?#" );
+  return (mark > url) && (*mark == ':');
+}
+
+/* The "file:" transport...
+ */
+class pkgFileResource : public pkgInternetResource
+{
+  /* A resource representing a local file, opened for reading; its
+   * validator is derived from its modification time and size.
+   */
+  public:
+    pkgFileResource( int, unsigned long, const char* );
+    virtual ~pkgFileResource(){ close( fd ); }
+
+    virtual unsigned long Status(){ return offset ? 206 : 200; }
+    virtual unsigned long ContentLength(){ return length - offset; }
+    virtual int Read( char *buf, size_t max, unsigned long *count )
+    {
+      int len = read( fd, buf, max );
+      *count = (len > 0) ? len : 0;
+      return len >= 0;
+    }
+    virtual unsigned long Offset(){ return offset; }
+    virtual const char *Validator(){ return validator; }
+
+  private:
+    int fd;
+    unsigned long offset, length;
+    char validator[40];
+};
+
+pkgFileResource::pkgFileResource
+( int file, unsigned long start, const char *match ):fd( file ), offset( 0 )
+{
+  /* Construct the validator; then, if the caller asked to resume at
+   * a specified offset, and the file is unchanged, seek to it.
+   */
+  struct stat info;
+  if( fstat( fd, &info ) != 0 )
+    info.st_size = info.st_mtime = 0;
+  length = info.st_size;
+  sprintf( validator, "\"%lx-%lx\"",
+      (unsigned long)(info.st_mtime), (unsigned long)(info.st_size)
+    );
+  if( (start > 0) && (start < length) && (match != NULL)
+  &&  (strcmp( match, validator ) == 0)
+  &&  (lseek( fd, start, SEEK_SET ) == (off_t)(start))  )
+    offset = start;
+}
+
+class pkgFileTransportAgent : public pkgInternetTransport
+{
+  /* The transport which opens "file:" URLs.
+   */
+  public:
+    virtual pkgInternetResource *Open( const char*, unsigned long, const char* );
+};
+
+pkgInternetResource *pkgFileTransportAgent::Open
+( const char *url, unsigned long offset, const char *validator )
+{
+  /* Decode the path name from the URL, (discarding any host name, and
+   * interpreting any "%XX" escapes), then open the file it identifies.
+   */
+  if( ! match_scheme( url, "file://" ) )
+    return NULL;
+
+  const char *src = strchr( url += 7, '/' );
+  char path[1 + strlen( url )], *dst = path;
+  if( src == NULL )
+    return NULL;
+
+# ifdef _WIN32
+  /* On MS-Windows, a path such as "/C:/..." refers to a drive letter;
+   * we must discard the leading slash.
+   */
+  if( isalpha( src[1] ) && (src[2] == ':') )
+    ++src;
+# endif
+
+  while( *src )
+  {
+    if( (*src == '%') && (hexval( src[1] ) >= 0) && (hexval( src[2] ) >= 0) )
+    {
+      *dst++ = (hexval( src[1] ) << 4) | hexval( src[2] );
+      src += 3;
+    }
+    else
+      *dst++ = *src++;
+  }
+  *dst = '\0';
+
+  int fd;
+  if( (fd = open( path, O_RDONLY | O_BINARY )) < 0 )
+  {
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	dmh_printf( "%s: cannot open file\n", path )
+      );
+    return NULL;
+  }
+  return new pkgFileResource( fd, offset, validator );
+}
+
+/* The "http:" transport...
+ */
+struct pkgHttpConnection
+{
+  /* A data structure representing a single connection to an HTTP
+   * server, together with its input buffer; connections which remain
+   * usable, after completing a request, are retained in a linked list
+   * of idle connections, (hence the "next" pointer), for reuse.
+   */
+  pkgHttpConnection *next;
+  SOCKET fd;
+  char *host;
+  unsigned port;
+  size_t head, tail;
+  char buf[8192];
+};
+
+class pkgHttpTransportAgent : public pkgInternetTransport
+{
+  /* The transport which opens "http:" URLs, managing a pool of idle,
+   * persistent connections.
+   */
+  public:
+    pkgHttpTransportAgent():idle( NULL ), idle_count( 0 ), started( false ){}
+    virtual ~pkgHttpTransportAgent();
+
+    virtual pkgInternetResource *Open( const char*, unsigned long, const char* );
+
+    /* Methods for managing connections...
+     */
+    pkgHttpConnection *Acquire( const char*, unsigned, bool* );
+    void Release( pkgHttpConnection* );
+    static void Discard( pkgHttpConnection* );
+
+  private:
+    pkgTransportLock lock;
+    pkgHttpConnection *idle;
+    unsigned idle_count;
+    bool started;
+
+    pkgHttpConnection *Connect( const char*, unsigned );
+};
+
+/* We retain at most this many idle connections, and we follow at most
+ * this many redirections, when servicing any single request.
+ */
+#define PKG_HTTP_MAX_IDLE	8
+#define PKG_HTTP_MAX_REDIRECT	5
+
+class pkgHttpResource : public pkgInternetResource
+{
+  /* A resource representing the response to an HTTP GET request.
+   */
+  public:
+    pkgHttpResource( pkgHttpTransportAgent*, pkgHttpConnection* );
+    virtual ~pkgHttpResource();
+
+    virtual unsigned long Status(){ return status; }
+    virtual unsigned long ContentLength(){ return content_length; }
+    virtual int Read( char*, size_t, unsigned long* );
+    virtual unsigned long Offset(){ return offset; }
+    virtual const char *Validator();
+
+    /* Methods used by the transport, to issue the request and parse
+     * the response headers; to discard any response body which is not
+     * of interest; and to retrieve the target of any redirection.
+     */
+    bool Request( const char*, const char*, unsigned long, const char* );
+    void Drain();
+    virtual const char *Location(){ return location; }
+
+  private:
+    pkgHttpTransportAgent *agent;
+    pkgHttpConnection *conn;
+    unsigned long status, content_length, remaining, offset;
+    bool chunked, sized, reusable, done;
+    char *location, *etag, *timestamp;
+
+    int Fill();
+    int GetLine( char*, size_t );
+    int GetData( char*, size_t );
+};
+
+pkgHttpConnection *pkgHttpTransportAgent::Connect( const char *host, unsigned port )
+{
+  /* Private method to establish a new connection to the specified
+   * host and port; returns NULL on failure.
+   */
+# ifdef _WIN32
+  if( ! started )
+  {
+    /* On first use, winsock must be initialised.
+     */
+    WSADATA info;
+    lock.Acquire();
+    if( ! started && (WSAStartup( MAKEWORD( 2, 2 ), &info ) == 0) )
+      started = true;
+    lock.Release();
+  }
+# endif
+
+  char service[12];
+  struct addrinfo hints, *addr, *ref;
+  memset( &hints, 0, sizeof( hints ) );
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  sprintf( service, "%u", port );
+  if( getaddrinfo( host, service, &hints, &addr ) != 0 )
+    return NULL;
+
+  SOCKET fd = INVALID_SOCKET;
+  for( ref = addr; ref != NULL; ref = ref->ai_next )
+  {
+    /* Try each address in turn, until we establish a connection.
+     */
+    if( (fd = socket( ref->ai_family, ref->ai_socktype, ref->ai_protocol ))
+	!= INVALID_SOCKET )
+    {
+      if( connect( fd, ref->ai_addr, ref->ai_addrlen ) == 0 )
+	break;
+      closesocket( fd );
+      fd = INVALID_SOCKET;
+    }
+  }
+  freeaddrinfo( addr );
+  if( fd == INVALID_SOCKET )
+    return NULL;
+
+  /* Don't allow a stalled server to hang us indefinitely; (note that
+   * winsock and POSIX differ in the representation of the timeout).
+   */
+# ifdef _WIN32
+  DWORD timeout = 60000;
+# else
+  struct timeval timeout = { 60, 0 };
+# endif
+  setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, (char *)(&timeout), sizeof( timeout ) );
+
+  pkgHttpConnection *conn;
+  if( (conn = (pkgHttpConnection *)(malloc( sizeof( pkgHttpConnection ) ))) != NULL )
+  {
+    if( (conn->host = strdup( host )) != NULL )
+    {
+      conn->next = NULL; conn->fd = fd; conn->port = port;
+      conn->head = conn->tail = 0;
+      return conn;
+    }
+    free( conn );
+  }
+  closesocket( fd );
+  return NULL;
+}
+
+pkgHttpConnection *pkgHttpTransportAgent::Acquire
+( const char *host, unsigned port, bool *reused )
+{
+  /* Retrieve an idle connection to the specified host, if we have one,
+   * otherwise establish a new connection.
+   */
+  pkgHttpConnection *conn, **ref = &idle;
+  lock.Acquire();
+  while( ((conn = *ref) != NULL)
+  &&    ((conn->port != port) || (strcasecmp( conn->host, host ) != 0)) )
+    ref = &conn->next;
+  if( conn != NULL )
+  {
+    *ref = conn->next;
+    --idle_count;
+  }
+  lock.Release();
+
+  if( (*reused = (conn != NULL)) == false )
+    conn = Connect( host, port );
+  return conn;
+}
+
+void pkgHttpTransportAgent::Release( pkgHttpConnection *conn )
+{
+  /* Return a connection which remains usable to the idle pool, (or
+   * close it, if the pool is already full).
+   */
+  lock.Acquire();
+  if( idle_count < PKG_HTTP_MAX_IDLE )
+  {
+    conn->next = idle;
+    idle = conn;
+    ++idle_count;
+    conn = NULL;
+  }
+  lock.Release();
+  Discard( conn );
+}
+
+void pkgHttpTransportAgent::Discard( pkgHttpConnection *conn )
+{
+  /* Close a connection, and release its resources.
+   */
+  if( conn != NULL )
+  {
+    closesocket( conn->fd );
+    free( conn->host );
+    free( conn );
+  }
+}
+
+pkgHttpTransportAgent::~pkgHttpTransportAgent()
+{
+  /* Close all idle connections, when the transport is destroyed.
+   */
+  while( idle != NULL )
+  {
+    pkgHttpConnection *conn = idle;
+    idle = conn->next;
+    Discard( conn );
+  }
+# ifdef _WIN32
+  if( started )
+    WSACleanup();
+# endif
+}
+
+pkgHttpResource::pkgHttpResource
+( pkgHttpTransportAgent *owner, pkgHttpConnection *connection ):
+agent( owner ), conn( connection ), status( 0 ), content_length( 0 ),
+remaining( 0 ), offset( 0 ), chunked( false ), sized( false ),
+reusable( false ), done( false ), location( NULL ), etag( NULL ),
+timestamp( NULL ){}
+
+pkgHttpResource::~pkgHttpResource()
+{
+  /* When the response has been completely consumed, and the server
+   * has not asked us to close the connection, we may keep it for use
+   * by a subsequent request; otherwise, we must close it.
+   */
+  if( done && reusable )
+    agent->Release( conn );
+  else
+    pkgHttpTransportAgent::Discard( conn );
+  free( timestamp );
+  free( location );
+  free( etag );
+}
+
+const char *pkgHttpResource::Validator()
+{
+  /* The server may have provided either an entity tag, or a time stamp,
+   * (or both), to identify the entity; we prefer the entity tag, but a
+   * weak tag is not acceptable for validating range requests.
+   */
+  if( (etag != NULL) && (strncmp( etag, "W/", 2 ) != 0) )
+    return etag;
+  return timestamp;
+}
+
+int pkgHttpResource::Fill()
+{
+  /* Private helper to refill the connection's input buffer, when it
+   * has been exhausted; returns the number of bytes available, which
+   * is zero at end of stream, or negative on error.
+   */
+  if( conn->head < conn->tail )
+    return conn->tail - conn->head;
+
+  int count = recv( conn->fd, conn->buf, sizeof( conn->buf ), 0 );
+  conn->head = 0; conn->tail = (count > 0) ? count : 0;
+  return count;
+}
+
+int pkgHttpResource::GetLine( char *buf, size_t max )
+{
+  /* Private helper to read one CRLF (or LF) terminated line, of which
+   * we retain at most "max - 1" characters, discarding the terminator;
+   * returns the retained length, or -1 if the stream ends first.
+   */
+  size_t len = 0;
+  while( Fill() > 0 )
+  {
+    char c = conn->buf[conn->head++];
+    if( c == '\n' )
+    {
+      if( (len > 0) && (buf[len - 1] == '\r') )
+	--len;
+      buf[len] = '\0';
+      return len;
+    }
+    if( len < max - 1 )
+      buf[len++] = c;
+  }
+  return -1;
+}
+
+int pkgHttpResource::GetData( char *buf, size_t max )
+{
+  /* Private helper to read raw response body data, using any content
+   * which remains buffered, before reading directly from the stream.
+   */
+  if( conn->head < conn->tail )
+  {
+    size_t count = conn->tail - conn->head;
+    if( count > max ) count = max;
+    memcpy( buf, conn->buf + conn->head, count );
+    conn->head += count;
+    return count;
+  }
+  return recv( conn->fd, buf, max, 0 );
+}
+
+bool pkgHttpResource::Request
+( const char *host, const char *path, unsigned long start, const char *match )
+{
+  /* Issue a GET request for the specified resource, and interpret the
+   * response headers; returns false if either the request could not be
+   * sent, or no valid response was received.  When resuming, we ask for
+   * the range starting at the specified offset, but only if the entity
+   * still matches the validator; otherwise, we get the whole entity.
+   */
+  char range[48 + ((match != NULL) ? strlen( match ) : 0)];
+  if( (start > 0) && (match != NULL) )
+    sprintf( range, "Range: bytes=%lu-\r\nIf-Range: %s\r\n", start, match );
+  else
+    *range = '\0';
+
+  char line[2048];
+  int len = snprintf( line, sizeof( line ),
+      "GET %s HTTP/1.1\r\nHost: %s\r\n%s"
+      "User-Agent: MinGW Installer\r\nAccept-Encoding: identity\r\n\r\n",
+      path, host, range
+    );
+  if( (len < 0) || (len >= (int)(sizeof( line ))) )
+    return false;
+
+  const char *p = line;
+  while( len > 0 )
+  {
+    int count = send( conn->fd, p, len, MSG_NOSIGNAL );
+    if( count <= 0 )
+      return false;
+    p += count; len -= count;
+  }
+
+  /* Interpret the status line; HTTP/1.1 servers keep the connection
+   * alive by default, but HTTP/1.0 servers do not.
+   */
+  int minor;
+  if( (GetLine( line, sizeof( line ) ) < 0)
+  ||  (sscanf( line, "HTTP/1.%d %lu", &minor, &status ) != 2) )
+    return false;
+  reusable = (minor > 0);
+
+  while( (len = GetLine( line, sizeof( line ) )) > 0 )
+  {
+    /* Interpret each header, in turn, until we find the blank line
+     * which marks the end of the response headers.
+     */
+    char *value;
+    if( (value = strchr( line, ':' )) == NULL )
+      continue;
+    *value++ = '\0';
+    while( isspace( *value ) )
+      ++value;
+
+    if( strcasecmp( line, "content-length" ) == 0 )
+    {
+      remaining = content_length = strtoul( value, NULL, 10 );
+      sized = true;
+    }
+    else if( strcasecmp( line, "transfer-encoding" ) == 0 )
+      chunked = (strncasecmp( value, "chunked", 7 ) == 0);
+
+    else if( strcasecmp( line, "connection" ) == 0 )
+    {
+      if( strncasecmp( value, "close", 5 ) == 0 )
+	reusable = false;
+      else if( strncasecmp( value, "keep-alive", 10 ) == 0 )
+	reusable = true;
+    }
+    else if( strcasecmp( line, "location" ) == 0 )
+    {
+      free( location );
+      location = strdup( value );
+    }
+    else if( strcasecmp( line, "etag" ) == 0 )
+    {
+      free( etag );
+      etag = strdup( value );
+    }
+    else if( strcasecmp( line, "last-modified" ) == 0 )
+    {
+      free( timestamp );
+      timestamp = strdup( value );
+    }
+    else if( strcasecmp( line, "content-range" ) == 0 )
+      /*
+       * This is of the form "bytes first-last/total"; we need only
+       * the offset of the first byte.
+       */
+      sscanf( value, "bytes %lu-", &offset );
+  }
+  if( len < 0 )
+    return false;
+
+  /* A chunked encoding takes precedence over any content length; a body
+   * which is neither chunked nor sized is delimited by connection close.
+   */
+  if( chunked )
+    sized = false, content_length = 0;
+  else if( ! sized )
+    reusable = false;
+  done = sized && (remaining == 0);
+  return true;
+}
+
+int pkgHttpResource::Read( char *buf, size_t max, unsigned long *count )
+{
+  /* Read response body data, decoding any chunked transfer encoding;
+   * returns non-zero on success, (with a count of zero at the end of
+   * the data), or zero on failure.
+   */
+  int len = 0;
+  if( ! done )
+  {
+    if( chunked && (remaining == 0) )
+    {
+      /* We are at the start of a new chunk; read its size...
+       */
+      char line[64];
+      if( GetLine( line, sizeof( line ) ) < 0 )
+	return (*count = 0);
+      if( (remaining = strtoul( line, NULL, 16 )) == 0 )
+      {
+	/* ...but a zero size marks the final chunk; discard any
+	 * trailing headers, which follow it.
+	 */
+	while( (len = GetLine( line, sizeof( line ) )) > 0 )
+	  ;
+	*count = 0;
+	return done = (len == 0);
+      }
+    }
+    if( (sized || chunked) && (max > remaining) )
+      max = remaining;
+
+    if( (len = GetData( buf, max )) < 0 )
+      return (*count = 0);
+
+    if( sized || chunked )
+    {
+      /* A premature end of stream is an error, when we know how much
+       * data to expect...
+       */
+      if( len == 0 )
+	return (*count = 0);
+
+      if( (remaining -= len) == 0 )
+      {
+	if( sized )
+	  done = true;
+
+	else
+	{ /* ...and the data of each chunk is followed by a CRLF.
+	   */
+	  char line[8];
+	  if( GetLine( line, sizeof( line ) ) < 0 )
+	    return (*count = 0);
+	}
+      }
+    }
+    else if( len == 0 )
+      /*
+       * Otherwise, end of stream marks the end of data.
+       */
+      done = true;
+  }
+  *count = len;
+  return 1;
+}
+
+void pkgHttpResource::Drain()
+{
+  /* Discard any (small) response body which we don't want, (such as
+   * that accompanying a redirection), so the connection may be reused;
+   * for a large, or unbounded body, we simply abandon the connection.
+   */
+  char buf[1024]; unsigned long count;
+  unsigned long limit = sizeof( conn->buf ) << 3;
+  while( ! done && (limit > 0) && Read( buf, sizeof( buf ), &count ) && count )
+    limit = (limit > count) ? limit - count : 0;
+}
+
+pkgInternetResource *pkgHttpTransportAgent::Open
+( const char *url, unsigned long offset, const char *validator )
+{
+  /* Open an "http:" URL, following any redirection, and reusing any
+   * idle connection to the appropriate host.
+   */
+  char *target = strdup( url );
+  pkgHttpResource *resource = NULL;
+  int redirects = PKG_HTTP_MAX_REDIRECT;
+  while( (target != NULL) && match_scheme( target, "http://" ) )
+  {
+    /* Decompose the URL into host, port and path components; we keep
+     * the original authority, for the request's Host header, (which
+     * must include any explicit port, and IPv6 address brackets).
+     */
+    const char *authority = target + 7;
+    const char *path = authority + strcspn( authority, "/?#" );
+    int authlen = path - authority;
+    char host[1 + authlen], host_header[1 + authlen];
+    unsigned port = 80;
+    memcpy( host, authority, authlen ); host[authlen] = '\0';
+    strcpy( host_header, host );
+    char *colon = strrchr( host, ':' );
+    if( (colon != NULL) && (strchr( colon, ']' ) == NULL) )
+    {
+      *colon++ = '\0';
+      port = strtoul( colon, NULL, 10 );
+    }
+    if( (*host == '[') && (host[strlen( host ) - 1] == ']') )
+    {
+      /* IPv6 literal addresses are enclosed in brackets, in the URL,
+       * but getaddrinfo() doesn't want them.
+       */
+      host[strlen( host ) - 1] = '\0';
+      memmove( host, host + 1, strlen( host ) );
+    }
+    if( *path != '/' )
+      path = "/";
+
+    /* Issue the request; if it fails on a connection which we have
+     * reused, the server may simply have closed it while it was idle,
+     * so we retry once, on a fresh connection, (as we also do if the
+     * first attempt fails on a new connection).
+     */
+    bool reused = false;
+    pkgHttpConnection *conn;
+    for( int attempt = 0; attempt < 2; ++attempt )
+    {
+      conn = (attempt == 0) ? Acquire( host, port, &reused ) : Connect( host, port );
+      if( conn != NULL )
+      {
+	resource = new pkgHttpResource( this, conn );
+	if( resource->Request( host_header, path, offset, validator ) )
+	  break;
+
+	/* We didn't get a valid response; discard the resource, (and
+	 * with it, the connection).
+	 */
+	delete resource; resource = NULL;
+      }
+      DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	  dmh_printf( "%s: request failed on %s connection\n",
+	    target, ((attempt == 0) && reused) ? "reused" : "new"
+	  ));
+    }
+
+    /* When the response specifies a redirection, follow it; a relative
+     * location is resolved against the URL we requested.
+     */
+    unsigned long status = (resource != NULL) ? resource->Status() : 0;
+    if( (status >= 300) && (status < 400) && (status != 304)
+    &&  (resource->Location() != NULL) && (--redirects >= 0)  )
+    {
+      const char *location = resource->Location();
+      char *next = (char *)(malloc( 6 + strlen( target ) + strlen( location ) ));
+      if( next != NULL )
+      {
+	if( has_scheme( location ) )
+	  /*
+	   * The location is absolute; it is used as is...
+	   */
+	  strcpy( next, location );
+
+	else if( (location[0] == '/') && (location[1] == '/') )
+	  /*
+	   * ...a network path reference retains only our scheme...
+	   */
+	  sprintf( next, "http:%s", location );
+
+	else if( *location == '/' )
+	  /*
+	   * ...an absolute path reference retains our authority...
+	   */
+	  sprintf( next, "http://%.*s%s", authlen, authority, location );
+
+	else
+	{ /* ...while any other is relative to the directory of the
+	   * path we requested, (which always begins with a '/').
+	   */
+	  int dirlen = strcspn( path, "?#" );
+	  while( path[dirlen - 1] != '/' ) --dirlen;
+	  sprintf( next, "http://%.*s%.*s%s", authlen, authority, dirlen, path, location );
+	}
+      }
+      DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ),
+	  dmh_printf( "%s: redirected to %s\n", target, next ? next : location )
+	);
+      resource->Drain();
+      if( (next != NULL) && ! match_scheme( next, "http://" ) )
+      {
+	/* We cannot follow a redirection to any other scheme, (typically
+	 * "https:"); return the redirection response, so that the caller
+	 * may pass its location to a transport which can.
+	 */
+	free( next );
+	break;
+      }
+      delete resource; resource = NULL;
+      free( target ); target = next;
+    }
+    else break;
+  }
+  free( target );
+  return resource;
+}
+
+/* These are the one and only instantiations of the transport agents;
+ * their accessors are provided for use by the download machinery.
+ */
+static pkgFileTransportAgent file_transport;
+static pkgHttpTransportAgent http_transport;
+
+pkgInternetTransport *pkgFileTransport(){ return &file_transport; }
+pkgInternetTransport *pkgHttpTransport(){ return &http_transport; }
+
+/* $RCSfile: pkgxfer.cpp,v $: end of file */
@@ -0,0 +1,101 @@
+#ifndef PKGXFER_H
+/*
+ * pkgxfer.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW Project
+ *
+ *
+ * Declarations of the abstract interfaces, through which the package
+ * download machinery retrieves data from internet, (or local), hosts;
+ * also declares accessors for the portable transports which implement
+ * these interfaces, independently of the MS-Windows wininet API.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define PKGXFER_H  1
+
+#include <stddef.h>
+
+class pkgInternetResource
+{
+  /* Abstract base class, representing a single resource which has
+   * been opened by a transport; data is read from it sequentially, and
+   * it is closed, (or its connection is released for reuse, where the
+   * transport supports this), when the object is deleted.
+   */
+  public:
+    virtual ~pkgInternetResource(){}
+
+    /* The status is expressed as an HTTP status code, regardless of
+     * the actual transport protocol; (thus 200 represents success).
+     */
+    virtual unsigned long Status() = 0;
+
+    /* The expected size of the resource, or zero if unknown.
+     */
+    virtual unsigned long ContentLength() = 0;
+
+    /* Read up to the specified number of bytes, returning the count
+     * actually read, (which is zero at end of data); as for wininet's
+     * InternetReadFile(), the return value is non-zero on success.
+     */
+    virtual int Read( char*, size_t, unsigned long* ) = 0;
+
+    /* When a partial response, (status 206), is returned, in reply to
+     * a request to resume a download, the first of these returns the
+     * offset of its first byte within the complete entity; the second
+     * returns an entity tag, or time stamp, which may later be used to
+     * verify that the entity is unchanged, when resuming an interrupted
+     * download, (or NULL, if the server provides no such validator).
+     */
+    virtual unsigned long Offset(){ return 0; }
+    virtual const char *Validator(){ return NULL; }
+
+    /* When a transport returns a redirection response, (status 3xx),
+     * because the new location uses a scheme which it doesn't support,
+     * this returns that location, so the caller may pass it on to some
+     * other transport; otherwise, it returns NULL.
+     */
+    virtual const char *Location(){ return NULL; }
+};
+
+class pkgInternetTransport
+{
+  /* Abstract base class, from which each transport is derived; the
+   * single method opens a specified URL, returning NULL on failure.
+   * When a non-zero offset, and a validator returned by an earlier
+   * request, are specified, the transport asks the server to return
+   * only the remainder of the entity, starting at the given offset,
+   * provided the entity still matches the validator; if it does not,
+   * (or the server doesn't support this), the entire entity will be
+   * returned, with status 200, rather than 206.
+   */
+  public:
+    virtual ~pkgInternetTransport(){}
+    virtual pkgInternetResource *Open
+      ( const char*, unsigned long = 0, const char* = NULL ) = 0;
+};
+
+/* Accessors for the portable transports; the first handles "file:"
+ * URLs, while the second handles "http:" URLs, keeping connections
+ * alive for reuse by subsequent requests to the same host.
+ */
+pkgInternetTransport *pkgFileTransport();
+pkgInternetTransport *pkgHttpTransport();
+
+#endif /* PKGXFER_H: $RCSfile: pkgxfer.h,v $: end of file */
@@ -41,8 +41,11 @@
 #include "dmh.h"
 #include "mkpath.h"
 
+#include "pkginfo.h"
 #include "pkgbase.h"
 #include "pkgkeys.h"
+#include "pkgownr.h"
+#include "pkgproc.h"
 
 #include "debug.h"
 
@@ -113,6 +116,292 @@ static bool samepath( const char *tstpath, const char *refpath )
   return (*tstpath == *refpath);
 }
 
+class pkgInstallationIndex
+{
+  /* A locally implemented class, providing a hashed index of all
+   * installation records within one sysroot record, keyed on their
+   * canonical tarnames, so that the installation status of any package
+   * release may be established without walking all such records.
+   */
+  public:
+    pkgInstallationIndex( pkgXmlNode* );
+    ~pkgInstallationIndex();
+
+    pkgXmlNode *Lookup( const char* );
+    void Add( pkgXmlNode* );
+    void Remove( pkgXmlNode* );
+
+  private:
+    struct entry
+    {
+      entry		*next;
+      pkgXmlNode	*node;
+      unsigned long	 hash;
+    };
+    entry **table;
+    unsigned long size, count;
+};
+
+pkgInstallationIndex::pkgInstallationIndex( pkgXmlNode *sysroot ):
+table( NULL ), size( 64 ), count( 0 )
+{
+  /* Constructor: allocate the initial hash table, then index all of
+   * the installation records which are already attached to the sysroot.
+   */
+  if( (table = (entry **)(calloc( size, sizeof( entry * ) ))) != NULL )
+  {
+    pkgXmlNode *ref = sysroot->FindFirstAssociate( installed_key );
+    while( ref != NULL )
+    {
+      Add( ref );
+      ref = ref->FindNextAssociate( installed_key );
+    }
+  }
+}
+
+void pkgInstallationIndex::Add( pkgXmlNode *record )
+{
+  /* Add a single installation record to the index, growing the hash
+   * table as required, to keep the average chain length below two; we
+   * append to the end of each chain, so that any duplicate records are
+   * found in document order.
+   */
+  const char *tarname;
+  if( (table == NULL) || ((tarname = record->GetPropVal( tarname_key, NULL )) == NULL) )
+    return;
+
+  if( count >= (size << 1) )
+  {
+    unsigned long new_size = size << 1;
+    entry **new_table = (entry **)(calloc( new_size, sizeof( entry * ) ));
+    if( new_table != NULL )
+    {
+      /* Preserve the order of each chain, as we rehash it.
+       */
+      entry **tail[new_size];
+      for( unsigned long i = 0; i < new_size; i++ )
+	tail[i] = new_table + i;
+      for( unsigned long i = 0; i < size; i++ )
+	while( table[i] != NULL )
+	{
+	  entry *ref = table[i]; table[i] = ref->next;
+	  unsigned long slot = ref->hash & (new_size - 1);
+	  ref->next = NULL; *tail[slot] = ref; tail[slot] = &ref->next;
+	}
+      free( (void *)(table) );
+      table = new_table; size = new_size;
+    }
+  }
+
+  entry *ref = (entry *)(malloc( sizeof( entry ) ));
+  if( ref != NULL )
+  {
+    entry **slot;
+    ref->next = NULL; ref->node = record;
+    ref->hash = pkg_name_hash( tarname, strlen( tarname ) );
+    for( slot = table + (ref->hash & (size - 1)); *slot != NULL; slot = &(*slot)->next )
+      ;
+    *slot = ref; ++count;
+  }
+}
+
+void pkgInstallationIndex::Remove( pkgXmlNode *record )
+{
+  /* Remove a single installation record from the index; (this must
+   * be done before the record itself is deleted).
+   */
+  const char *tarname;
+  if( (table != NULL) && ((tarname = record->GetPropVal( tarname_key, NULL )) != NULL) )
+  {
+    entry **slot = table + (pkg_name_hash( tarname, strlen( tarname ) ) & (size - 1));
+    while( (*slot != NULL) && ((*slot)->node != record) )
+      slot = &(*slot)->next;
+    if( *slot != NULL )
+    {
+      entry *ref = *slot; *slot = ref->next;
+      free( ref ); --count;
+    }
+  }
+}
+
+pkgXmlNode *pkgInstallationIndex::Lookup( const char *tarname )
+{
+  /* Retrieve the first installation record, if any, which matches
+   * the specified canonical tarname.
+   */
+  if( (table != NULL) && (tarname != NULL) )
+  {
+    unsigned long hash = pkg_name_hash( tarname, strlen( tarname ) );
+    for( entry *ref = table[hash & (size - 1)]; ref != NULL; ref = ref->next )
+      if( (ref->hash == hash)
+      &&  (strcmp( ref->node->GetPropVal( tarname_key, "" ), tarname ) == 0)  )
+	return ref->node;
+  }
+  return NULL;
+}
+
+pkgInstallationIndex::~pkgInstallationIndex()
+{
+  /* Destructor: release all index entries, and the table itself.
+   */
+  if( table != NULL )
+    for( unsigned long i = 0; i < size; i++ )
+      while( table[i] != NULL )
+      {
+	entry *ref = table[i]; table[i] = ref->next;
+	free( ref );
+      }
+  free( (void *)(table) );
+}
+
+class pkgSysRootMap
+{
+  /* A locally implemented class, recording the binding of each subsystem
+   * declared in the active system map, to its sysroot record, together
+   * with the path name of that sysroot, with any macros expanded; this is
+   * resolved once, when the system map is loaded, rather than on every
+   * GetSysRoot() look-up.  Since most look-ups, within any one session,
+   * are for the same subsystem, we also remember the most recent.  Each
+   * distinct sysroot record is also given an index of its installation
+   * records, (shared by all subsystems which are bound to it).
+   */
+  public:
+    pkgSysRootMap( pkgXmlNode* );
+    ~pkgSysRootMap();
+
+    pkgXmlNode *Lookup( const char*, const char** );
+    pkgInstallationIndex *Installed( pkgXmlNode* );
+
+  private:
+    struct binding
+    {
+      const char		*subsystem;
+      pkgXmlNode		*record;
+      char			*path;
+      pkgInstallationIndex	*installed;
+      bool			owner;
+    } *map;
+    unsigned bindings;
+
+    char *last_subsystem;
+    struct binding *last;
+};
+
+pkgSysRootMap::pkgSysRootMap( pkgXmlNode *dbase ):
+map( NULL ), bindings( 0 ), last_subsystem( NULL ), last( NULL )
+{
+  /* Constructor: we are interested only in the first system map, (which,
+   * after LoadSystemMap() has run, should be the only one); walk its list
+   * of sysroot entries...
+   */
+  pkgXmlNode *sysmap, *sysroot;
+  if( (dbase == NULL) || ((sysmap = dbase->FindFirstAssociate( sysmap_key )) == NULL) )
+    return;
+
+  unsigned limit = 0;
+  for( sysroot = sysmap->FindFirstAssociate( sysroot_key ); sysroot != NULL;
+       sysroot = sysroot->FindNextAssociate( sysroot_key ) ) ++limit;
+  if( (limit == 0) || ((map = (struct binding *)(malloc( limit * sizeof( *map ) ))) == NULL) )
+    return;
+
+  for( sysroot = sysmap->FindFirstAssociate( sysroot_key ); sysroot != NULL;
+       sysroot = sysroot->FindNextAssociate( sysroot_key ) )
+  {
+    /* ...retrieving the sysroot path specification from each...
+     */
+    const char *sysroot_path;
+    if( (sysroot_path = sysroot->GetPropVal( pathname_key, NULL )) != NULL )
+    {
+      /* ...which we then use as an identifying reference, to select
+       * the associated sysroot record, (if any), at the top level in the
+       * internal XML database.
+       */
+      pkgXmlNode *lookup = dbase->FindFirstAssociate( sysroot_key );
+      while( (lookup != NULL)
+      && ! samepath( sysroot_path, lookup->GetPropVal( pathname_key, NULL )) )
+	lookup = lookup->FindNextAssociate( sysroot_key );
+
+      if( lookup != NULL )
+      {
+	/* We found it; record the binding, noting that the recorded path
+	 * name is likely to include macros such as "%R", so we filter it
+	 * through mkpath(), to expand them.
+	 */
+	const char *nothing = "";
+	struct binding *ref = map + bindings++;
+	ref->subsystem = sysroot->GetPropVal( subsystem_key, NULL );
+	ref->record = lookup;
+	if( (ref->path = (char *)(malloc( mkpath( NULL, sysroot_path, nothing, NULL ) ))) != NULL )
+	  mkpath( ref->path, sysroot_path, nothing, NULL );
+
+	/* When the sysroot record is already bound to any other subsystem,
+	 * share its installation index, otherwise create a new one, noting
+	 * that this binding owns it, and is responsible for its deletion.
+	 */
+	if( (ref->owner = ((ref->installed = Installed( lookup )) == NULL)) )
+	  ref->installed = new pkgInstallationIndex( lookup );
+      }
+    }
+  }
+}
+
+pkgXmlNode *pkgSysRootMap::Lookup( const char *subsystem, const char **path )
+{
+  /* Retrieve the sysroot record, (and optionally, its path name), for
+   * the specified subsystem; if this is the same as that most recently
+   * requested, the answer is already known...
+   */
+  if( (last == NULL) || (subsystem == NULL) || (last_subsystem == NULL)
+  ||  (strcmp( subsystem, last_subsystem ) != 0)  )
+  {
+    /* ...otherwise, we select the first binding which matches, (which
+     * may be any binding, when the subsystem is unspecified), and note
+     * it for any subsequent request for the same subsystem.
+     */
+    struct binding *ref = map;
+    while( (ref < map + bindings) && ! subsystem_strcmp( subsystem, ref->subsystem ) )
+      ++ref;
+    if( ref == map + bindings )
+      ref = NULL;
+
+    free( last_subsystem );
+    last_subsystem = (subsystem != NULL) ? strdup( subsystem ) : NULL;
+    last = ref;
+  }
+  if( path != NULL )
+    *path = (last != NULL) ? last->path : NULL;
+  return (last != NULL) ? last->record : NULL;
+}
+
+pkgInstallationIndex *pkgSysRootMap::Installed( pkgXmlNode *sysroot )
+{
+  /* Retrieve the installation index for the specified sysroot record;
+   * in the common case, this is the record most recently looked up.
+   */
+  if( (last != NULL) && (last->record == sysroot) )
+    return last->installed;
+  for( unsigned index = 0; index < bindings; index++ )
+    if( map[index].record == sysroot )
+      return map[index].installed;
+  return NULL;
+}
+
+pkgSysRootMap::~pkgSysRootMap()
+{
+  /* Destructor: release the expanded path names, the installation
+   * indexes, (each shared index being deleted only by the binding which
+   * owns it), and the map itself.
+   */
+  for( unsigned index = 0; index < bindings; index++ )
+  {
+    if( map[index].owner )
+      delete map[index].installed;
+    free( map[index].path );
+  }
+  free( map );
+  free( last_subsystem );
+}
+
 EXTERN_C int pkgPutEnv( int flags, char *varspec )
 {
   /* A helper routine for registration of sysroot path to
@@ -190,8 +479,10 @@ void pkgXmlDocument::LoadSystemMap()
   pkgXmlNode *sysroot = dbase->FindFirstAssociate( sysroot_key );
 
   /* First, we clear out any pre-existing sysroot mappings,
-   * which may have been inherited from a previous system map...
+   * which may have been inherited from a previous system map,
+   * (including the map of subsystem bindings to sysroots)...
    */
+  DiscardSysRootMap();
   while( sysroot != NULL )
   {
     /* This has the side effect of leaving the sysroot pointer
@@ -328,10 +619,10 @@ void pkgXmlDocument::LoadSystemMap()
 		    &&  samepath( root->GetPropVal( pathname_key, NULL ), path )  )
 		    {
 		      /* This is the sysroot record we require...
-		       * Copy its root element into the internal database,
+		       * Move its root element into the internal database,
 		       * and force an early exit from the retry loop.
 		       */
-		      dbase->AddChild( root->Clone() );
+		      dbase->AdoptChild( root );
 		      retry = 16;
 		    }
 		  }
@@ -414,6 +705,11 @@ void pkgXmlDocument::LoadSystemMap()
       dbase->DeleteChild( to_clear );
     }
   }
+
+  /* Finally, resolve the binding of each subsystem declared in the
+   * system map we loaded, to its sysroot record, once and for all.
+   */
+  sysroot_map = new pkgSysRootMap( dbase );
 }
 
 void pkgXmlDocument::UpdateSystemMap()
@@ -460,63 +756,142 @@ void pkgXmlDocument::UpdateSystemMap()
      */
     entry = entry->FindNextAssociate( sysroot_key );
   }
+
+  /* Finally, save the file ownership indexes for all sysroots, and
+   * the manifest index, so that they remain in step with the
+   * installation records.
+   */
+  pkgOwnershipIndex::Commit();
+  pkgManifest::CommitIndex();
 }
 
-pkgXmlNode* pkgXmlNode::GetSysRoot( const char *subsystem )
+void pkgXmlDocument::DiscardSysRootMap()
+{
+  /* Discard the sysroot map, if any; (it will be reconstructed when
+   * next required).
+   */
+  delete sysroot_map;
+  sysroot_map = NULL;
+}
+
+pkgXmlNode* pkgXmlDocument::GetSysRoot( const char *subsystem, const char **path )
 {
   /* Retrieve the installation records for the system root associated
-   * with the specified software subsystem.
+   * with the specified software subsystem, (and, if requested, the path
+   * name of that system root), from the sysroot map; this is normally
+   * constructed by LoadSystemMap(), but if that has not been called, we
+   * construct it now.
+   */
+  if( sysroot_map == NULL )
+    sysroot_map = new pkgSysRootMap( GetRoot() );
+  return sysroot_map->Lookup( subsystem, path );
+}
+
+pkgXmlNode* pkgXmlNode::GetSysRoot( const char *subsystem, const char **path )
+{
+  /* Convenience method, to retrieve the installation records for
+   * the system root associated with the specified software subsystem,
+   * from the document to which this node belongs; (every XML document
+   * within the application is a pkgXmlDocument).
+   */
+  pkgXmlDocument *dbase;
+  if( (this != NULL) && ((dbase = (pkgXmlDocument *)(GetDocument())) != NULL) )
+    return dbase->GetSysRoot( subsystem, path );
+
+  /* If we get to here, we didn't find any appropriate system root
+   * record; return NULL to signal this.
+   */
+  if( path != NULL )
+    *path = NULL;
+  return NULL;
+}
+
+pkgInstallationIndex *pkgXmlDocument::GetInstallationIndex( pkgXmlNode *sysroot )
+{
+  /* Retrieve the index of installation records for the specified
+   * sysroot record, (constructing the sysroot map, if necessary).
+   */
+  if( sysroot_map == NULL )
+    sysroot_map = new pkgSysRootMap( GetRoot() );
+  return sysroot_map->Installed( sysroot );
+}
+
+static inline
+pkgInstallationIndex *installation_index( pkgXmlNode *sysroot )
+{
+  /* Local helper, to retrieve the installation index, (if any),
+   * for a sysroot record, from the document to which it belongs.
+   */
+  pkgXmlDocument *dbase = (pkgXmlDocument *)(sysroot->GetDocument());
+  return (dbase != NULL) ? dbase->GetInstallationIndex( sysroot ) : NULL;
+}
+
+pkgXmlNode *pkgXmlNode::AddInstallationRecord( pkgXmlNode *record )
+{
+  /* Attach a new installation record to this sysroot record, and
+   * add it to the installation index, if any.
+   */
+  pkgInstallationIndex *index = installation_index( this );
+  if( (record = AddChild( record )) != NULL && index != NULL )
+    index->Add( record );
+  return record;
+}
+
+void pkgXmlNode::DeleteInstallationRecord( pkgXmlNode *record )
+{
+  /* Remove an installation record from the installation index, if
+   * any, for this sysroot record, before deleting it.
+   */
+  pkgInstallationIndex *index = installation_index( this );
+  if( index != NULL )
+    index->Remove( record );
+  DeleteChild( record );
+}
+
+pkgXmlNode *pkgXmlNode::GetInstallationRecord( const char *pkgname )
+{
+  /* Retrieve the installation record, if any, for the package
+   * specified by fully qualified canonical 'pkgname'.
    *
-   * Note that, by the time this is called, there should be exactly
-   * one system map entry remaining in the internal XML database, so
-   * we need only find the first such entry.
+   * First, break down the specified package name, and retrieve
+   * the sysroot database entry for its associated subsystem.
    */
-  pkgXmlNode *dbase, *sysmap;
-  if( ((dbase = GetDocumentRoot()) != NULL)
-  &&  ((sysmap = dbase->FindFirstAssociate( sysmap_key )) != NULL)  )
+  pkgXmlNode *sysroot;
+  pkgSpecs lookup( pkgname );
+  if( (sysroot = GetSysRoot( lookup.GetSubSystemName() )) != NULL )
   {
-    /* We've located the system map; walk its list of sysroot entries...
+    /* We successfully retrieved a sysroot entry; normally, we may
+     * simply consult its installation index...
+     */
+    pkgInstallationIndex *index = installation_index( sysroot );
+    if( index != NULL )
+      return index->Lookup( pkgname );
+
+    /* ...but, in the absence of any index, we must search the
+     * associated list of installed packages, for one with the
+     * appropriate canonical package name.
      */
-    pkgXmlNode *sysroot = sysmap->FindFirstAssociate( sysroot_key );
-    while( sysroot != NULL )
+    pkgXmlNode *pkg = sysroot->FindFirstAssociate( installed_key );
+    while( pkg != NULL )
     {
-      /* ...until we find one for the subsystem of interest...
+      /* We found an installed package entry; check if it has
+       * the correct canonical name...
        */
-      if( subsystem_strcmp( subsystem, sysroot->GetPropVal( subsystem_key, NULL )) )
-      {
-	/* ...from which we retrieve the sysroot path specification...
+      const char *installed = pkg->GetPropVal( tarname_key, NULL );
+      if( (installed != NULL) && (strcmp( installed, pkgname ) == 0) )
+	/*
+	 * ...returning this entry if so...
 	 */
-	const char *sysroot_path;
-	if( (sysroot_path = sysroot->GetPropVal( pathname_key, NULL )) != NULL )
-	{
-	  /* ...which we then use as an identifying reference...
-	   */
-	  pkgXmlNode *lookup = dbase->FindFirstAssociate( sysroot_key );
-	  while( lookup != NULL )
-	  {
-	    /* ...to select and return the associated sysroot record
-	     * (if any) at the top level in the internal XML database.
-	     */
-	    if( samepath( sysroot_path, lookup->GetPropVal( pathname_key, NULL )) )
-	      return lookup;
-
-	    /* We haven't found the required sysroot record yet...
-	     * move on to the next available.
-	     */
-	    lookup = lookup->FindNextAssociate( sysroot_key );
-	  }
-	}
-      }
+	return pkg;
 
-      /* We are still looking for a matching sysroot entry in the
-       * system map; move on to the next candidate.
+      /* ...otherwise, move on to the next entry, if any.
        */
-      sysroot = sysroot->FindNextAssociate( sysroot_key );
+      pkg = pkg->FindNextAssociate( installed_key );
     }
   }
 
-  /* If we get to here, we didn't find any appropriate system root
-   * record; return NULL to signal this.
+  /* If we get to here, we didn't find an entry for the required
+   * package; return NULL, indicating that it is not installed.
    */
   return NULL;
 }
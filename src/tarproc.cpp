@@ -35,6 +35,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <zlib.h>
 
 #include "dmh.h"
 #include "debug.h"
@@ -42,6 +43,7 @@
 
 #include "pkginfo.h"
 #include "pkgkeys.h"
+#include "pkgownr.h"
 #include "pkgproc.h"
 
 /*******************
@@ -93,14 +95,18 @@ int pkgArchiveProcessor::ExtractFile( int fd, const char *pathname, int status )
  * Class Implementation: pkgTarArchiveProcessor
  *
  */
-pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
+pkgTarArchiveProcessor::pkgTarArchiveProcessor
+( pkgXmlNode *pkg, pkgArchiveStream *feed )
 {
   /* Constructor to associate a package tar archive with its
    * nominated sysroot and respective installation directory path,
    * and prepare it for processing, using an appropriate streaming
    * decompression filter; (choice of filter is based on archive
    * file name extension; file names are restricted to the
-   * POSIX Portable Character Set).
+   * POSIX Portable Character Set).  When a "feed" stream is
+   * specified, (e.g. to deliver the archive directly from its
+   * repository host, as it is downloaded), we adopt it, in place
+   * of the archive file from the local package cache.
    *
    * First, we anticipate an invalid initialisation state...
    */
@@ -110,6 +116,8 @@ pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
   sysroot_path = NULL;
   installed = NULL;
   stream = NULL;
+  writer = NULL;
+  retained = NULL;
 
   /* The 'pkg' XML database entry must be non-NULL, must
    * represent a package release, and must specify a canonical
@@ -151,20 +159,29 @@ pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
     /* Finally, initialise the data stream which we will use
      * for reading the package content.
      */
-    const char *archive_path_template = pkgArchivePath();
-    char archive_path_name[mkpath( NULL, archive_path_template, pkgfile, NULL )];
-    mkpath( archive_path_name, archive_path_template, pkgfile, NULL );
-    stream = pkgOpenArchiveStream( archive_path_name );
+    if( (stream = feed) == NULL )
+    {
+      const char *archive_path_template = pkgArchivePath();
+      char archive_path_name[mkpath( NULL, archive_path_template, pkgfile, NULL )];
+      mkpath( archive_path_name, archive_path_template, pkgfile, NULL );
+      stream = pkgOpenArchiveStream( archive_path_name );
+    }
   }
+  else
+    /* We cannot use any "feed" stream we were given; since we
+     * are nonetheless responsible for it, we must discard it.
+     */
+    delete feed;
 }
 
 pkgTarArchiveProcessor::~pkgTarArchiveProcessor()
 {
-  /* Destructor must release the heap memory allocated in
-   * the constructor, (by strdup and pkgManifest), clean up
-   * the decompression filter state, and close the archive
-   * data stream.
+  /* Destructor must shut down the writer pipeline, if any,
+   * release the heap memory allocated in the constructor, (by
+   * strdup and pkgManifest), clean up the decompression filter
+   * state, and close the archive data stream.
    */
+  FlushExtractedEntities();
   free( (void *)(sysroot_path) );
   delete installed;
   delete stream;
@@ -374,22 +391,27 @@ int pkgTarArchiveProcessor::Process()
 	    "unexpected archive entry classification: type %d\n",
 	    (int)(*header.field.typeflag)
 	  );
+	FlushExtractedEntities();
 	return -1;
     }
   }
   /* If we didn't bail out before getting to here, then the archive
-   * was processed successfully; return the success code.
+   * was processed successfully; ensure that all extracted files have
+   * been written, and recorded, before we return the success code.
    */
+  FlushExtractedEntities();
   return 0;
 }
 
-int pkgTarArchiveProcessor::ProcessEntityData( int fd )
+int pkgTarArchiveProcessor::ProcessEntityData( int fd, uint32_t *checksum )
 {
   /* Generic method for reading past the data associated with
    * a specific header within a tar archive; if given a negative
    * value for `fd', it will simply skip over the data, otherwise
    * `fd' is assumed to represent a descriptor for an opened file
-   * stream, to which the data will be copied (extracted).
+   * stream, to which the data will be copied (extracted).  When a
+   * `checksum' reference is given, (initialised to zero), the CRC-32
+   * of the data is accumulated into it.
    */
    int status = 0;
 
@@ -438,9 +460,12 @@ int pkgTarArchiveProcessor::ProcessEntityData( int fd )
       block_size = bytes_to_copy;
 
     /* With the number of actual data bytes present now accurately
-     * reflected by the block size, we save that data to the stream
-     * specified for archive extraction, (if any).
+     * reflected by the block size, we accumulate its checksum, (if
+     * required), and save that data to the stream specified for
+     * archive extraction, (if any).
      */
+    if( checksum != NULL )
+      *checksum = crc32( *checksum, (const Bytef *)(buffer), block_size );
     if( (fd >= 0) && (write( fd, buffer, block_size ) != (int)(block_size)) )
       /*
        * An extraction error occurred; set the status code to
@@ -503,9 +528,11 @@ char *pkgTarArchiveProcessor::EntityDataAsString()
 
 /*******************
  *
- * Class Implementation: pkgTarArchiveExtractor
+ * Class Implementation: pkgExtractionPipeline
  *
  */
+#include <windows.h>
+#include <process.h>
 #include <utime.h>
 
 static int commit_saved_entity( const char *pathname, time_t mtime )
@@ -520,6 +547,487 @@ static int commit_saved_entity( const char *pathname, time_t mtime )
   return utime( pathname, &timestamp );
 }
 
+/* Archives such as w32api, or mingwrt-dev, comprise thousands of small
+ * files; their extraction is dominated by the latency of creating, then
+ * writing, closing, and time stamping each file, rather than by the cost
+ * of decompression.  Thus, while the archive processor continues to read
+ * and decompress the archive, we delegate the writing of each such file
+ * to a small pool of writer threads; the following limits bound the
+ * number of threads, the number of archive entries which may be pending,
+ * the aggregate size of the file data held in memory on their behalf,
+ * and the size of any individual file which may be so delegated; (any
+ * larger file is written directly by the archive processor itself).
+ */
+#define PKG_EXTRACTION_WRITERS		4
+#define PKG_EXTRACTION_SLOTS		256
+#define PKG_EXTRACTION_MEMORY		(16 << 20)
+#define PKG_EXTRACTION_BUFFERED_MAX	(PKG_EXTRACTION_MEMORY >> 2)
+
+class pkgExtractionPipeline
+{
+  /* A locally implemented class, which maintains an ordered queue of
+   * archive entries, in a fixed ring of slots; those which represent
+   * regular files are written by the worker threads, in any order, but
+   * all are retired, (and recorded in the installation manifest, if
+   * any), in archive order, by the archive processor's own thread.
+   */
+  public:
+    pkgExtractionPipeline( pkgManifest*, int );
+    ~pkgExtractionPipeline();
+
+    inline bool CanBuffer( uint64_t size )
+    { return (started > 0) && (size <= PKG_EXTRACTION_BUFFERED_MAX); }
+
+    char *Allocate( const char*, const char*, size_t, int, time_t );
+    void Dispatch( int, uint32_t, bool = false );
+
+    inline void Record( const char *key, const char *pathname )
+    { Append( key, pathname, false, 0, 0, 0 ); }
+
+    inline void Record
+    ( const char *key, const char *pathname, uint64_t size, time_t mtime,
+      uint32_t checksum ){ Append( key, pathname, true, size, mtime, checksum ); }
+
+    inline void Await( const char *pathname ){ Reserve( pathname, 0 ); }
+
+  private:
+    enum { ENTRY_QUEUED, ENTRY_ACTIVE, ENTRY_DONE };
+    struct entry
+    {
+      char		*pathname;
+      const char	*key;
+      char		*data;
+      size_t		 size;
+      int		 mode;
+      time_t		 mtime;
+      uint32_t		 checksum;
+      bool		 content;
+      int		 status;
+      int		 state;
+    } *slot;
+
+    /* Entries are appended at "tail", serviced by the workers from
+     * "next", and retired from "head"; these are free running counters,
+     * which are reduced modulo PKG_EXTRACTION_SLOTS to index "slot".
+     */
+    unsigned head, next, tail;
+    size_t committed;
+
+    pkgManifest *manifest;
+    int sysroot_len;
+
+    CRITICAL_SECTION lock;
+    HANDLE pending, retired;
+    HANDLE thread[PKG_EXTRACTION_WRITERS];
+    unsigned started;
+
+    struct entry *Reserve( const char*, size_t );
+    void Append( const char*, const char*, bool, uint64_t, time_t, uint32_t );
+    void Retire();
+    static unsigned __stdcall Worker( void* );
+};
+
+pkgExtractionPipeline::pkgExtractionPipeline( pkgManifest *inventory, int len ):
+head( 0 ), next( 0 ), tail( 0 ), committed( 0 ), manifest( inventory ),
+sysroot_len( len ), started( 0 )
+{
+  /* Set up the ring of slots, and the synchronisation objects; the
+   * "pending" semaphore counts entries which await a worker, while the
+   * "retired" event is signalled as each worker completes an entry.
+   */
+  InitializeCriticalSection( &lock );
+  slot = (struct entry *)(calloc( PKG_EXTRACTION_SLOTS, sizeof( struct entry ) ));
+  pending = CreateSemaphore
+    ( NULL, 0, PKG_EXTRACTION_SLOTS + PKG_EXTRACTION_WRITERS, NULL );
+  retired = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+  /* Provided all of these were successfully created, start the pool
+   * of workers; should we fail to start any, the archive processor will
+   * simply write every file itself, as it would have done without us.
+   */
+  if( (slot != NULL) && (pending != NULL) && (retired != NULL) )
+    while( started < PKG_EXTRACTION_WRITERS )
+    {
+      HANDLE worker = (HANDLE)(_beginthreadex( NULL, 0, Worker, this, 0, NULL ));
+      if( worker == NULL )
+	break;
+      thread[started++] = worker;
+    }
+}
+
+pkgExtractionPipeline::~pkgExtractionPipeline()
+{
+  /* Release one additional token for each worker, so that each will
+   * terminate when it finds no remaining work; wait for them all to do
+   * so, then retire any outstanding entries, before releasing the
+   * resources which the workers shared.
+   */
+  if( started > 0 )
+  {
+    ReleaseSemaphore( pending, started, NULL );
+    WaitForMultipleObjects( started, thread, TRUE, INFINITE );
+    while( started > 0 )
+      CloseHandle( thread[--started] );
+  }
+  if( slot != NULL )
+  {
+    Retire();
+    free( slot );
+  }
+  if( retired != NULL )
+    CloseHandle( retired );
+  if( pending != NULL )
+    CloseHandle( pending );
+  DeleteCriticalSection( &lock );
+}
+
+struct pkgExtractionPipeline::entry *pkgExtractionPipeline::Reserve
+( const char *pathname, size_t size )
+{
+  /* Wait until the slot at "tail" becomes available, with sufficient
+   * memory budget for "size" bytes of file data, (although we always
+   * admit one entry, however large, when no other data is held), and
+   * such that no entry still pending will write the same "pathname",
+   * (which would otherwise be overwritten in the wrong order).
+   */
+  while( true )
+  {
+    bool blocked;
+    Retire();
+
+    EnterCriticalSection( &lock );
+    blocked = ((tail - head) >= PKG_EXTRACTION_SLOTS)
+      || ((committed > 0) && ((committed + size) > PKG_EXTRACTION_MEMORY));
+    for( unsigned ref = head; (pathname != NULL) && ! blocked && (ref != tail); ref++ )
+    {
+      struct entry *busy = slot + (ref % PKG_EXTRACTION_SLOTS);
+      blocked = (busy->state != ENTRY_DONE) && (busy->pathname != NULL)
+	&& (strcmp( busy->pathname, pathname ) == 0);
+    }
+    if( ! blocked )
+    {
+      /* The slot is available; claim the memory budget on behalf of
+       * the entry which the caller is about to append.
+       */
+      committed += size;
+      LeaveCriticalSection( &lock );
+      return slot + (tail % PKG_EXTRACTION_SLOTS);
+    }
+    LeaveCriticalSection( &lock );
+
+    /* We must wait for a worker to complete an entry, before we can
+     * reassess our ability to proceed.
+     */
+    WaitForSingleObject( retired, INFINITE );
+  }
+}
+
+char *pkgExtractionPipeline::Allocate
+( const char *pathname, const char *key, size_t size, int mode, time_t mtime )
+{
+  /* Reserve a slot, and allocate a buffer, into which the caller may
+   * read the data for the specified file; (the buffer accommodates the
+   * archive's padding to a whole number of header blocks).  The caller
+   * MUST subsequently invoke Dispatch(), unless we return NULL.
+   */
+  size_t padded = size + sizeof( union tar_archive_header ) - 1;
+  padded -= padded % sizeof( union tar_archive_header );
+
+  struct entry *ref = Reserve( pathname, size );
+  if( (ref->data = (char *)(malloc( padded + 1 ))) == NULL )
+  {
+    /* We couldn't allocate the buffer; surrender the memory budget
+     * we claimed, and leave the caller to write the file directly.
+     */
+    EnterCriticalSection( &lock );
+    committed -= size;
+    LeaveCriticalSection( &lock );
+    return NULL;
+  }
+  ref->pathname = strdup( pathname );
+  ref->key = key;
+  ref->size = size;
+  ref->mode = mode;
+  ref->mtime = mtime;
+  return ref->data;
+}
+
+void pkgExtractionPipeline::Dispatch( int status, uint32_t checksum, bool skip )
+{
+  /* Append the entry prepared by Allocate() to the queue; when the
+   * caller has successfully filled its buffer, pass it to a worker,
+   * (unless the caller has determined that the file on disk is already
+   * identical, and so need not be written), otherwise discard the data,
+   * and mark the entry for immediate retirement.
+   */
+  struct entry *ref = slot + (tail % PKG_EXTRACTION_SLOTS);
+  ref->checksum = checksum;
+  ref->content = true;
+  if( ((ref->status = status) != 0) || skip )
+  {
+    free( ref->data );
+    ref->data = NULL;
+  }
+  EnterCriticalSection( &lock );
+  if( ref->data == NULL )
+  {
+    committed -= ref->size;
+    ref->state = ENTRY_DONE;
+  }
+  else
+    ref->state = ENTRY_QUEUED;
+  ++tail;
+  LeaveCriticalSection( &lock );
+
+  if( ref->state == ENTRY_QUEUED )
+    ReleaseSemaphore( pending, 1, NULL );
+}
+
+void pkgExtractionPipeline::Append
+( const char *key, const char *pathname, bool content, uint64_t size,
+  time_t mtime, uint32_t checksum )
+{
+  /* Append an entry, for which no data need be written, (e.g. for a
+   * directory, or for a file which has already been written); when no
+   * earlier entry remains to be retired, we may simply record it in the
+   * manifest immediately.
+   */
+  bool idle;
+  if( (key == NULL) || (manifest == NULL) )
+    return;
+
+  Retire();
+  EnterCriticalSection( &lock );
+  idle = (head == tail);
+  LeaveCriticalSection( &lock );
+
+  if( idle && content )
+    manifest->AddEntry( key, pathname + sysroot_len, size, mtime, checksum );
+
+  else if( idle )
+    manifest->AddEntry( key, pathname + sysroot_len );
+
+  else
+  {
+    struct entry *ref = Reserve( NULL, 0 );
+    ref->pathname = strdup( pathname );
+    ref->key = key;
+    ref->data = NULL;
+    ref->size = size;
+    ref->mtime = mtime;
+    ref->checksum = checksum;
+    ref->content = content;
+    ref->status = 0;
+
+    EnterCriticalSection( &lock );
+    ref->state = ENTRY_DONE;
+    ++tail;
+    LeaveCriticalSection( &lock );
+  }
+}
+
+void pkgExtractionPipeline::Retire()
+{
+  /* Retire all completed entries, from the head of the queue, up to
+   * (but excluding) the first which remains incomplete; record each
+   * which was successfully extracted in the manifest, or diagnose the
+   * failure, as the archive processor would have done, had it written
+   * the file itself.  Note that this must be called ONLY within the
+   * thread which owns the manifest, (i.e. the archive processor's).
+   */
+  while( true )
+  {
+    struct entry *ref;
+    EnterCriticalSection( &lock );
+    if( (head == tail)
+    ||  ((ref = slot + (head % PKG_EXTRACTION_SLOTS))->state != ENTRY_DONE) )
+    {
+      LeaveCriticalSection( &lock );
+      return;
+    }
+    LeaveCriticalSection( &lock );
+
+    if( ref->status != 0 )
+      dmh_notify( DMH_ERROR, "%s: extraction failed\n", ref->pathname );
+
+    else if( (ref->key != NULL) && (manifest != NULL) && ref->content )
+      manifest->AddEntry( ref->key, ref->pathname + sysroot_len,
+	  ref->size, ref->mtime, ref->checksum
+	);
+
+    else if( (ref->key != NULL) && (manifest != NULL) )
+      manifest->AddEntry( ref->key, ref->pathname + sysroot_len );
+
+    free( ref->pathname );
+    ref->pathname = NULL;
+
+    EnterCriticalSection( &lock );
+    ++head;
+    LeaveCriticalSection( &lock );
+  }
+}
+
+unsigned __stdcall pkgExtractionPipeline::Worker( void *pipeline )
+{
+  /* Thread procedure for each writer; it takes the next queued entry,
+   * writes it to its destination file, and commits its time stamp, until
+   * it is woken to find that no such entry remains.
+   */
+  pkgExtractionPipeline *self = (pkgExtractionPipeline *)(pipeline);
+  while( WaitForSingleObject( self->pending, INFINITE ) == WAIT_OBJECT_0 )
+  {
+    struct entry *ref = NULL;
+    EnterCriticalSection( &self->lock );
+    while( (self->next != self->tail) && (ref == NULL) )
+    {
+      struct entry *item = self->slot + (self->next++ % PKG_EXTRACTION_SLOTS);
+      if( item->state == ENTRY_QUEUED )
+	(ref = item)->state = ENTRY_ACTIVE;
+    }
+    LeaveCriticalSection( &self->lock );
+
+    if( ref == NULL )
+      /*
+       * We were woken only to be told that there is no further work.
+       */
+      break;
+
+    /* Write the file, exactly as the archive processor itself would
+     * have done, (cf. ExtractFile()), but without any diagnostic, which
+     * is deferred until the entry is retired.
+     */
+    int fd = set_output_stream( ref->pathname, ref->mode );
+    if( fd >= 0 )
+    {
+      if( write( fd, ref->data, ref->size ) != (int)(ref->size) )
+	ref->status = -2;
+      close( fd );
+      if( ref->status != 0 )
+	unlink( ref->pathname );
+    }
+    if( ref->status == 0 )
+      commit_saved_entity( ref->pathname, ref->mtime );
+
+    free( ref->data );
+    ref->data = NULL;
+
+    EnterCriticalSection( &self->lock );
+    self->committed -= ref->size;
+    ref->state = ENTRY_DONE;
+    LeaveCriticalSection( &self->lock );
+    SetEvent( self->retired );
+  }
+  return 0;
+}
+
+/*******************
+ *
+ * Class Implementation: pkgTarArchiveProcessor (continued)
+ *
+ */
+int pkgTarArchiveProcessor::ExtractDataStream
+( const char *pathname, const char *key )
+{
+  /* Helper to extract the data for a regular file entry, either by
+   * delegating it to the writer pipeline, or, when that isn't possible,
+   * by writing it directly; in either case, the file is recorded in the
+   * manifest, under the specified "key", (if any), in archive order,
+   * together with its size, time stamp, and checksum.  When the file
+   * is retained from a prior installation, and is unchanged, we need
+   * not write it at all.
+   */
+  int status;
+  char *data;
+  uint32_t checksum = 0;
+  uint64_t size = octval( header.field.size );
+  int mode = octval( header.field.mode );
+  time_t mtime = octval( header.field.mtime );
+
+  if( writer == NULL )
+    writer = new pkgExtractionPipeline( installed, sysroot_len );
+
+  if( writer->CanBuffer( size )
+  &&  ((data = writer->Allocate( pathname, key, size, mode, mtime )) != NULL) )
+  {
+    /* The pipeline has accepted the file; read its data, (including
+     * padding), into the buffer provided, and pass it on for writing,
+     * (or for recording only, if the retained copy is unchanged).
+     */
+    bool skip = false;
+    size_t padded = size + sizeof( header ) - 1;
+    padded -= padded % sizeof( header );
+    if( (status = (stream->Read( data, padded ) < (int)(padded)) ? -1 : 0) == 0 )
+    {
+      checksum = crc32( checksum, (const Bytef *)(data), size );
+      skip = (retained != NULL) && retained->Claim
+	( pathname, pathname + sysroot_len, size, mtime, &checksum );
+    }
+    writer->Dispatch( status, checksum, skip );
+    return status;
+  }
+
+  /* When the pipeline cannot accept the file, we handle it directly,
+   * (but only after any pending entry for the same file is written);
+   * in this case, we cannot compute its checksum before we decide if
+   * a retained copy is unchanged, so we can skip it only if the user
+   * hasn't asked us to verify the checksum.
+   */
+  writer->Await( pathname );
+  if( (retained != NULL)
+  &&  retained->Claim( pathname, pathname + sysroot_len, size, mtime, NULL ) )
+    status = ProcessEntityData( -1, &checksum );
+
+  else
+  { int fd = set_output_stream( pathname, mode );
+    if( (status = ExtractFile( fd, pathname, ProcessEntityData( fd, &checksum ))) == 0 )
+      commit_saved_entity( pathname, mtime );
+  }
+  if( status == 0 )
+    RecordEntry( key, pathname, size, mtime, checksum );
+  return status;
+}
+
+void pkgTarArchiveProcessor::FlushExtractedEntities()
+{
+  /* Helper to shut down the writer pipeline, if any, after waiting
+   * for it to write, and to record, all entries which remain pending.
+   */
+  delete writer;
+  writer = NULL;
+}
+
+void pkgTarArchiveProcessor::RecordEntry( const char *key, const char *pathname )
+{
+  /* Helper to record an archive entry in the installation manifest;
+   * when the writer pipeline is active, it must defer this, until all
+   * preceding entries have been recorded.
+   */
+  if( writer != NULL )
+    writer->Record( key, pathname );
+
+  else if( (key != NULL) && (installed != NULL) )
+    installed->AddEntry( key, pathname + sysroot_len );
+}
+
+void pkgTarArchiveProcessor::RecordEntry
+( const char *key, const char *pathname, uint64_t size, time_t mtime,
+  uint32_t checksum )
+{
+  /* Variant of the preceding helper, for recording regular files,
+   * together with the properties of their content.
+   */
+  if( writer != NULL )
+    writer->Record( key, pathname, size, mtime, checksum );
+
+  else if( (key != NULL) && (installed != NULL) )
+    installed->AddEntry( key, pathname + sysroot_len, size, mtime, checksum );
+}
+
+/*******************
+ *
+ * Class Implementation: pkgTarArchiveExtractor
+ *
+ */
 pkgTarArchiveExtractor::pkgTarArchiveExtractor( const char *fn, const char *dir )
 {
   /* A simplified variation on the installer theme; this extracts
@@ -573,20 +1081,10 @@ int pkgTarArchiveExtractor::ProcessDirectory( const char *pathname )
 int pkgTarArchiveExtractor::ProcessDataStream( const char *pathname )
 {
   /* Also declared as abstract in the base class, in this case
-   * we must set up the output stream, and initiate entity data
-   * processing on behalf of the base class ExtractFile() method..
+   * we simply delegate to the base class ExtractDataStream() method,
+   * with no manifest entry to be recorded.
    */
-  int status;
-  int fd = set_output_stream( pathname, octval( header.field.mode ) );
-  if( (status = ExtractFile( fd, pathname, ProcessEntityData( fd ))) == 0 )
-    /*
-     * ...and commit the file after successful extraction...
-     */
-    commit_saved_entity( pathname, octval( header.field.mtime ) );
-
-  /* ...ultimately returning the extraction status code.
-   */
-  return status;
+  return ExtractDataStream( pathname, NULL );
 }
 
 /*******************
@@ -594,14 +1092,35 @@ int pkgTarArchiveExtractor::ProcessDataStream( const char *pathname )
  * Class Implementation: pkgTarArchiveInstaller
  *
  */
-pkgTarArchiveInstaller::
-pkgTarArchiveInstaller( pkgXmlNode *pkg ):pkgTarArchiveProcessor( pkg )
+pkgTarArchiveInstaller::pkgTarArchiveInstaller
+( pkgXmlNode *pkg, pkgArchiveStream *feed, pkgRetainedInventory *prior ):
+pkgTarArchiveProcessor( pkg, feed )
 {
   /* Constructor: having successfully set up the pkgTarArchiveProcessor
-   * base class, we attach a pkgManifest to track the installation.
+   * base class, we attach a pkgManifest to track the installation, and
+   * adopt the inventory of any prior installation which is retained for
+   * replacement.
    */
   if( (tarname != NULL) && (sysroot != NULL) && stream->IsReady() )
     installed = new pkgManifest( package_key, tarname );
+  owners = (installed != NULL) ? pkgOwnershipIndex::Open( sysroot ) : NULL;
+  retained = prior;
+}
+
+pkgTarArchiveInstaller::~pkgTarArchiveInstaller()
+{
+  /* Destructor: we must ensure that all extracted files have been
+   * written, before we delete the retained inventory, (thus removing
+   * any of its files which were not claimed by the installation); when
+   * there is an active removal batch, we defer this to it.
+   */
+  FlushExtractedEntities();
+  pkgRemovalBatch *batch;
+  if( (retained != NULL) && ((batch = pkgRemovalBatch::Active()) != NULL) )
+    batch->Defer( retained, owners, NULL, NULL );
+
+  else
+    delete retained;
 }
 
 int pkgTarArchiveInstaller::Process()
@@ -644,7 +1163,7 @@ int pkgTarArchiveInstaller::ProcessDirectory( const char *pathname )
        * Although no installation directory has actually been created,
        * update the inventory to simulate the effect of doing so.
        */
-      installed->AddEntry( dirname_key, pathname + sysroot_len );
+      RecordEntry( dirname_key, pathname );
   }
   else
   {
@@ -654,7 +1173,7 @@ int pkgTarArchiveInstaller::ProcessDirectory( const char *pathname )
        * or we just successfully created it; attach a reference
        * in the installation manifest for the current package.
        */
-      installed->AddEntry( dirname_key, pathname + sysroot_len );
+      RecordEntry( dirname_key, pathname );
   }
   return status;
 }
@@ -678,28 +1197,26 @@ int pkgTarArchiveInstaller::ProcessDataStream( const char *pathname )
        * Although no file has actually been installed, update
        * the inventory to simulate the effect of doing so.
        */
-      installed->AddEntry( filename_key, pathname + sysroot_len );
+      RecordEntry( filename_key, pathname );
 
     return ProcessEntityData( -1 );
   }
-  else
-  {
-    int status;
+  /* Claim ownership of the file, on behalf of the package we are
+   * installing; if it was already provided by any other package, we
+   * will overwrite it, but we warn that the packages conflict.
+   */
+  const char *prior;
+  if( (owners != NULL)
+  &&  ((prior = owners->Claim( pathname + sysroot_len, tarname )) != NULL)  )
+    dmh_notify( DMH_WARNING, "%s: overwrites file provided by %s\n",
+	pathname + sysroot_len, prior
+      );
 
-    /* Establish an output file stream, extract the entity data,
-     * writing it to this stream...
-     */
-    int fd = set_output_stream( pathname, octval( header.field.mode ) );
-    if( (status = ExtractFile( fd, pathname, ProcessEntityData( fd ))) == 0 )
-    {
-	/* ...and on successful completion, commit the file
-	 * and record it in the installation database.
-	 */
-	commit_saved_entity( pathname, octval( header.field.mtime ) );
-	installed->AddEntry( filename_key, pathname + sysroot_len );
-    }
-    return status;
-  }
+  /* Extract the entity data to the target file, and on successful
+   * completion, commit the file and record it in the installation
+   * database.
+   */
+  return ExtractDataStream( pathname, filename_key );
 }
 
 /* $RCSfile: tarproc.cpp,v $: end of file */
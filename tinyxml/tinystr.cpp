@@ -29,6 +29,7 @@ distribution.
 
 #ifndef TIXML_USE_STL
 
+#include <stdlib.h>
 #include "tinystr.h"
 
 // Error value for find primitive
@@ -36,7 +37,7 @@ const TiXmlString::size_type TiXmlString::npos = static_cast< TiXmlString::size_
 
 
 // Null rep.
-TiXmlString::Rep TiXmlString::nullrep_ = { 0, 0, { '\0' } };
+char TiXmlString::nullrep_[1] = { '\0' };
 
 
 void TiXmlString::reserve (size_type cap)
@@ -54,7 +55,7 @@ void TiXmlString::reserve (size_type cap)
 TiXmlString& TiXmlString::assign(const char* str, size_type len)
 {
 	size_type cap = capacity();
-	if (len > cap || cap > 3*(len + 8))
+	if (len > cap || cap > 3*(len + 8) || cap == 0)
 	{
 		TiXmlString tmp;
 		tmp.init(len);
@@ -113,4 +114,132 @@ TiXmlString operator + (const char* a, const TiXmlString & b)
 }
 
 
+
+// The arena selected for each thread, (see TiXmlArena::Scope).
+#if defined(_MSC_VER)
+static __declspec(thread) TiXmlArena* currentArena = 0;
+#else
+static __thread TiXmlArena* currentArena = 0;
+#endif
+
+
+const size_t TiXmlArena::CHUNK_SIZE;
+
+
+TiXmlArena* TiXmlArena::Select (TiXmlArena* arena)
+{
+	TiXmlArena* prior = currentArena;
+	currentArena = arena;
+	return prior;
+}
+
+
+void* TiXmlArena::Carve (size_t size)
+{
+	// Round up, so that each allocation preserves the header's alignment.
+	size = sizeof(Header) + ((size + sizeof(Header) - 1) & ~(sizeof(Header) - 1));
+	const size_t overhead = (sizeof(Chunk) + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+
+	if ( size > (size_t)(limit - cursor) )
+	{
+		// The current chunk is exhausted; large requests are given a chunk
+		// of their own, (so the current one may continue to be used), while
+		// others start a new chunk of standard size.
+		const size_t need = overhead + size;
+		const bool large = ( size > CHUNK_SIZE / 4 );
+		Chunk* chunk = static_cast<Chunk*>( malloc( large ? need : CHUNK_SIZE ) );
+		if ( !chunk )
+			return 0;
+
+		if ( large && chunks )
+		{
+			chunk->next = chunks->next;
+			chunks->next = chunk;
+			Header* header = reinterpret_cast<Header*>( reinterpret_cast<char*>( chunk ) + overhead );
+			header->in_arena = 1;
+			return header + 1;
+		}
+		chunk->next = chunks;
+		chunks = chunk;
+		cursor = reinterpret_cast<char*>( chunk ) + overhead;
+		limit = reinterpret_cast<char*>( chunk ) + ( large ? need : CHUNK_SIZE );
+	}
+	last = reinterpret_cast<Header*>( cursor );
+	last->in_arena = 1;
+	cursor += size;
+	return last + 1;
+}
+
+
+void* TiXmlArena::Allocate (size_t size)
+{
+	if ( currentArena )
+		return currentArena->Carve( size );
+
+	Header* header = static_cast<Header*>( malloc( sizeof(Header) + size ) );
+	if ( !header )
+		return 0;
+	header->in_arena = 0;
+	return header + 1;
+}
+
+
+void TiXmlArena::Release (void* p)
+{
+	if ( !p )
+		return;
+
+	Header* header = static_cast<Header*>( p ) - 1;
+	if ( !header->in_arena )
+		free( header );
+
+	// Storage within an arena is normally reclaimed only when the arena itself
+	// is destroyed, but when the most recent allocation from the current arena
+	// is released, (as is typical of temporary strings, during parsing), we may
+	// simply roll it back.
+	else if ( currentArena && header == currentArena->last )
+	{
+		currentArena->cursor = reinterpret_cast<char*>( header );
+		currentArena->last = 0;
+	}
+}
+
+
+void TiXmlArena::Adopt (TiXmlArena* other)
+{
+	if ( !other || other == this || !other->chunks )
+		return;
+
+	// Splice the other arena's chunks in behind our own current chunk,
+	// (or simply take them over, with its cursor, if we have none).
+	if ( chunks )
+	{
+		Chunk* tail = other->chunks;
+		while ( tail->next )
+			tail = tail->next;
+		tail->next = chunks->next;
+		chunks->next = other->chunks;
+	}
+	else
+	{
+		chunks = other->chunks;
+		cursor = other->cursor;
+		limit = other->limit;
+	}
+	other->chunks = 0;
+	other->cursor = other->limit = 0;
+	other->last = 0;
+}
+
+
+TiXmlArena::~TiXmlArena ()
+{
+	while ( chunks )
+	{
+		Chunk* chunk = chunks;
+		chunks = chunk->next;
+		free( chunk );
+	}
+}
+
 #endif	// TIXML_USE_STL
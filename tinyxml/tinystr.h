@@ -26,7 +26,8 @@ distribution.
  * THIS FILE WAS ALTERED BY Tyge Lovset, 7. April 2005.
  *
  * - completely rewritten. compact, clean, and fast implementation.
- * - sizeof(TiXmlString) = pointer size (4 bytes on 32-bit systems)
+ * - sizeof(TiXmlString) = pointer size (4 bytes on 32-bit systems); (no
+ *   longer true for mingw-get, which keeps size and capacity in the object).
  * - fixed reserve() to work as per specification.
  * - fixed buggy compares operator==(), operator<(), and operator>()
  * - fixed operator+=() to take a const ref argument, following spec.
@@ -34,6 +35,14 @@ distribution.
  * - added swap(), clear(), size(), capacity(), operator+().
  */
 
+/*
+ * THIS FILE WAS FURTHER ALTERED FOR mingw-get; the following are local
+ * extensions, which are not present in the standard tinyxml distribution:
+ *
+ * - added TiXmlArena, from which a document's content may be allocated.
+ * - added TiXmlString::borrow(), to refer to a string without copying it.
+ */
+
 #ifndef TIXML_USE_STL
 
 #ifndef TIXML_STRING_INCLUDED
@@ -57,6 +66,81 @@ distribution.
 #endif
 
 
+/*
+   TiXmlArena is a simple bump allocator, from which a document may obtain the
+   storage for its nodes, attributes and string payloads, while it is parsed;
+   all such storage is released in one shot, when the arena is destroyed.  The
+   arena which is to be used is selected, for the current thread, by creating a
+   TiXmlArena::Scope object; in the absence of any such selection, TiXmlArena
+   allocations are delegated to the heap.
+*/
+class TiXmlArena
+{
+  public :
+	TiXmlArena () : chunks(0), cursor(0), limit(0), last(0)
+	{
+	}
+
+	~TiXmlArena ();
+
+	// Allocate storage from the arena selected for the current thread, (if any),
+	// or otherwise from the heap; such storage must ONLY be released by Release().
+	static void* Allocate (size_t size);
+	static void Release (void* p);
+
+	// Select an arena for the current thread, returning the prior selection.
+	static TiXmlArena* Select (TiXmlArena* arena);
+
+	// Take ownership of all storage carved from another arena, leaving the
+	// other arena empty, (but still usable).
+	void Adopt (TiXmlArena* other);
+
+	class Scope
+	{
+	  public :
+		Scope (TiXmlArena* arena) : prior(Select(arena))
+		{
+		}
+
+		~Scope ()
+		{
+			Select(prior);
+		}
+
+	  private :
+		TiXmlArena* prior;
+	};
+
+  private :
+	// Each allocation is preceded by a header, which identifies whether it was
+	// carved from an arena; (it is padded to preserve the alignment of the data).
+	union Header
+	{
+		size_t in_arena;
+		double align_d;
+		void*  align_p;
+	};
+
+	struct Chunk
+	{
+		Chunk* next;
+		size_t size;
+	};
+
+	static const size_t CHUNK_SIZE = 65536;
+
+	void* Carve (size_t size);
+
+	Chunk* chunks;
+	char*  cursor;
+	char*  limit;
+	Header* last;
+
+	TiXmlArena (const TiXmlArena&);
+	void operator= (const TiXmlArena&);
+};
+
+
 /*
    TiXmlString is an emulation of a subset of the std::string template.
    Its purpose is to allow compiling TinyXML on compilers with no or poor STL support.
@@ -75,26 +159,26 @@ class TiXmlString
 
 
 	// TiXmlString empty constructor
-	TiXmlString () : rep_(&nullrep_)
+	TiXmlString () : start_(nullrep_), size_(0), capacity_(0)
 	{
 	}
 
 	// TiXmlString copy constructor
-	TiXmlString ( const TiXmlString & copy) : rep_(0)
+	TiXmlString ( const TiXmlString & copy) : start_(0), size_(0), capacity_(0)
 	{
 		init(copy.length());
 		memcpy(start(), copy.data(), length());
 	}
 
 	// TiXmlString constructor, based on a string
-	TIXML_EXPLICIT TiXmlString ( const char * copy) : rep_(0)
+	TIXML_EXPLICIT TiXmlString ( const char * copy) : start_(0), size_(0), capacity_(0)
 	{
 		init( static_cast<size_type>( strlen(copy) ));
 		memcpy(start(), copy, length());
 	}
 
 	// TiXmlString constructor, based on a string
-	TIXML_EXPLICIT TiXmlString ( const char * str, size_type len) : rep_(0)
+	TIXML_EXPLICIT TiXmlString ( const char * str, size_type len) : start_(0), size_(0), capacity_(0)
 	{
 		init(len);
 		memcpy(start(), str, len);
@@ -139,36 +223,36 @@ class TiXmlString
 
 
 	// Convert a TiXmlString into a null-terminated char *
-	const char * c_str () const { return rep_->str; }
+	const char * c_str () const { return start_; }
 
 	// Convert a TiXmlString into a char * (need not be null terminated).
-	const char * data () const { return rep_->str; }
+	const char * data () const { return start_; }
 
 	// Return the length of a TiXmlString
-	size_type length () const { return rep_->size; }
+	size_type length () const { return size_; }
 
 	// Alias for length()
-	size_type size () const { return rep_->size; }
+	size_type size () const { return size_; }
 
 	// Checks if a TiXmlString is empty
-	bool empty () const { return rep_->size == 0; }
+	bool empty () const { return size_ == 0; }
 
 	// Return capacity of string
-	size_type capacity () const { return rep_->capacity; }
+	size_type capacity () const { return capacity_; }
 
 
 	// single char extraction
 	const char& at (size_type index) const
 	{
 		assert( index < length() );
-		return rep_->str[ index ];
+		return start_[ index ];
 	}
 
 	// [] operator
 	char& operator [] (size_type index) const
 	{
 		assert( index < length() );
-		return rep_->str[ index ];
+		return start_[ index ];
 	}
 
 	// find a char in a string. Return TiXmlString::npos if not found
@@ -208,25 +292,41 @@ class TiXmlString
 
 	TiXmlString& append (const char* str, size_type len);
 
+	/*	Refer to an existing, null terminated string, without copying it.
+		The caller must ensure that the string remains valid, and unchanged, for as
+		long as it may be referenced; any subsequent assignment, or append, is made
+		to a private copy, leaving the original intact.
+	*/
+	void borrow (const char* str, size_type len)
+	{
+		assert( str[ len ] == '\0' );
+		quit();
+		start_ = const_cast<char*>(str);
+		size_ = len;
+		capacity_ = 0;
+	}
+
 	void swap (TiXmlString& other)
 	{
-		Rep* r = rep_;
-		rep_ = other.rep_;
-		other.rep_ = r;
+		char* s = start_;
+		start_ = other.start_;
+		other.start_ = s;
+
+		size_type n = size_;
+		size_ = other.size_;
+		other.size_ = n;
+
+		n = capacity_;
+		capacity_ = other.capacity_;
+		other.capacity_ = n;
 	}
 
   private:
 
 	void init(size_type sz) { init(sz, sz); }
-	void set_size(size_type sz) { rep_->str[ rep_->size = sz ] = '\0'; }
-	char* start() const { return rep_->str; }
-	char* finish() const { return rep_->str + rep_->size; }
-
-	struct Rep
-	{
-		size_type size, capacity;
-		char str[1];
-	};
+	void set_size(size_type sz) { start_[ size_ = sz ] = '\0'; }
+	char* start() const { return start_; }
+	char* finish() const { return start_ + size_; }
 
 	void init(size_type sz, size_type cap)
 	{
@@ -234,34 +334,37 @@ class TiXmlString
 		{
 			// Lee: the original form:
 			//	rep_ = static_cast<Rep*>(operator new(sizeof(Rep) + cap));
-			// doesn't work in some cases of new being overloaded. Switching
-			// to the normal allocation, although use an 'int' for systems
-			// that are overly picky about structure alignment.
-			const size_type bytesNeeded = sizeof(Rep) + cap;
-			const size_type intsNeeded = ( bytesNeeded + sizeof(int) - 1 ) / sizeof( int ); 
-			rep_ = reinterpret_cast<Rep*>( new int[ intsNeeded ] );
-
-			rep_->str[ rep_->size = sz ] = '\0';
-			rep_->capacity = cap;
+			// doesn't work in some cases of new being overloaded. Locally,
+			// we now obtain the storage from TiXmlArena, which preserves
+			// alignment, and may carve it from the document's arena; (the
+			// size and capacity are no longer kept with the characters, so
+			// that a borrowed string may be represented just as well).
+			start_ = static_cast<char*>( TiXmlArena::Allocate( cap + 1 ) );
+
+			start_[ size_ = sz ] = '\0';
+			capacity_ = cap;
 		}
 		else
 		{
-			rep_ = &nullrep_;
+			start_ = nullrep_;
+			size_ = capacity_ = 0;
 		}
 	}
 
 	void quit()
 	{
-		if (rep_ != &nullrep_)
+		// Only storage which we own has capacity; borrowed strings, (and the
+		// null rep), have none.  Owned storage was obtained from TiXmlArena.
+		if (capacity_)
 		{
-			// The rep_ is really an array of ints. (see the allocator, above).
-			// Cast it back before delete, so the compiler won't incorrectly call destructors.
-			delete [] ( reinterpret_cast<int*>( rep_ ) );
+			TiXmlArena::Release( start_ );
 		}
 	}
 
-	Rep * rep_;
-	static Rep nullrep_;
+	char* start_;
+	size_type size_;
+	size_type capacity_;
+	static char nullrep_[1];
 
 } ;
 
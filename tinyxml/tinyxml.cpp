@@ -34,6 +34,76 @@ distribution.
 
 bool TiXmlBase::condenseWhiteSpace = true;
 
+TiXmlAtom::Entry* volatile TiXmlAtom::table[ TiXmlAtom::TABLE_SIZE ];
+const char* volatile TiXmlAtom::recent[ TiXmlAtom::RECENT_SIZE ];
+
+// Publish a new entry at the head of a table chain, provided no other thread
+// has changed the chain since we examined it.
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#define TIXML_PUBLISH( head, expect, entry ) \
+		( _InterlockedCompareExchangePointer( (void* volatile*)(head), (entry), (expect) ) == (expect) )
+#else
+	#define TIXML_PUBLISH( head, expect, entry ) \
+		__sync_bool_compare_and_swap( (head), (expect), (entry) )
+#endif
+
+const char* TiXmlAtom::Lookup( const char* name, Mode mode )
+{
+	if ( !name )
+		return 0;
+
+	// Strings which are atoms in their own right, (typically pre-registered
+	// constants), are remembered in a small cache, keyed on their addresses;
+	// since atoms are never released, nor modified, a hit is always valid.
+	const size_t slot = ( reinterpret_cast< size_t >( name ) >> 2 ) % RECENT_SIZE;
+	if ( recent[ slot ] == name )
+		return name;
+
+	unsigned long hash = 2166136261UL;
+	for ( const char* p = name; *p; ++p )
+		hash = ( hash ^ (unsigned char)( *p ) ) * 16777619UL;
+
+	Entry* volatile* chain = table + ( hash & ( TABLE_SIZE - 1 ) );
+	Entry* fresh = 0;
+	for ( ;; )
+	{
+		Entry* head = *chain;
+		for ( Entry* entry = head; entry; entry = entry->next )
+		{
+			if ( entry->hash == hash && strcmp( entry->name, name ) == 0 )
+			{
+				free( fresh );
+				if ( entry->name == name )
+					recent[ slot ] = name;
+				return entry->name;
+			}
+		}
+		if ( mode == FIND )
+			return 0;
+
+		if ( !fresh )
+		{
+			// Atoms are allocated directly from the heap, (never from any
+			// document's arena), since they must outlive every document.
+			const size_t length = ( mode == REGISTER ) ? 0 : strlen( name ) + 1;
+			if ( ( fresh = static_cast< Entry* >( malloc( sizeof( Entry ) + length ) ) ) == 0 )
+				return 0;
+			fresh->hash = hash;
+			fresh->name = name;
+			if ( length )
+				fresh->name = static_cast< char* >( memcpy( fresh + 1, name, length ) );
+		}
+		fresh->next = head;
+		if ( TIXML_PUBLISH( chain, head, fresh ) )
+		{
+			if ( fresh->name == name )
+				recent[ slot ] = name;
+			return fresh->name;
+		}
+	}
+}
+
 // Microsoft compiler security
 FILE* TiXmlFOpen( const char* filename, const char* mode )
 {
@@ -136,10 +206,13 @@ TiXmlNode::TiXmlNode( NodeType _type ) : TiXmlBase()
 {
 	parent = 0;
 	type = _type;
+	atom = 0;
 	firstChild = 0;
 	lastChild = 0;
 	prev = 0;
 	next = 0;
+	childIndex = 0;
+	nextOfAtom = 0;
 }
 
 
@@ -154,6 +227,7 @@ TiXmlNode::~TiXmlNode()
 		node = node->next;
 		delete temp;
 	}	
+	DiscardChildIndex();
 }
 
 
@@ -164,11 +238,29 @@ void TiXmlNode::CopyTo( TiXmlNode* target ) const
 }
 
 
+void TiXmlNode::ChildrenChanged()
+{
+	DiscardChildIndex();
+	NotifyDocument();
+}
+
+
+void TiXmlNode::NotifyDocument()
+{
+	TiXmlDocument* document = GetDocument();
+	if ( document )
+		document->ContentChanged( this );
+}
+
+
 void TiXmlNode::Clear()
 {
 	TiXmlNode* node = firstChild;
 	TiXmlNode* temp = 0;
 
+	if ( node )
+		ChildrenChanged();
+
 	while ( node )
 	{
 		temp = node;
@@ -204,6 +296,7 @@ TiXmlNode* TiXmlNode::LinkEndChild( TiXmlNode* node )
 		firstChild = node;			// it was an empty list.
 
 	lastChild = node;
+	ChildrenChanged();
 	return node;
 }
 
@@ -251,6 +344,7 @@ TiXmlNode* TiXmlNode::InsertBeforeChild( TiXmlNode* beforeThis, const TiXmlNode&
 		firstChild = node;
 	}
 	beforeThis->prev = node;
+	ChildrenChanged();
 	return node;
 }
 
@@ -283,6 +377,7 @@ TiXmlNode* TiXmlNode::InsertAfterChild( TiXmlNode* afterThis, const TiXmlNode& a
 		lastChild = node;
 	}
 	afterThis->next = node;
+	ChildrenChanged();
 	return node;
 }
 
@@ -311,16 +406,27 @@ TiXmlNode* TiXmlNode::ReplaceChild( TiXmlNode* replaceThis, const TiXmlNode& wit
 
 	delete replaceThis;
 	node->parent = this;
+	ChildrenChanged();
 	return node;
 }
 
 
 bool TiXmlNode::RemoveChild( TiXmlNode* removeThis )
+{
+	if ( !UnlinkChild( removeThis ) )
+		return false;
+
+	delete removeThis;
+	return true;
+}
+
+
+TiXmlNode* TiXmlNode::UnlinkChild( TiXmlNode* removeThis )
 {
 	if ( removeThis->parent != this )
 	{	
 		assert( 0 );
-		return false;
+		return 0;
 	}
 
 	if ( removeThis->next )
@@ -333,8 +439,33 @@ bool TiXmlNode::RemoveChild( TiXmlNode* removeThis )
 	else
 		firstChild = removeThis->next;
 
-	delete removeThis;
-	return true;
+	removeThis->parent = 0;
+	removeThis->prev = removeThis->next = 0;
+	ChildrenChanged();
+	return removeThis;
+}
+
+
+TiXmlNode* TiXmlNode::AdoptChild( TiXmlNode* node )
+{
+	TiXmlDocument* donor = node->GetDocument();
+	TiXmlDocument* owner = GetDocument();
+
+	#ifndef TIXML_USE_STL
+	if ( donor && donor != owner )
+	{
+		// The node may have been carved from the donor's arena, which
+		// will be released with the donor; that storage must now become
+		// the responsibility of the adopting document.
+		if ( !owner )
+			return LinkEndChild( node->Clone() );
+		owner->Arena()->Adopt( donor->Arena() );
+	}
+	#endif
+
+	if ( node->parent && !node->parent->UnlinkChild( node ) )
+		return 0;
+	return LinkEndChild( node );
 }
 
 const TiXmlNode* TiXmlNode::FirstChild( const char * _value ) const
@@ -401,6 +532,125 @@ const TiXmlNode* TiXmlNode::NextSibling( const char * _value ) const
 }
 
 
+TiXmlNode* TiXmlNode::FirstChildOfAtom( const char* _atom )
+{
+	if ( !_atom )
+		return 0;
+
+	const ChildIndex* index = childIndex;
+	if ( !index )
+	{
+		// Until there is an index, search linearly; when that means
+		// skipping more than a few children, build the index instead.
+		int skipped = 0;
+		for ( TiXmlNode* node = firstChild; node; node = node->next )
+		{
+			if ( node->atom == _atom )
+				return node;
+			if ( ++skipped > INDEX_THRESHOLD && ( index = IndexChildren() ) != 0 )
+				break;
+		}
+		if ( !index )
+			return 0;
+	}
+	for ( int i = 0; i < index->count; ++i )
+	{
+		if ( index->group[ i ].atom == _atom )
+			return index->group[ i ].first;
+	}
+	return 0;
+}
+
+
+TiXmlNode* TiXmlNode::NextSiblingOfAtom( const char* _atom )
+{
+	if ( !_atom )
+		return 0;
+
+	// The chain of siblings with a common atom may be followed only
+	// from a node which is itself a member of that chain.
+	bool chained = parent && atom == _atom;
+	if ( chained && parent->childIndex )
+		return nextOfAtom;
+
+	int skipped = 0;
+	for ( TiXmlNode* node = next; node; node = node->next )
+	{
+		if ( node->atom == _atom )
+			return node;
+		if ( chained && ++skipped > INDEX_THRESHOLD && parent->IndexChildren() )
+			return nextOfAtom;
+	}
+	return 0;
+}
+
+
+const TiXmlNode::ChildIndex* TiXmlNode::IndexChildren()
+{
+	int size = INDEX_THRESHOLD;
+	ChildIndex* index = static_cast< ChildIndex* >(
+		malloc( sizeof( ChildIndex ) + ( size - 1 ) * sizeof( ChildIndex::Group ) ) );
+	if ( !index )
+		return 0;
+	index->count = 0;
+	index->size = size;
+
+	// Visit the children in reverse order, pushing each element on to
+	// the head of the chain for its atom, so that every chain runs in
+	// document order.  Adjacent siblings are usually of the same type,
+	// so check the group last used, before searching for another.
+	int last = -1;
+	for ( TiXmlNode* node = lastChild; node; node = node->prev )
+	{
+		if ( !node->atom )
+			continue;
+
+		int i = last;
+		if ( i < 0 || index->group[ i ].atom != node->atom )
+		{
+			for ( i = 0; i < index->count && index->group[ i ].atom != node->atom; ++i )
+				;
+			if ( i == index->count )
+			{
+				if ( index->count == index->size )
+				{
+					size = index->size * 2;
+					ChildIndex* grown = static_cast< ChildIndex* >(
+						realloc( index, sizeof( ChildIndex ) + ( size - 1 ) * sizeof( ChildIndex::Group ) ) );
+					if ( !grown )
+					{
+						free( index );
+						return 0;
+					}
+					index = grown;
+					index->size = size;
+				}
+				index->group[ i ].atom = node->atom;
+				index->group[ i ].first = 0;
+				++index->count;
+			}
+			last = i;
+		}
+		node->nextOfAtom = index->group[ i ].first;
+		index->group[ i ].first = node;
+	}
+
+	DiscardChildIndex();
+	childIndex = index;
+	return index;
+}
+
+
+void TiXmlNode::DiscardChildIndex()
+{
+	if ( childIndex )
+	{
+		free( childIndex );
+		childIndex = 0;
+	}
+}
+
+
 const TiXmlNode* TiXmlNode::PreviousSibling( const char * _value ) const
 {
 	const TiXmlNode* node;
@@ -425,6 +675,7 @@ void TiXmlElement::RemoveAttribute( const char * name )
 	{
 		attributeSet.Remove( node );
 		delete node;
+		NotifyDocument();
 	}
 }
 
@@ -505,7 +756,7 @@ TiXmlElement::TiXmlElement (const char * _value)
 	: TiXmlNode( TiXmlNode::ELEMENT )
 {
 	firstChild = lastChild = 0;
-	value = _value;
+	SetValue( _value );
 }
 
 
@@ -514,7 +765,7 @@ TiXmlElement::TiXmlElement( const std::string& _value )
 	: TiXmlNode( TiXmlNode::ELEMENT )
 {
 	firstChild = lastChild = 0;
-	value = _value;
+	SetValue( _value );
 }
 #endif
 
@@ -720,7 +971,8 @@ void TiXmlElement::SetAttribute( const char * cname, const char * cvalue )
 	TIXML_STRING _name( cname );
 	TIXML_STRING _value( cvalue );
 	#else
-	const char* _name = cname;
+	// Intern the name once, here; look-ups of the resultant atom are cheap.
+	const char* _name = TiXmlAtom::Intern( cname );
 	const char* _value = cvalue;
 	#endif
 
@@ -728,16 +980,18 @@ void TiXmlElement::SetAttribute( const char * cname, const char * cvalue )
 	if ( node )
 	{
 		node->SetValue( _value );
+		NotifyDocument();
 		return;
 	}
 
-	TiXmlAttribute* attrib = new TiXmlAttribute( cname, cvalue );
-	if ( attrib )
+	TiXmlAttribute* attrib = new TiXmlAttribute( _name, _value );
+	if ( attrib && attributeSet.Add( attrib ) )
 	{
-		attributeSet.Add( attrib );
+		NotifyDocument();
 	}
 	else
 	{
+		delete attrib;
 		TiXmlDocument* document = GetDocument();
 		if ( document ) document->SetError( TIXML_ERROR_OUT_OF_MEMORY, 0, 0, TIXML_ENCODING_UNKNOWN );
 	}
@@ -751,16 +1005,18 @@ void TiXmlElement::SetAttribute( const std::string& name, const std::string& _va
 	if ( node )
 	{
 		node->SetValue( _value );
+		NotifyDocument();
 		return;
 	}
 
 	TiXmlAttribute* attrib = new TiXmlAttribute( name, _value );
-	if ( attrib )
+	if ( attrib && attributeSet.Add( attrib ) )
 	{
-		attributeSet.Add( attrib );
+		NotifyDocument();
 	}
 	else
 	{
+		delete attrib;
 		TiXmlDocument* document = GetDocument();
 		if ( document ) document->SetError( TIXML_ERROR_OUT_OF_MEMORY, 0, 0, TIXML_ENCODING_UNKNOWN );
 	}
@@ -885,6 +1141,10 @@ TiXmlDocument::TiXmlDocument() : TiXmlNode( TiXmlNode::DOCUMENT )
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	#ifndef TIXML_USE_STL
+	arena = 0;
+	inSitu = parsingInSitu = false;
+	#endif
 	ClearError();
 }
 
@@ -892,6 +1152,10 @@ TiXmlDocument::TiXmlDocument( const char * documentName ) : TiXmlNode( TiXmlNode
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	#ifndef TIXML_USE_STL
+	arena = 0;
+	inSitu = parsingInSitu = false;
+	#endif
 	value = documentName;
 	ClearError();
 }
@@ -910,10 +1174,35 @@ TiXmlDocument::TiXmlDocument( const std::string& documentName ) : TiXmlNode( TiX
 
 TiXmlDocument::TiXmlDocument( const TiXmlDocument& copy ) : TiXmlNode( TiXmlNode::DOCUMENT )
 {
+	#ifndef TIXML_USE_STL
+	arena = 0;
+	inSitu = parsingInSitu = false;
+	#endif
 	copy.CopyTo( this );
 }
 
 
+TiXmlDocument::~TiXmlDocument()
+{
+	#ifndef TIXML_USE_STL
+	if ( arena )
+	{
+		// Content carved from the arena must be destroyed before the arena
+		// itself; this includes the string payloads held by the document,
+		// (which would otherwise be released only after the arena is gone),
+		// so we swap these out, to be released now.
+		Clear();
+		{
+			TIXML_STRING discard_value, discard_error;
+			value.swap( discard_value );
+			errorDesc.swap( discard_error );
+		}
+		delete arena;
+	}
+	#endif
+}
+
+
 void TiXmlDocument::operator=( const TiXmlDocument& copy )
 {
 	Clear();
@@ -995,6 +1284,11 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 		return false;
 	}
 
+	#ifndef TIXML_USE_STL
+	if ( inSitu )
+		return LoadFileInSitu( file, length, encoding );
+	#endif
+
 	// If we have a file, assume it is all one big XML file, and read it in.
 	// The document parser may decide the document ends sooner than the entire file, however.
 	TIXML_STRING data;
@@ -1085,6 +1379,58 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 }
 
 
+#ifndef TIXML_USE_STL
+bool TiXmlDocument::LoadFileInSitu( FILE* file, long length, TiXmlEncoding encoding )
+{
+	// Read the entire file into a private image, carved from our arena, so
+	// that it will persist for as long as any content which refers to it.
+	char* image;
+	{
+		TiXmlArena::Scope scope( Arena() );
+		image = static_cast< char* >( TiXmlArena::Allocate( length+1 ) );
+		if ( image && fread( image, length, 1, file ) != 1 )
+		{
+			TiXmlArena::Release( image );
+			image = 0;
+		}
+	}
+	if ( !image )
+	{
+		SetError( TIXML_ERROR_OPENING_FILE, 0, 0, TIXML_ENCODING_UNKNOWN );
+		return false;
+	}
+	image[length] = 0;
+
+	// Normalise line breaks, (see LoadFile, above), in place; this can only
+	// shorten the content, and there is nothing to do before the first CR.
+	char* out = strchr( image, 0xd );
+	if ( out )
+	{
+		for ( const char* p = out; *p; ++p )
+		{
+			if ( *p == 0xd )
+			{
+				*out++ = 0xa;
+				if ( *(p+1) == 0xa )
+					++p;
+			}
+			else
+				*out++ = *p;
+		}
+		*out = 0;
+	}
+
+	// Parse the image, allowing the parser to rewrite it as necessary, so
+	// that names and values may refer to it, rather than be copied.
+	parsingInSitu = true;
+	Parse( image, 0, encoding );
+	parsingInSitu = false;
+
+	return !Error();
+}
+#endif
+
+
 bool TiXmlDocument::SaveFile( const char * filename ) const
 {
 	// The old c stuff lives on...
@@ -1126,6 +1472,9 @@ void TiXmlDocument::CopyTo( TiXmlDocument* target ) const
 	target->tabsize = tabsize;
 	target->errorLocation = errorLocation;
 	target->useMicrosoftBOM = useMicrosoftBOM;
+	#ifndef TIXML_USE_STL
+	target->inSitu = inSitu;
+	#endif
 
 	TiXmlNode* node = 0;
 	for ( node = firstChild; node; node = node->NextSibling() )
@@ -1173,44 +1522,16 @@ bool TiXmlDocument::Accept( TiXmlVisitor* visitor ) const
 
 const TiXmlAttribute* TiXmlAttribute::Next() const
 {
-	// We are using knowledge of the sentinel. The sentinel
-	// have a value or name.
-	if ( next->value.empty() && next->name.empty() )
-		return 0;
+	// The attributes of a set are linked in a null terminated list;
+	// (the sentinel of the standard tinyxml distribution is gone).
 	return next;
 }
 
-/*
-TiXmlAttribute* TiXmlAttribute::Next()
-{
-	// We are using knowledge of the sentinel. The sentinel
-	// have a value or name.
-	if ( next->value.empty() && next->name.empty() )
-		return 0;
-	return next;
-}
-*/
-
 const TiXmlAttribute* TiXmlAttribute::Previous() const
 {
-	// We are using knowledge of the sentinel. The sentinel
-	// have a value or name.
-	if ( prev->value.empty() && prev->name.empty() )
-		return 0;
 	return prev;
 }
 
-/*
-TiXmlAttribute* TiXmlAttribute::Previous()
-{
-	// We are using knowledge of the sentinel. The sentinel
-	// have a value or name.
-	if ( prev->value.empty() && prev->name.empty() )
-		return 0;
-	return prev;
-}
-*/
-
 void TiXmlAttribute::Print( FILE* cfile, int /*depth*/, TIXML_STRING* str ) const
 {
 	TIXML_STRING n, v;
@@ -1501,19 +1822,21 @@ TiXmlNode* TiXmlUnknown::Clone() const
 
 TiXmlAttributeSet::TiXmlAttributeSet()
 {
-	sentinel.next = &sentinel;
-	sentinel.prev = &sentinel;
+	slot = inline_slot;
+	count = 0;
+	capacity = INLINE_SLOTS;
 }
 
 
 TiXmlAttributeSet::~TiXmlAttributeSet()
 {
-	assert( sentinel.next == &sentinel );
-	assert( sentinel.prev == &sentinel );
+	assert( count == 0 );
+	if ( slot != inline_slot )
+		TiXmlArena::Release( slot );
 }
 
 
-void TiXmlAttributeSet::Add( TiXmlAttribute* addMe )
+bool TiXmlAttributeSet::Add( TiXmlAttribute* addMe )
 {
     #ifdef TIXML_USE_STL
 	assert( !Find( TIXML_STRING( addMe->Name() ) ) );	// Shouldn't be multiply adding to the set.
@@ -1521,25 +1844,44 @@ void TiXmlAttributeSet::Add( TiXmlAttribute* addMe )
 	assert( !Find( addMe->Name() ) );	// Shouldn't be multiply adding to the set.
 	#endif
 
-	addMe->next = &sentinel;
-	addMe->prev = sentinel.prev;
+	if ( count == capacity )
+	{
+		// The slot vector is full; move it to a larger block, (which will
+		// be carved from the document's arena, while parsing).
+		Slot* grown = static_cast< Slot* >( TiXmlArena::Allocate( 2 * capacity * sizeof( Slot ) ) );
+		if ( !grown )
+			return false;
+		memcpy( grown, slot, count * sizeof( Slot ) );
+		if ( slot != inline_slot )
+			TiXmlArena::Release( slot );
+		slot = grown;
+		capacity *= 2;
+	}
+
+	addMe->next = 0;
+	addMe->prev = count ? slot[ count - 1 ].attribute : 0;
+	if ( addMe->prev )
+		addMe->prev->next = addMe;
 
-	sentinel.prev->next = addMe;
-	sentinel.prev      = addMe;
+	slot[ count ].atom = addMe->atom;
+	slot[ count++ ].attribute = addMe;
+	return true;
 }
 
 void TiXmlAttributeSet::Remove( TiXmlAttribute* removeMe )
 {
-	TiXmlAttribute* node;
-
-	for( node = sentinel.next; node != &sentinel; node = node->next )
+	for( unsigned i = 0; i < count; ++i )
 	{
-		if ( node == removeMe )
+		if ( slot[ i ].attribute == removeMe )
 		{
-			node->prev->next = node->next;
-			node->next->prev = node->prev;
-			node->next = 0;
-			node->prev = 0;
+			if ( removeMe->prev )
+				removeMe->prev->next = removeMe->next;
+			if ( removeMe->next )
+				removeMe->next->prev = removeMe->prev;
+			removeMe->next = 0;
+			removeMe->prev = 0;
+
+			memmove( slot + i, slot + i + 1, ( --count - i ) * sizeof( Slot ) );
 			return;
 		}
 	}
@@ -1550,49 +1892,41 @@ void TiXmlAttributeSet::Remove( TiXmlAttribute* removeMe )
 #ifdef TIXML_USE_STL
 const TiXmlAttribute* TiXmlAttributeSet::Find( const std::string& name ) const
 {
-	for( const TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
-	{
-		if ( node->name == name )
-			return node;
-	}
-	return 0;
+	return Find( name.c_str() );
 }
 
-/*
-TiXmlAttribute*	TiXmlAttributeSet::Find( const std::string& name )
-{
-	for( TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
-	{
-		if ( node->name == name )
-			return node;
-	}
-	return 0;
-}
-*/
 #endif
 
 
+// For each atom, (keyed on its address), the slot in which it was most
+// recently found; well known names tend to occupy the same slot, in every
+// element of any one type, so this is usually the first, and only, slot we
+// need to check.  (Concurrent updates are benign; any hint may be wrong).
+static volatile unsigned char attributeSlotHint[ 256 ];
+
 const TiXmlAttribute* TiXmlAttributeSet::Find( const char* name ) const
 {
-	for( const TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
-	{
-		if ( strcmp( node->name.c_str(), name ) == 0 )
-			return node;
-	}
-	return 0;
-}
+	// Every attribute name is interned, so we need only compare atoms;
+	// if the name has never been interned, no attribute can match it.
+	const char* key = TiXmlAtom::Find( name );
+	if ( !key )
+		return 0;
 
-/*
-TiXmlAttribute*	TiXmlAttributeSet::Find( const char* name )
-{
-	for( TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
+	volatile unsigned char& hint = attributeSlotHint[ ( reinterpret_cast< size_t >( key ) >> 2 ) & 0xff ];
+	unsigned i = hint;
+	if ( i < count && slot[ i ].atom == key )
+		return slot[ i ].attribute;
+
+	for( i = 0; i < count; ++i )
 	{
-		if ( strcmp( node->name.c_str(), name ) == 0 )
-			return node;
+		if ( slot[ i ].atom == key )
+		{
+			hint = (unsigned char)( i );
+			return slot[ i ].attribute;
+		}
 	}
 	return 0;
 }
-*/
 
 #ifdef TIXML_USE_STL	
 std::istream& operator>> (std::istream & in, TiXmlNode & base)
@@ -22,6 +22,22 @@ must not be misrepresented as being the original software.
 distribution.
 */
 
+/*
+ * THIS FILE WAS ALTERED FOR mingw-get; the following are local extensions,
+ * which are not present in the standard tinyxml distribution:
+ *
+ * - TiXmlAtom, interning element and attribute names, and the Atom()
+ *   accessors of TiXmlNode and TiXmlAttribute.
+ * - allocation of nodes and attributes from a document's TiXmlArena, and
+ *   in situ parsing, (TiXmlDocument::SetInSitu, TiXmlBase::ReadTextInSitu).
+ * - TiXmlNode::UnlinkChild and TiXmlNode::AdoptChild.
+ * - TiXmlNode::FirstChildOfAtom and TiXmlNode::NextSiblingOfAtom, with
+ *   the index of children by atom, on which they depend.
+ * - the slot vector of TiXmlAttributeSet, replacing the sentinel terminated
+ *   list of attributes.
+ * - TiXmlDocument::ContentChanged.
+ */
+
 
 #ifndef TINYXML_INCLUDED
 #define TINYXML_INCLUDED
@@ -170,6 +186,42 @@ enum TiXmlEncoding
 
 const TiXmlEncoding TIXML_DEFAULT_ENCODING = TIXML_ENCODING_UNKNOWN;
 
+/** TiXmlAtom maintains a process wide table of interned names; every
+	element name, and every attribute name, is interned as it is set, so
+	that names may be matched by comparing the interned pointers, rather
+	than the strings themselves.  Strings with static storage duration may
+	be pre-registered, so that each becomes its own interned atom; look-ups
+	of such strings then avoid hashing them.  The table may be read, and
+	extended, by multiple threads concurrently; interned atoms are never
+	released.
+*/
+class TiXmlAtom
+{
+public:
+	/// Return the interned atom for a name, adding it if necessary.
+	static const char* Intern( const char* name )		{ return Lookup( name, ADD ); }
+	/// Return the interned atom for a name, or null if it has never been interned.
+	static const char* Find( const char* name )		{ return Lookup( name, FIND ); }
+	/// Register a permanent string, to become its own atom if not already interned.
+	static void Register( const char* name )			{ Lookup( name, REGISTER ); }
+
+private:
+	enum Mode { FIND, ADD, REGISTER };
+	enum { TABLE_SIZE = 1024, RECENT_SIZE = 64 };
+
+	struct Entry
+	{
+		Entry* next;
+		unsigned long hash;
+		const char* name;
+	};
+
+	static const char* Lookup( const char* name, Mode mode );
+
+	static Entry* volatile table[ TABLE_SIZE ];
+	static const char* volatile recent[ RECENT_SIZE ];
+};
+
 /** TiXmlBase is a base class for every class in TinyXml.
 	It does little except to establish that TinyXml classes
 	can be printed and provide some utility functions.
@@ -202,6 +254,15 @@ public:
 	TiXmlBase()	:	userData(0)		{}
 	virtual ~TiXmlBase()			{}
 
+	#ifndef TIXML_USE_STL
+	/** Nodes and attributes obtain their storage from TiXmlArena; thus,
+		while a document is parsed, (or whenever a TiXmlArena::Scope is in
+		effect), they are carved from the document's arena.
+	*/
+	static void* operator new( size_t size ) throw()	{ return TiXmlArena::Allocate( size ); }
+	static void operator delete( void* p )				{ TiXmlArena::Release( p ); }
+	#endif
+
 	/**	All TinyXml classes can print themselves to a filestream
 		or the string class (TiXmlString in non-STL mode, std::string
 		in STL mode.) Either or both cfile and str can be null.
@@ -325,6 +386,19 @@ protected:
 									bool ignoreCase,			// whether to ignore case in the end tag
 									TiXmlEncoding encoding );	// the current encoding
 
+	/*	As ReadText, but when the document is parsed in situ, (see TiXmlDocument::
+		SetInSitu), text which needs no entity decoding is condensed where it lies,
+		and is then referenced directly, rather than copied.  Unless the end tag
+		is to be read again, it may be overwritten, to terminate the text.
+	*/
+	static const char* ReadTextInSitu(	const char* in,
+										TIXML_STRING* text,
+										bool ignoreWhiteSpace,
+										const char* endTag,
+										bool keepEndTag,		// whether the end tag is read again
+										TiXmlParsingData* data,
+										TiXmlEncoding encoding );
+
 	// If an entity has been found, transform it into a character.
 	static const char* GetEntity( const char* in, char* value, int* length, TiXmlEncoding encoding );
 
@@ -492,6 +566,11 @@ public:
 	*/
 	const char *Value() const { return value.c_str (); }
 
+	/** For an element, return the interned atom for its name, (see TiXmlAtom);
+		for any other type of node, return null.
+	*/
+	const char *Atom() const { return atom; }
+
     #ifdef TIXML_USE_STL
 	/** Return Value() as a std::string. If you only use STL,
 	    this is more efficient than calling Value().
@@ -511,11 +590,19 @@ public:
 		Text:		the text string
 		@endverbatim
 	*/
-	void SetValue(const char * _value) { value = _value;}
+	void SetValue(const char * _value)
+	{
+		value = _value;
+		if ( type == ELEMENT )
+		{
+			atom = TiXmlAtom::Intern( _value );
+			if ( parent ) parent->DiscardChildIndex();
+		}
+	}
 
     #ifdef TIXML_USE_STL
 	/// STL std::string form.
-	void SetValue( const std::string& _value )	{ value = _value; }
+	void SetValue( const std::string& _value )	{ SetValue( _value.c_str() ); }
 	#endif
 
 	/// Delete all the children of this node. Does not affect 'this'.
@@ -616,6 +703,22 @@ public:
 	/// Delete a child of this node.
 	bool RemoveChild( TiXmlNode* removeThis );
 
+	/** Detach a child of this node, without deleting it; the detached
+		node, which is returned, then belongs to the caller.
+	*/
+	TiXmlNode* UnlinkChild( TiXmlNode* removeThis );
+
+	/** Move a node, (and its entire subtree), from wherever it currently
+		resides, possibly in another document, to become the last child of
+		this node, without copying it.  Any arena storage of the document
+		from which it is taken is transferred to the document which adopts
+		it; (if this node does not belong to any document, there is nowhere
+		to transfer that storage, so a copy is linked instead, leaving the
+		original in place).  Returns a pointer to the adopted node, or NULL
+		if an error occured.
+	*/
+	TiXmlNode* AdoptChild( TiXmlNode* addThis );
+
 	/// Navigate to a sibling node.
 	const TiXmlNode* PreviousSibling() const			{ return prev; }
 	TiXmlNode* PreviousSibling()						{ return prev; }
@@ -666,6 +769,15 @@ public:
 	TiXmlElement* NextSiblingElement( const std::string& _value)				{	return NextSiblingElement (_value.c_str ());	}	///< STL std::string form.
 	#endif
 
+	/** Return the first child element whose interned name is the given
+		atom, (see TiXmlAtom), or null if there is none; the companion method
+		returns the next such sibling of this node.  A search may index the
+		children of the parent, and so modifies it; searches must not run
+		concurrently with each other, nor with changes to the children.
+	*/
+	TiXmlNode* FirstChildOfAtom( const char* _atom );
+	TiXmlNode* NextSiblingOfAtom( const char* _atom );
+
 	/// Convenience function to get through elements.
 	const TiXmlElement* FirstChildElement()	const;
 	TiXmlElement* FirstChildElement() {
@@ -755,6 +867,14 @@ protected:
 	virtual void StreamIn( std::istream* in, TIXML_STRING* tag ) = 0;
 	#endif
 
+	// Note that the children of this node have changed; discard any index
+	// of them, and notify the owning document.
+	void ChildrenChanged();
+
+	// Notify the owning document, if any, that the children, or (for an
+	// element) the attributes, of this node have changed.
+	void NotifyDocument();
+
 	// Figure out what is at *p, and parse it. Returns null if it is not an xml node.
 	TiXmlNode* Identify( const char* start, TiXmlEncoding encoding );
 
@@ -765,10 +885,31 @@ protected:
 	TiXmlNode*		lastChild;
 
 	TIXML_STRING	value;
+	const char*		atom;		// interned element name; see Atom().
 
 	TiXmlNode*		prev;
 	TiXmlNode*		next;
 
+	// The index of children by atom, (see FirstChildOfAtom), and the link
+	// to the next sibling with the same atom, which is valid only while the
+	// parent is indexed.
+	struct ChildIndex
+	{
+		int count, size;
+		struct Group
+		{
+			const char*	atom;
+			TiXmlNode*	first;
+		} group[ 1 ];
+	};
+	enum { INDEX_THRESHOLD = 8 };
+
+	ChildIndex*		childIndex;
+	TiXmlNode*		nextOfAtom;
+
+	const ChildIndex* IndexChildren();
+	void DiscardChildIndex();
+
 private:
 	TiXmlNode( const TiXmlNode& );				// not implemented.
 	void operator=( const TiXmlNode& base );	// not allowed.
@@ -791,6 +932,7 @@ public:
 	TiXmlAttribute() : TiXmlBase()
 	{
 		document = 0;
+		atom = 0;
 		prev = next = 0;
 	}
 
@@ -799,6 +941,7 @@ public:
 	TiXmlAttribute( const std::string& _name, const std::string& _value )
 	{
 		name = _name;
+		atom = TiXmlAtom::Intern( name.c_str() );
 		value = _value;
 		document = 0;
 		prev = next = 0;
@@ -809,12 +952,14 @@ public:
 	TiXmlAttribute( const char * _name, const char * _value )
 	{
 		name = _name;
+		atom = TiXmlAtom::Intern( _name );
 		value = _value;
 		document = 0;
 		prev = next = 0;
 	}
 
 	const char*		Name()  const		{ return name.c_str(); }		///< Return the name of this attribute.
+	const char*		Atom()  const		{ return atom; }				///< Return the interned atom for the name.
 	const char*		Value() const		{ return value.c_str(); }		///< Return the value of this attribute.
 	#ifdef TIXML_USE_STL
 	const std::string& ValueStr() const	{ return value; }				///< Return the value of this attribute.
@@ -838,7 +983,7 @@ public:
 	/// QueryDoubleValue examines the value string. See QueryIntValue().
 	int QueryDoubleValue( double* _value ) const;
 
-	void SetName( const char* _name )	{ name = _name; }				///< Set the name of this attribute.
+	void SetName( const char* _name )	{ name = _name; atom = TiXmlAtom::Intern( _name ); }	///< Set the name of this attribute.
 	void SetValue( const char* _value )	{ value = _value; }				///< Set the value.
 
 	void SetIntValue( int _value );										///< Set the value from an integer.
@@ -846,7 +991,7 @@ public:
 
     #ifdef TIXML_USE_STL
 	/// STL std::string form.
-	void SetName( const std::string& _name )	{ name = _name; }	
+	void SetName( const std::string& _name )	{ SetName( _name.c_str() ); }	
 	/// STL std::string form.	
 	void SetValue( const std::string& _value )	{ value = _value; }
 	#endif
@@ -888,6 +1033,7 @@ private:
 
 	TiXmlDocument*	document;	// A pointer back to a document, for error reporting.
 	TIXML_STRING name;
+	const char*	atom;		// interned name; see Atom().
 	TIXML_STRING value;
 	TiXmlAttribute*	prev;
 	TiXmlAttribute*	next;
@@ -912,13 +1058,15 @@ public:
 	TiXmlAttributeSet();
 	~TiXmlAttributeSet();
 
-	void Add( TiXmlAttribute* attribute );
+	// Returns false, leaving the attribute unlinked, (and still owned by
+	// the caller), if the slot vector cannot be grown to accommodate it.
+	bool Add( TiXmlAttribute* attribute );
 	void Remove( TiXmlAttribute* attribute );
 
-	const TiXmlAttribute* First()	const	{ return ( sentinel.next == &sentinel ) ? 0 : sentinel.next; }
-	TiXmlAttribute* First()					{ return ( sentinel.next == &sentinel ) ? 0 : sentinel.next; }
-	const TiXmlAttribute* Last() const		{ return ( sentinel.prev == &sentinel ) ? 0 : sentinel.prev; }
-	TiXmlAttribute* Last()					{ return ( sentinel.prev == &sentinel ) ? 0 : sentinel.prev; }
+	const TiXmlAttribute* First()	const	{ return count ? slot[ 0 ].attribute : 0; }
+	TiXmlAttribute* First()					{ return count ? slot[ 0 ].attribute : 0; }
+	const TiXmlAttribute* Last() const		{ return count ? slot[ count - 1 ].attribute : 0; }
+	TiXmlAttribute* Last()					{ return count ? slot[ count - 1 ].attribute : 0; }
 
 	const TiXmlAttribute*	Find( const char* _name ) const;
 	TiXmlAttribute*	Find( const char* _name ) {
@@ -933,12 +1081,28 @@ public:
 	#endif
 
 private:
-	//*ME:	Because of hidden/disabled copy-construktor in TiXmlAttribute (sentinel-element),
-	//*ME:	this class must be also use a hidden/disabled copy-constructor !!!
 	TiXmlAttributeSet( const TiXmlAttributeSet& );	// not allowed
 	void operator=( const TiXmlAttributeSet& );	// not allowed (as TiXmlAttribute)
 
-	TiXmlAttribute sentinel;
+	/*	The attributes are indexed by a contiguous vector of slots, each of
+		which pairs an attribute with the atom for its name, so that look-ups
+		need not visit the attributes themselves; the first few slots are held
+		inline, so that a typical element needs no further allocation.  (Note
+		that an attribute must not be renamed, while it is in a set).  The
+		attributes remain linked to each other, in order, for iteration by
+		TiXmlAttribute::Next().
+	*/
+	struct Slot
+	{
+		const char*		atom;
+		TiXmlAttribute*	attribute;
+	};
+	enum { INLINE_SLOTS = 4 };
+
+	Slot*		slot;
+	unsigned	count;
+	unsigned	capacity;
+	Slot		inline_slot[ INLINE_SLOTS ];
 };
 
 
@@ -1403,7 +1567,30 @@ public:
 	TiXmlDocument( const TiXmlDocument& copy );
 	void operator=( const TiXmlDocument& copy );
 
-	virtual ~TiXmlDocument() {}
+	virtual ~TiXmlDocument();
+
+	#ifndef TIXML_USE_STL
+	/** Documents themselves are never carved from an arena; each owns the
+		arena, (created on first reference), from which its content may be
+		allocated, and which is released when the document is destroyed.
+	*/
+	static void* operator new( size_t size )	{ return ::operator new( size ); }
+	static void operator delete( void* p )		{ ::operator delete( p ); }
+
+	TiXmlArena* Arena()							{ return arena ? arena : (arena = new TiXmlArena()); }
+
+	/** Select in situ parsing, for subsequent LoadFile() calls.  In this mode,
+		the document keeps a private image of the file, within its arena, and
+		parses it in place; element and attribute names refer to their interned
+		atoms, (see TiXmlAtom), while attribute values, and text, refer to the
+		image itself, rather than to copies.  Any such string which is changed
+		is first copied, leaving the image intact.  Strings taken from a document
+		which has been loaded in this manner must not outlive the document, (or
+		the document which adopts its content; see TiXmlNode::AdoptChild).
+	*/
+	void SetInSitu( bool _inSitu )				{ inSitu = _inSitu; }
+	bool InSitu() const							{ return inSitu; }
+	#endif
 
 	/** Load a file using the current document value.
 		Returns true if successful. Will delete any existing
@@ -1506,6 +1693,14 @@ public:
 
 	int TabSize() const	{ return tabsize; }
 
+	/** Called whenever any node is linked to, or removed from, the
+		children of the given node, or whenever an attribute of the given
+		element is set or removed; the default does nothing, but a derived
+		document may override it, to discard any index of its content
+		which may have become stale.
+	*/
+	virtual void ContentChanged( TiXmlNode* /* node */ )	{}
+
 	/** If you have handled the error, it can be reset with this call. The error
 		state is automatically cleared if you Parse a new XML block.
 	*/
@@ -1553,6 +1748,13 @@ private:
 	int tabsize;
 	TiXmlCursor errorLocation;
 	bool useMicrosoftBOM;		// the UTF-8 BOM were found when read. Note this, and try to write.
+	#ifndef TIXML_USE_STL
+	TiXmlArena* arena;			// storage for content; see Arena().
+	bool inSitu;				// parse files in place; see SetInSitu().
+	bool parsingInSitu;			// the buffer now being parsed may be rewritten.
+
+	bool LoadFileInSitu( FILE*, long length, TiXmlEncoding encoding );
+	#endif
 };
 
 
@@ -176,6 +176,9 @@ class TiXmlParsingData
 
 	const TiXmlCursor& Cursor()	{ return cursor; }
 
+	// Whether the buffer being parsed may be rewritten; (see TiXmlDocument::SetInSitu).
+	bool InSitu() const			{ return inSitu; }
+
   private:
 	// Only used by the document!
 	TiXmlParsingData( const char* start, int _tabsize, int row, int col )
@@ -185,11 +188,13 @@ class TiXmlParsingData
 		tabsize = _tabsize;
 		cursor.row = row;
 		cursor.col = col;
+		inSitu = false;
 	}
 
 	TiXmlCursor		cursor;
 	const char*		stamp;
 	int				tabsize;
+	bool			inSitu;
 };
 
 
@@ -631,9 +636,93 @@ const char* TiXmlBase::ReadText(	const char* p,
 			}
 		}
 	}
-	if ( p ) 
+	// Never step beyond the end of the buffer, if the end tag is missing;
+	// (as in later tinyxml releases).
+	if ( p && *p )
 		p += strlen( endTag );
-	return p;
+	return ( p && *p ) ? p : 0;
+}
+
+const char* TiXmlBase::ReadTextInSitu(	const char* p,
+										TIXML_STRING* text,
+										bool trimWhiteSpace,
+										const char* endTag,
+										bool keepEndTag,
+										TiXmlParsingData* data,
+										TiXmlEncoding encoding )
+{
+	#ifndef TIXML_USE_STL
+	if ( data && data->InSitu() && p )
+	{
+		// The buffer is the document's private image of its file, so it is
+		// safe to cast away const, and to rewrite the text where it lies.
+		bool trim = trimWhiteSpace && condenseWhiteSpace;
+		char* start = const_cast< char* >( trim ? SkipWhiteSpace( p, encoding ) : p );
+
+		// Find the end tag, stepping through the text as ReadText would; any
+		// text which that would not take verbatim, (an entity reference, or
+		// an invalid character), is left for ReadText to deal with.
+		const char* end = start;
+		while ( end && *end && *end != '&' && !StringEqual( end, endTag, false, encoding ) )
+		{
+			int length = ( encoding == TIXML_ENCODING_UTF8 && !( trim && IsWhiteSpace( *end ) ) )
+				? utf8ByteTable[ *((const unsigned char*)end) ] : 1;
+			for ( int i = 0; end && i < length; ++i )
+				if ( !end[i] ) end = 0;
+			if ( !length )
+				end = 0;
+			if ( end )
+				end += length;
+		}
+
+		if ( end && *end && *end != '&' )
+		{
+			// Record the position beyond the text, before it is rewritten; (the
+			// cursor could not otherwise be advanced past any terminator).
+			const char* next = end + strlen( endTag );
+			data->Stamp( keepEndTag ? end : next, encoding );
+
+			char* w = const_cast< char* >( end );
+			if ( trim )
+			{
+				// Condense white space, exactly as ReadText does.
+				bool whitespace = false;
+				w = start;
+				for ( const char* q = start; q < end; )
+				{
+					if ( IsWhiteSpace( *q ) )
+					{
+						whitespace = true;
+						++q;
+					}
+					else
+					{
+						if ( whitespace )
+						{
+							*w++ = ' ';
+							whitespace = false;
+						}
+						int length = ( encoding == TIXML_ENCODING_UTF8 ) ? utf8ByteTable[ *((const unsigned char*)q) ] : 1;
+						while ( length-- )
+							*w++ = *q++;
+					}
+				}
+			}
+
+			// Terminate the text, unless that would overwrite an end tag which
+			// must be read again; in that case, it has to be copied after all.
+			if ( w < end || !keepEndTag )
+			{
+				*w = '\0';
+				text->borrow( start, w - start );
+			}
+			else
+				text->assign( start, w - start );
+			return *next ? next : 0;
+		}
+	}
+	#endif
+	return ReadText( p, text, trimWhiteSpace, endTag, false, encoding );
 }
 
 #ifdef TIXML_USE_STL
@@ -703,6 +792,11 @@ void TiXmlDocument::StreamIn( std::istream * in, TIXML_STRING * tag )
 
 const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiXmlEncoding encoding )
 {
+	#ifndef TIXML_USE_STL
+	// Carve all content created by the parser from the document's arena.
+	TiXmlArena::Scope scope( Arena() );
+	#endif
+
 	ClearError();
 
 	// Parse away, at the document level. Since a document
@@ -730,6 +824,9 @@ const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiX
 	}
 	TiXmlParsingData data( p, TabSize(), location.row, location.col );
 	location = data.Cursor();
+	#ifndef TIXML_USE_STL
+	data.inSitu = parsingInSitu;
+	#endif
 
 	if ( encoding == TIXML_ENCODING_UNKNOWN )
 	{
@@ -1075,6 +1172,12 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 	const char* pErr = p;
 
     p = ReadName( p, &value, encoding );
+	atom = TiXmlAtom::Intern( value.c_str() );
+	#ifndef TIXML_USE_STL
+	// The atom is permanent; refer to it, rather than keep a copy of the name.
+	if ( atom )
+		value.borrow( atom, value.length() );
+	#endif
 	if ( !p || !*p )
 	{
 		if ( document )	document->SetError( TIXML_ERROR_FAILED_TO_READ_ELEMENT_NAME, pErr, data, encoding );
@@ -1167,7 +1270,12 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 				return 0;
 			}
 
-			attributeSet.Add( attrib );
+			if ( !attributeSet.Add( attrib ) )
+			{
+				if ( document ) document->SetError( TIXML_ERROR_OUT_OF_MEMORY, pErr, data, encoding );
+				delete attrib;
+				return 0;
+			}
 		}
 	}
 	return p;
@@ -1403,6 +1511,11 @@ const char* TiXmlAttribute::Parse( const char* p, TiXmlParsingData* data, TiXmlE
 	// Read the name, the '=' and the value.
 	const char* pErr = p;
 	p = ReadName( p, &name, encoding );
+	atom = TiXmlAtom::Intern( name.c_str() );
+	#ifndef TIXML_USE_STL
+	if ( atom )
+		name.borrow( atom, name.length() );
+	#endif
 	if ( !p || !*p )
 	{
 		if ( document ) document->SetError( TIXML_ERROR_READING_ATTRIBUTES, pErr, data, encoding );
@@ -1431,13 +1544,13 @@ const char* TiXmlAttribute::Parse( const char* p, TiXmlParsingData* data, TiXmlE
 	{
 		++p;
 		end = "\'";		// single quote in string
-		p = ReadText( p, &value, false, end, false, encoding );
+		p = ReadTextInSitu( p, &value, false, end, false, data, encoding );
 	}
 	else if ( *p == DOUBLE_QUOTE )
 	{
 		++p;
 		end = "\"";		// double quote in string
-		p = ReadText( p, &value, false, end, false, encoding );
+		p = ReadTextInSitu( p, &value, false, end, false, data, encoding );
 	}
 	else
 	{
@@ -1538,8 +1651,8 @@ const char* TiXmlText::Parse( const char* p, TiXmlParsingData* data, TiXmlEncodi
 		bool ignoreWhite = true;
 
 		const char* end = "<";
-		p = ReadText( p, &value, ignoreWhite, end, false, encoding );
-		if ( p )
+		p = ReadTextInSitu( p, &value, ignoreWhite, end, true, data, encoding );
+		if ( p && *p )
 			return p-1;	// don't truncate the '<'
 		return 0;
 	}